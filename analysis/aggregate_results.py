@@ -7,26 +7,41 @@ into a single results.csv file.
 Usage:
 
     python3 aggregate_results.py ../all_logs.txt
+    python3 aggregate_results.py ../results        # bp_sim --results files
 
 It looks for blocks that start with:
 
     === CSV (copy/paste into analysis/results.csv) ===
 
-and then reads only *valid* CSV data lines with 6 comma-separated fields:
-    benchmark,scheme,total,correct,accuracy,hw_bits
+and then reads only *valid* CSV data lines with the fields of HEADER:
+    benchmark,scheme,total,correct,accuracy,hw_bits,
+    hrt_hits,hrt_misses,hrt_evictions,hrt_cold,
+    pt_used,pt_aliased,pt_pcs_per_entry
+
+Logs from older bp_sim versions have only the first 6 fields; their rows
+are kept with the instrumentation columns left empty.
+
+Arguments may also be results files written by bp_sim --results, or
+directories of them; those are read with bpres.py, with no text scanning.
 """
 
 import sys
 import os
 
-HEADER = "benchmark,scheme,total,correct,accuracy,hw_bits"
+import bpres
+
+HEADER = ("benchmark,scheme,total,correct,accuracy,hw_bits,"
+          "hrt_hits,hrt_misses,hrt_evictions,hrt_cold,"
+          "pt_used,pt_aliased,pt_pcs_per_entry")
+NUM_FIELDS = len(HEADER.split(","))
+BASE_FIELDS = 6  # benchmark .. hw_bits
 
 
 def extract_from_file(path):
     """
     Scan a bp_sim log file and pull out all CSV data lines from blocks
     that start with the CSV marker. We *only* keep lines that look like
-    proper CSV rows (6 comma-separated fields).
+    proper CSV rows (NUM_FIELDS, or BASE_FIELDS from older logs).
     """
     rows = []
     in_csv = False
@@ -55,21 +70,23 @@ def extract_from_file(path):
                 in_csv = False
                 continue
 
-            # Check if it's a 6-field CSV row
+            # Check if it's a full (or old 6-field) CSV row
             parts = line.split(",")
-            if len(parts) != 6:
+            if len(parts) == BASE_FIELDS:
+                parts += [""] * (NUM_FIELDS - BASE_FIELDS)
+            elif len(parts) != NUM_FIELDS:
                 # This probably means we've left the CSV area
                 in_csv = False
                 continue
 
-            rows.append(line)
+            rows.append(",".join(parts))
 
     return rows
 
 
 def main():
     if len(sys.argv) < 2:
-        print("Usage: python3 aggregate_results.py <log1> [<log2> ...]")
+        print("Usage: python3 aggregate_results.py <log | file.bpres | dir> ...")
         sys.exit(1)
 
     all_rows = []
@@ -77,7 +94,10 @@ def main():
         if not os.path.exists(path):
             print(f"Warning: file '{path}' not found, skipping.")
             continue
-        all_rows.extend(extract_from_file(path))
+        if os.path.isdir(path) or bpres.is_results_file(path):
+            all_rows.extend(bpres.csv_line(r) for r in bpres.read_results([path]))
+        else:
+            all_rows.extend(extract_from_file(path))
 
     if not all_rows:
         print("No CSV rows found in provided logs.")
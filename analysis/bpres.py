@@ -0,0 +1,135 @@
+"""
+bpres.py
+
+Read the binary results files written by `bp_sim --results PATH`
+(format in include/results_file.hpp). Standard library only.
+
+Usage as a module:
+
+    import bpres
+    rows = bpres.read_results(["../results"])   # files and/or directories
+    for r in rows:
+        print(r["benchmark"], r["scheme"], r["accuracy"])
+
+A directory stands for every *.bpres file in it (in name order), so
+results written there by parallel runs are read together. Each row is a
+dict with the columns of HEADER; accuracy is an unrounded percentage.
+
+Usage as a script, to print the rows as results.csv lines:
+
+    python3 bpres.py ../results > results.csv
+"""
+
+import os
+import struct
+import sys
+from array import array
+
+HEADER = ("benchmark,scheme,total,correct,accuracy,hw_bits,"
+          "hrt_hits,hrt_misses,hrt_evictions,hrt_cold,"
+          "pt_used,pt_aliased,pt_pcs_per_entry")
+COLUMNS = HEADER.split(",")
+FLOAT_COLUMNS = ("accuracy", "pt_pcs_per_entry")
+
+MAGIC = b"BPRES\0\0\0"
+VERSION = 1
+EXT = ".bpres"
+
+_FILE_HEADER = struct.Struct("<8sIIQII")   # ResultsFileHeader
+_COLUMN = struct.Struct("<24sIIQQ")        # ResultsColumn
+_U64, _F64, _STR = 1, 2, 3
+
+
+def is_results_file(path):
+    """True if path is a file that starts with the bpres magic."""
+    try:
+        with open(path, "rb") as f:
+            return f.read(len(MAGIC)) == MAGIC
+    except OSError:
+        return False
+
+
+def _numbers(data, offset, rows, code):
+    values = array(code)
+    values.frombytes(data[offset:offset + 8 * rows])
+    if sys.byteorder != "little":
+        values.byteswap()
+    return values.tolist()
+
+
+def read_columns(path):
+    """Columns of one results file: {name: list of values}."""
+    with open(path, "rb") as f:
+        data = f.read()
+    if len(data) < _FILE_HEADER.size:
+        raise ValueError(f"{path}: not a results file (too short)")
+    magic, version, header_bytes, rows, ncols, _ = _FILE_HEADER.unpack_from(data, 0)
+    if magic != MAGIC:
+        raise ValueError(f"{path}: not a results file (bad magic)")
+    if version != VERSION:
+        raise ValueError(f"{path}: unsupported results file version {version}")
+
+    columns = {}
+    for i in range(ncols):
+        raw_name, ctype, _, offset, nbytes = _COLUMN.unpack_from(
+            data, header_bytes + i * _COLUMN.size)
+        name = raw_name.rstrip(b"\0").decode()
+        if offset + nbytes > len(data) or nbytes < 8 * rows:
+            raise ValueError(f"{path}: truncated results file")
+        if ctype == _U64:
+            columns[name] = _numbers(data, offset, rows, "Q")
+        elif ctype == _F64:
+            columns[name] = _numbers(data, offset, rows, "d")
+        elif ctype == _STR:
+            ends = _numbers(data, offset, rows, "Q")
+            base = offset + 8 * rows
+            starts = [0] + ends[:-1]
+            columns[name] = [data[base + b:base + e].decode() for b, e in zip(starts, ends)]
+        # Unknown column types are skipped.
+    return columns
+
+
+def expand(paths):
+    """Results files named by paths, directories expanded to their *.bpres."""
+    files = []
+    for path in paths:
+        if os.path.isdir(path):
+            files.extend(os.path.join(path, n) for n in sorted(os.listdir(path))
+                         if n.endswith(EXT))
+        else:
+            files.append(path)
+    return files
+
+
+def read_results(paths):
+    """Rows (dicts keyed by COLUMNS) of every results file in paths."""
+    rows = []
+    for path in expand(paths):
+        columns = read_columns(path)
+        n = len(columns.get("benchmark", []))
+        for i in range(n):
+            row = {}
+            for name in COLUMNS:
+                default = 0.0 if name in FLOAT_COLUMNS else 0
+                row[name] = columns[name][i] if name in columns else default
+            rows.append(row)
+    return rows
+
+
+def csv_line(row):
+    """A row in the format of bp_sim's results CSV."""
+    return ",".join(f"{row[c]:.2f}" if c in FLOAT_COLUMNS else str(row[c])
+                    for c in COLUMNS)
+
+
+def main():
+    if len(sys.argv) < 2:
+        print("Usage: python3 bpres.py <file.bpres | dir> ...")
+        sys.exit(1)
+    print(HEADER)
+    for row in read_results(sys.argv[1:]):
+        print(csv_line(row))
+
+
+if __name__ == "__main__":
+    main()
@@ -3,66 +3,106 @@ plot_results.py
 
 Generate plots from results.csv produced by aggregate_results.py.
 
+Usage:
+    python3 plot_results.py                 # results.csv
+    python3 plot_results.py ../results      # bp_sim --results files / dirs
+
 Input:
-    results.csv with columns:
+    results.csv (or the results files, read with bpres.py) with columns:
         benchmark,scheme,total,correct,accuracy,hw_bits
+    optionally followed by the instrumentation columns
+        hrt_hits,hrt_misses,hrt_evictions,hrt_cold,
+        pt_used,pt_aliased,pt_pcs_per_entry
 
 Output:
     accuracy_by_benchmark.png  - per-benchmark grouped bar chart
     accuracy_by_scheme.png     - per-scheme geometric mean accuracy
+    hrt_pt_by_scheme.png       - per-scheme mean HRT miss/eviction rate and
+                                 PT branches per entry (if instrumented)
 """
 
 import math
+import os
+import sys
 from collections import defaultdict, OrderedDict
 
 import matplotlib.pyplot as plt
 
+import bpres
+
 CSV_FILE = "results.csv"
+SOURCES = sys.argv[1:] or [CSV_FILE]
+
+
+def result_lines():
+    """Lines of the CSV, or of the results files given as arguments."""
+    for path in SOURCES:
+        if os.path.isdir(path) or bpres.is_results_file(path):
+            for row in bpres.read_results([path]):
+                yield bpres.csv_line(row)
+        else:
+            with open(path, "r") as f:
+                yield from f
+
 
 # ---------- Load data from CSV (robustly) ----------
 
 data = defaultdict(dict)      # benchmark -> scheme -> accuracy
 scheme_to_accs = defaultdict(list)
+# scheme -> list of (miss %, eviction %, PT branches per entry)
+scheme_to_instr = defaultdict(list)
 benchmarks_order = []
 schemes_order = []
 
-with open(CSV_FILE, "r") as f:
-    first = True
-    for raw in f:
-        line = raw.strip()
-        if not line:
-            continue
-        # Skip header
-        if first:
-            first = False
-            if line.startswith("benchmark,scheme"):
-                continue
-
-        # Skip obviously non-CSV or malformed lines
-        if line.startswith("Trace file:") or line.startswith("Benchmark:") or line.startswith("==="):
+first = True
+for raw in result_lines():
+    line = raw.strip()
+    if not line:
+        continue
+    # Skip header
+    if first:
+        first = False
+        if line.startswith("benchmark,scheme"):
             continue
 
-        parts = line.split(",")
-        if len(parts) != 6:
-            # Not a valid row
-            continue
+    # Skip obviously non-CSV or malformed lines
+    if line.startswith("Trace file:") or line.startswith("Benchmark:") or line.startswith("==="):
+        continue
 
-        bench, scheme, total, correct, acc_str, hw_bits = [p.strip() for p in parts]
-        if not bench or not scheme or not acc_str:
-            continue
+    parts = line.split(",")
+    if len(parts) < 6:
+        # Not a valid row
+        continue
+
+    bench, scheme, total, correct, acc_str, hw_bits = [p.strip() for p in parts[:6]]
+    if not bench or not scheme or not acc_str:
+        continue
+
+    try:
+        acc = float(acc_str)
+    except ValueError:
+        continue
 
+    data[bench][scheme] = acc
+    scheme_to_accs[scheme].append(acc)
+
+    # hrt_hits,hrt_misses,hrt_evictions,hrt_cold,pt_used,pt_aliased,pt_pcs_per_entry
+    if len(parts) >= 13 and parts[6].strip():
         try:
-            acc = float(acc_str)
+            hits, misses, evictions = (int(p) for p in parts[6:9])
+            pcs_per_entry = float(parts[12])
         except ValueError:
-            continue
-
-        data[bench][scheme] = acc
-        scheme_to_accs[scheme].append(acc)
+            pass
+        else:
+            if hits + misses > 0:
+                accesses = float(hits + misses)
+                scheme_to_instr[scheme].append(
+                    (100.0 * misses / accesses, 100.0 * evictions / accesses, pcs_per_entry))
 
-        if bench not in benchmarks_order:
-            benchmarks_order.append(bench)
-        if scheme not in schemes_order:
-            schemes_order.append(scheme)
+    if bench not in benchmarks_order:
+        benchmarks_order.append(bench)
+    if scheme not in schemes_order:
+        schemes_order.append(scheme)
 
 
 # ---------- Plot 1: accuracy by benchmark (grouped bars) ----------
@@ -120,3 +160,27 @@ plt.ylim(0, 100)
 plt.tight_layout()
 plt.savefig("accuracy_by_scheme.png", dpi=300)
 
+# ---------- Plot 3: HRT misses and PT aliasing per scheme ----------
+
+instr_schemes = [s for s in schemes_order if scheme_to_instr[s]]
+if instr_schemes:
+    def mean(values):
+        return sum(values) / len(values)
+
+    miss = [mean([v[0] for v in scheme_to_instr[s]]) for s in instr_schemes]
+    evict = [mean([v[1] for v in scheme_to_instr[s]]) for s in instr_schemes]
+    alias = [mean([v[2] for v in scheme_to_instr[s]]) for s in instr_schemes]
+
+    fig, (ax1, ax2) = plt.subplots(2, 1, figsize=(8, 7), sharex=True)
+    x3 = list(range(len(instr_schemes)))
+    ax1.bar([i - 0.2 for i in x3], miss, 0.4, label="HRT misses")
+    ax1.bar([i + 0.2 for i in x3], evict, 0.4, label="HRT evictions")
+    ax1.set_ylabel("% of HRT accesses")
+    ax1.set_title("First-level misses and second-level aliasing per scheme")
+    ax1.legend(fontsize="small")
+    ax2.bar(x3, alias)
+    ax2.set_ylabel("Branches per used PT entry")
+    ax2.set_xticks(x3)
+    ax2.set_xticklabels(instr_schemes, rotation=45, ha="right")
+    fig.tight_layout()
+    fig.savefig("hrt_pt_by_scheme.png", dpi=300)
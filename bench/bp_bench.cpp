@@ -0,0 +1,278 @@
+/*
+ * bp_bench: microbenchmarks of the predictor components and an end-to-end
+ * throughput benchmark, built on Google Benchmark.
+ *
+ *   - PatternTable predict / update, per k and PT layout;
+ *   - AHRT, HHRT and IHRT lookup + commit, per size and associativity;
+ *   - Bimodal2BitPredictor update, per static-branch count;
+ *   - EndToEnd/<trace>: the default sweep plus baselines over each bundled
+ *     traces/<name>_synth.txt, as bp_sim runs it.
+ *
+ * Every benchmark reports items = branches, so the per-item rate is
+ * branches/second and ns/branch is 1e9 / that rate. For regression
+ * tracking, write machine-readable results with the standard options:
+ *
+ *   ./bp_bench --benchmark_out=bench.json --benchmark_out_format=json
+ *
+ * The PC and outcome streams are synthetic and fixed-seed, so runs are
+ * comparable across builds.
+ */
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <dirent.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "experiment.hpp"
+#include "hrt.hpp"
+#include "pattern_table.hpp"
+#include "predictors.hpp"
+#include "sweep_spec.hpp"
+#include "trace.hpp"
+
+#ifndef BP_TRACE_DIR
+#define BP_TRACE_DIR "traces"
+#endif
+
+namespace {
+
+using namespace bp;
+
+constexpr std::size_t kStreamLength = 1u << 16; // records per synthetic stream
+
+// xorshift64*: fixed-seed generator for the synthetic streams.
+struct Rng {
+    std::uint64_t state = 0x9E3779B97F4A7C15ull;
+
+    std::uint64_t next() {
+        state ^= state >> 12;
+        state ^= state << 25;
+        state ^= state >> 27;
+        return state * 0x2545F4914F6CDD1Dull;
+    }
+};
+
+/**
+ * Synthetic branch stream: `branches` distinct word-aligned PCs, visited
+ * in random order, with outcomes biased 3:1 taken.
+ */
+struct Stream {
+    std::vector<std::uint64_t> pcs;
+    std::vector<Outcome>       outs;
+    std::vector<History>       hist; // random histories for PT benchmarks
+
+    explicit Stream(std::size_t branches) {
+        Rng rng;
+        std::vector<std::uint64_t> pool(branches);
+        for (auto& pc : pool) pc = 0x400000u + ((rng.next() >> 40) << 2);
+
+        pcs.resize(kStreamLength);
+        outs.resize(kStreamLength);
+        hist.resize(kStreamLength);
+        for (std::size_t i = 0; i < kStreamLength; ++i) {
+            const std::uint64_t r = rng.next();
+            pcs[i]  = pool[(r >> 32) % branches];
+            outs[i] = ((r & 3u) != 0) ? Outcome::Taken : Outcome::NotTaken;
+            hist[i] = rng.next();
+        }
+    }
+};
+
+// ------------------------------------------------------------ PatternTable
+
+void BM_PatternTablePredict(benchmark::State& state) {
+    const int      k      = static_cast<int>(state.range(0));
+    const PTLayout layout = state.range(1) ? PTLayout::Packed : PTLayout::Bytes;
+    PatternTable   pt(k, AutomatonType::A2, layout);
+    Stream         s(1);
+
+    for (auto _ : state) {
+        std::uint64_t taken = 0;
+        for (std::size_t i = 0; i < kStreamLength; ++i) taken += pt.predict(s.hist[i]) ? 1u : 0u;
+        benchmark::DoNotOptimize(taken);
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kStreamLength));
+    state.SetLabel(layout == PTLayout::Packed ? "packed" : "bytes");
+}
+BENCHMARK(BM_PatternTablePredict)
+    ->ArgsProduct({{6, 8, 10, 12, 16, 20}, {0, 1}})
+    ->ArgNames({"k", "packed"});
+
+void BM_PatternTableUpdate(benchmark::State& state) {
+    const int      k      = static_cast<int>(state.range(0));
+    const PTLayout layout = state.range(1) ? PTLayout::Packed : PTLayout::Bytes;
+    PatternTable   pt(k, AutomatonType::A2, layout);
+    Stream         s(1);
+
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < kStreamLength; ++i) pt.update(s.hist[i], s.outs[i]);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kStreamLength));
+    state.SetLabel(layout == PTLayout::Packed ? "packed" : "bytes");
+}
+BENCHMARK(BM_PatternTableUpdate)
+    ->ArgsProduct({{6, 8, 10, 12, 16, 20}, {0, 1}})
+    ->ArgNames({"k", "packed"});
+
+// ------------------------------------------------------------ HRTs
+
+/**
+ * One HRT access per branch, as the simulation loops do it: lookup(), then
+ * commit() of the shifted history. HRT is the concrete type, so both calls
+ * bind statically.
+ */
+template <class HRT>
+void access_stream(benchmark::State& state, HRT& hrt, const Stream& s) {
+    const History mask = history_mask(12);
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < kStreamLength; ++i) {
+            HRTSlot slot = hrt.lookup(s.pcs[i]);
+            hrt.commit(slot, ((slot.history << 1) |
+                              (s.outs[i] == Outcome::Taken ? 1u : 0u)) & mask);
+        }
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kStreamLength));
+    const HRTCounters& c = hrt.counters();
+    state.counters["hit_rate"] =
+        static_cast<double>(c.hits) / static_cast<double>(c.hits + c.misses);
+}
+
+// Args: entries, ways, static branches.
+template <class Policy>
+void BM_AHRTAccess(benchmark::State& state) {
+    AHRTTableT<Policy> hrt(static_cast<int>(state.range(0)), static_cast<int>(state.range(1)), 12);
+    Stream             s(static_cast<std::size_t>(state.range(2)));
+    access_stream(state, hrt, s);
+}
+BENCHMARK_TEMPLATE(BM_AHRTAccess, RoundRobinPolicy)
+    ->ArgsProduct({{256, 512, 1024, 4096}, {1, 2, 4, 8, 16}, {512}})
+    ->ArgNames({"entries", "ways", "branches"});
+BENCHMARK_TEMPLATE(BM_AHRTAccess, LRUPolicy)
+    ->ArgsProduct({{512, 4096}, {4, 16}, {512}})
+    ->ArgNames({"entries", "ways", "branches"});
+
+// Args: entries, static branches.
+void BM_HHRTAccess(benchmark::State& state) {
+    HHRTTable hrt(static_cast<int>(state.range(0)), 12);
+    Stream    s(static_cast<std::size_t>(state.range(1)));
+    access_stream(state, hrt, s);
+}
+BENCHMARK(BM_HHRTAccess)
+    ->ArgsProduct({{256, 512, 1024, 4096}, {512}})
+    ->ArgNames({"entries", "branches"});
+
+// Args: static branches (the table is pre-sized for them).
+void BM_IHRTGet(benchmark::State& state) {
+    const auto branches = static_cast<std::size_t>(state.range(0));
+    IHRTTable  hrt(12, branches);
+    Stream     s(branches);
+    for (std::size_t i = 0; i < kStreamLength; ++i) hrt.set(s.pcs[i], 0); // warm
+
+    for (auto _ : state) {
+        History sum = 0;
+        for (std::size_t i = 0; i < kStreamLength; ++i) sum += hrt.get(s.pcs[i]);
+        benchmark::DoNotOptimize(sum);
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kStreamLength));
+}
+BENCHMARK(BM_IHRTGet)->RangeMultiplier(8)->Range(64, 32768)->ArgName("branches");
+
+void BM_IHRTAccess(benchmark::State& state) {
+    const auto branches = static_cast<std::size_t>(state.range(0));
+    IHRTTable  hrt(12, branches);
+    Stream     s(branches);
+    access_stream(state, hrt, s);
+}
+BENCHMARK(BM_IHRTAccess)->RangeMultiplier(8)->Range(64, 32768)->ArgName("branches");
+
+// ------------------------------------------------------------ Baselines
+
+void BM_BimodalUpdate(benchmark::State& state) {
+    const auto           branches = static_cast<std::size_t>(state.range(0));
+    Bimodal2BitPredictor bimodal(branches);
+    Stream               s(branches);
+
+    for (auto _ : state) {
+        for (std::size_t i = 0; i < kStreamLength; ++i) bimodal.update(s.pcs[i], s.outs[i]);
+        benchmark::ClobberMemory();
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * kStreamLength));
+}
+BENCHMARK(BM_BimodalUpdate)->RangeMultiplier(8)->Range(64, 32768)->ArgName("branches");
+
+// ------------------------------------------------------------ End to end
+
+/**
+ * The default sweep and both baselines over one loaded trace, on one
+ * thread (run_serial). items = trace branches; "predictions" is the rate
+ * of branch-predictor pairs simulated.
+ */
+void BM_EndToEnd(benchmark::State& state, const std::string& path) {
+    LoadedTrace trace(path);
+    if (!trace.ok()) {
+        state.SkipWithError(trace.error().c_str());
+        return;
+    }
+    const std::vector<ATConfig> configs = default_sweep();
+    EngineOptions               opts;
+    opts.static_branches = trace.static_branches();
+
+    std::size_t schemes = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        SimSet sims(configs, opts);
+        auto   source = trace.source();
+        schemes       = sims.reported_stats().size();
+        state.ResumeTiming();
+
+        if (!run_serial(*source, sims.units())) {
+            state.SkipWithError(source->error().c_str());
+            return;
+        }
+    }
+    const auto branches = static_cast<double>(trace.size());
+    state.SetItemsProcessed(static_cast<std::int64_t>(state.iterations() * trace.size()));
+    state.counters["predictions"] = benchmark::Counter(
+        branches * static_cast<double>(schemes) * static_cast<double>(state.iterations()),
+        benchmark::Counter::kIsRate);
+}
+
+// One EndToEnd benchmark per *_synth.txt in BP_TRACE_DIR.
+void register_trace_benchmarks() {
+    const std::string dir    = BP_TRACE_DIR;
+    const std::string suffix = "_synth.txt";
+    std::vector<std::string> names;
+    if (DIR* d = opendir(dir.c_str())) {
+        while (const dirent* e = readdir(d)) {
+            const std::string name = e->d_name;
+            if (name.size() > suffix.size() &&
+                name.compare(name.size() - suffix.size(), suffix.size(), suffix) == 0) {
+                names.push_back(name);
+            }
+        }
+        closedir(d);
+    }
+    std::sort(names.begin(), names.end());
+    for (const std::string& name : names) {
+        const std::string label = name.substr(0, name.size() - suffix.size());
+        benchmark::RegisterBenchmark(("BM_EndToEnd/" + label).c_str(), BM_EndToEnd, dir + "/" + name)
+            ->Unit(benchmark::kMillisecond);
+    }
+}
+
+} // namespace
+
+int main(int argc, char** argv) {
+    register_trace_benchmarks();
+    benchmark::Initialize(&argc, argv);
+    if (benchmark::ReportUnrecognizedArguments(argc, argv)) return 1;
+    benchmark::RunSpecifiedBenchmarks();
+    benchmark::Shutdown();
+    return 0;
+}
@@ -0,0 +1,76 @@
+#ifndef BP_ALIGNED_ALLOC_HPP
+#define BP_ALIGNED_ALLOC_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+#include "arena.hpp"
+
+namespace bp {
+
+// Size of a cache line on the hosts we simulate on.
+constexpr std::size_t kCacheLineBytes = 64;
+
+/**
+ * AlignedAllocator: std::allocator replacement that returns storage aligned
+ * to Alignment bytes, so that table rows can be laid out on cache-line
+ * boundaries.
+ *
+ * The allocator remembers the current arena (Arena::current()) of the
+ * thread that created it and allocates from it, or from the heap if there
+ * was none. Containers keep their allocator when moved, swapped or
+ * assigned, so a table built inside an ArenaScope stays in that arena when
+ * it grows later on another thread.
+ */
+template <class T, std::size_t Alignment>
+struct AlignedAllocator {
+    using value_type = T;
+
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap            = std::true_type;
+
+    template <class U>
+    struct rebind { using other = AlignedAllocator<U, Alignment>; };
+
+    AlignedAllocator() : arena(Arena::current()) {}
+    template <class U>
+    AlignedAllocator(const AlignedAllocator<U, Alignment>& other) : arena(other.arena) {}
+
+    T* allocate(std::size_t n) {
+        if (arena) return static_cast<T*>(arena->allocate(n * sizeof(T), Alignment));
+        if constexpr (Alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            return static_cast<T*>(::operator new(n * sizeof(T), std::align_val_t(Alignment)));
+        } else {
+            return static_cast<T*>(::operator new(n * sizeof(T)));
+        }
+    }
+    void deallocate(T* p, std::size_t) {
+        if (arena) return; // freed with the arena
+        if constexpr (Alignment > __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+            ::operator delete(p, std::align_val_t(Alignment));
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    template <class U>
+    bool operator==(const AlignedAllocator<U, Alignment>& o) const { return arena == o.arena; }
+    template <class U>
+    bool operator!=(const AlignedAllocator<U, Alignment>& o) const { return arena != o.arena; }
+
+    Arena* arena; // null: the heap
+};
+
+template <class T>
+using CacheAlignedVector = std::vector<T, AlignedAllocator<T, kCacheLineBytes>>;
+
+// Predictor table storage: a vector in the current arena, naturally aligned.
+template <class T>
+using TableVector = std::vector<T, AlignedAllocator<T, alignof(T)>>;
+
+} // namespace bp
+
+#endif // BP_ALIGNED_ALLOC_HPP
@@ -0,0 +1,131 @@
+#ifndef BP_ARENA_HPP
+#define BP_ARENA_HPP
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace bp {
+
+// Chunk granularity and alignment of arena memory: one x86-64 huge page.
+constexpr std::size_t kHugePageBytes = std::size_t{2} << 20;
+
+/**
+ * Arena: bump allocator for simulation units and their tables. Units built
+ * inside an ArenaScope (SimUnit::operator new) and the TableVectors they
+ * create (aligned_alloc.hpp) take their memory from it, so one worker's
+ * units sit in a few contiguous chunks instead of thousands of heap blocks
+ * and are all freed at once by ~Arena.
+ *
+ *   - Chunks are anonymous mappings, a multiple of kHugePageBytes in size
+ *     and aligned to it, advised MADV_HUGEPAGE so transparent huge pages
+ *     back them where the kernel allows.
+ *   - With a NUMA node, each chunk is mbind()-preferred to that node before
+ *     anything touches it, so its pages land there whichever thread writes
+ *     them first (the units are constructed on the main thread).
+ *
+ * Nothing is returned before ~Arena: a table that grows (PcMap rehashes)
+ * leaves its old storage behind. allocate() is thread-safe, because units
+ * of one arena may run on different threads (hybrid drivers, multi-trace
+ * runs). Everything allocated from an arena must be destroyed before it.
+ */
+class Arena {
+public:
+    // numa_node < 0: no placement policy.
+    explicit Arena(int numa_node = -1);
+    ~Arena();
+
+    Arena(const Arena&)            = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    // bytes of storage aligned to alignment (a power of two, at most
+    // kHugePageBytes). Throws std::bad_alloc when out of memory.
+    void* allocate(std::size_t bytes, std::size_t alignment);
+
+    int numa_node() const { return node_; }
+
+    // Bytes mapped so far (reserved address space, not resident memory).
+    std::size_t mapped_bytes() const;
+
+    // The arena of the innermost ArenaScope on this thread, or null.
+    static Arena* current();
+
+private:
+    struct Chunk {
+        char*       base;
+        std::size_t size;
+    };
+
+    int                node_;
+    mutable std::mutex mutex_;
+    std::vector<Chunk> chunks_;
+    char*              cur_ = nullptr; // free space of the last small chunk
+    char*              end_ = nullptr;
+
+    Chunk map_chunk(std::size_t bytes);
+};
+
+/**
+ * ArenaScope: makes arena the current one of the calling thread (null: the
+ * heap) until the scope ends, when the previous one is restored.
+ */
+class ArenaScope {
+public:
+    explicit ArenaScope(Arena* arena);
+    ~ArenaScope();
+
+    ArenaScope(const ArenaScope&)            = delete;
+    ArenaScope& operator=(const ArenaScope&) = delete;
+
+private:
+    Arena* previous_;
+};
+
+/**
+ * Storage for classes placed in the current arena (SimUnit's operator
+ * new / delete): bytes aligned for any scalar type, behind a header that
+ * records the arena, or null for the heap, so that arena_delete() knows
+ * where the block came from.
+ */
+void* arena_new(std::size_t bytes);
+void  arena_delete(void* p) noexcept;
+
+/**
+ * ArenaSet: one arena per worker of a run_parallel() run (sweep.hpp).
+ * With more than one worker on a host with more than one NUMA node, arena
+ * w is placed on worker_numa_node(w), the node run_parallel() pins worker w
+ * to. next() deals the arenas round-robin, so units built in order are
+ * spread over the workers like run_parallel() would deal them.
+ */
+class ArenaSet {
+public:
+    explicit ArenaSet(unsigned workers);
+
+    unsigned size() const { return static_cast<unsigned>(arenas_.size()); }
+    Arena&   arena(unsigned w) { return *arenas_[w]; }
+
+    // Worker (arena index) for the next unit.
+    unsigned next();
+
+    // Total Arena::mapped_bytes().
+    std::size_t mapped_bytes() const;
+
+private:
+    std::vector<std::unique_ptr<Arena>> arenas_;
+    unsigned                            next_ = 0;
+};
+
+// NUMA nodes of the host, from sysfs; 1 if unknown.
+unsigned numa_node_count();
+
+// Node of worker w in a parallel run: w modulo numa_node_count().
+unsigned worker_numa_node(unsigned w);
+
+// Restrict the calling thread to the CPUs of node. False if they are
+// unknown or the affinity cannot be set; the thread is then unchanged.
+bool pin_thread_to_numa_node(unsigned node);
+
+} // namespace bp
+
+#endif // BP_ARENA_HPP
@@ -4,6 +4,7 @@
 #include <string>
 #include "hrt.hpp"
 #include "automaton.hpp"
+#include "pattern_table.hpp"
 
 namespace bp {
 
@@ -17,8 +18,16 @@ namespace bp {
  *   - hrt_kind    : IHRT / AHRT / HHRT
  *   - hrt_entries : number of HRT entries (for AHRT/HHRT)
  *   - hrt_ways    : associativity (for AHRT)
- *   - history_bits: k (length of history shift register)
+ *   - hrt_replacement: AHRT replacement policy (replacement.hpp)
+ *   - hrt_index   : AHRT/HHRT index function (index_hash.hpp)
+ *   - pt_select   : PT selection, Global / PerSet / Gshare (pattern_table.hpp)
+ *   - pt_set_bits : log2 of the number of PTs for PerSet
+ *   - history_bits: k (length of history shift register, 1..64)
  *   - automaton   : Last-Time, A2, A3, or A4
+ *   - pt_index_bits: PT index width; histories longer than this are folded
+ *                   (0 = k, capped at kDefaultMaxPTIndexBits)
+ *   - pt_layout   : PT storage (one byte or automaton_state_bits() per entry);
+ *                   does not change the simulated scheme
  */
 struct ATConfig {
     std::string   name;
@@ -27,6 +36,32 @@ struct ATConfig {
     int           hrt_ways;      // for AHRT
     int           history_bits;  // k
     AutomatonType automaton;
+    int           pt_index_bits = 0;
+    PTLayout      pt_layout     = PTLayout::Bytes;
+    ReplacementPolicy hrt_replacement = ReplacementPolicy::RoundRobin; // for AHRT
+    IndexHash         hrt_index       = IndexHash::Low;                // for AHRT/HHRT
+    PTSelect          pt_select       = PTSelect::Global;
+    int               pt_set_bits     = 0;                             // for PerSet
+};
+
+/**
+ * HybridConfig: a tournament predictor (hybrid.hpp) over two components of
+ * the sweep,
+ *
+ *   - the AT configuration named at_scheme, and
+ *   - the Bimodal2Bit baseline (predictor_registry.hpp),
+ *
+ * with a chooser of 2^meta_bits 2-bit meta-counters indexed by PC >> 2
+ * (McFarling's combining predictor). With bias_filter, every chooser entry
+ * also tracks the last outcome of its branches and how often in a row it
+ * repeated; after kBiasRun repeats the entry predicts that direction
+ * statically and the chooser is not trained on it.
+ */
+struct HybridConfig {
+    std::string name;
+    std::string at_scheme;
+    int         meta_bits   = 12;
+    bool        bias_filter = false;
 };
 
 } // namespace bp
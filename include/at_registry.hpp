@@ -0,0 +1,88 @@
+#ifndef BP_AT_REGISTRY_HPP
+#define BP_AT_REGISTRY_HPP
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "arena.hpp"
+#include "at_config.hpp"
+#include "sweep.hpp"
+
+namespace bp {
+
+/**
+ * Registry of compile-time specialized AT engines (two_level_at_static.hpp).
+ *
+ * The grid instantiated at build time covers the configurations swept by
+ * main.cpp:
+ *
+ *   HRT  ∈ { AHRT (each replacement policy), HHRT, IHRT }
+ *   k    ∈ { 6, 8, 10, 12 }
+ *   FSM  ∈ { LastTime, A2, A3, A4 }
+ *
+ * with any HRT size/associativity, the default low-bit HRT index
+ * (index_hash.hpp), the default (byte) PT layout and an unfolded PT index.
+ */
+
+// True if cfg has a compile-time specialized engine.
+bool has_specialized_engine(const ATConfig& cfg);
+
+/**
+ * EngineOptions: how make_at_unit() builds a unit, independent of the
+ * scheme described by the ATConfig.
+ */
+struct EngineOptions {
+    bool        allow_specialized = true; // use the registry when possible
+    std::size_t static_branches   = 0;    // trace hint for sizing IHRTs
+    bool        share_hrt         = true; // see make_at_sweep()
+    unsigned    workers           = 1;    // threads the sweep will run on, see make_at_sweep()
+    unsigned    arena_workers     = 0;    // SimSet: per-worker arenas, 0 = heap
+};
+
+/**
+ * Build the simulation unit for cfg: the specialized engine if the registry
+ * has one (and opts.allow_specialized is set), otherwise the
+ * runtime-configured TwoLevelATPredictor. Both produce identical results.
+ */
+std::unique_ptr<ATUnit> make_at_unit(const ATConfig& cfg, const EngineOptions& opts = {});
+
+/**
+ * ATSweep: the units simulating a list of configurations.
+ *
+ *   - configs : one ATUnit per ATConfig, in input order, for reporting;
+ *   - groups  : shared-HRT drivers (shared_hrt.hpp) owned by the sweep;
+ *   - units   : what to run (run_serial / run_parallel): every group plus
+ *               each config that is not a group member;
+ *   - drivers : per config, the entry of units that advances it (its group,
+ *               or the config itself).
+ */
+struct ATSweep {
+    std::vector<std::unique_ptr<ATUnit>>  configs;
+    std::vector<std::unique_ptr<SimUnit>> groups;
+    std::vector<SimUnit*>                 units;
+    std::vector<SimUnit*>                 drivers;
+};
+
+/**
+ * Build the units for a whole sweep. With opts.share_hrt, configurations
+ * with the same HRT kind/entries/ways/replacement share a single HRT run at the largest
+ * of their history lengths (SharedHRTGroup); configurations with a unique
+ * HRT get make_at_unit(). Results are identical either way.
+ *
+ * A group is one unit, run by one worker. With fewer groups than
+ * opts.workers, the largest groups are split in halves until every worker
+ * has a unit: each part runs its own copy of the HRT, trading repeated HRT
+ * work for PT work spread over more workers. A part left with one
+ * configuration gets make_at_unit(), i.e. its specialized engine if any.
+ *
+ * With arenas, each entry of units is built, tables included, in the arena
+ * ArenaSet::next() deals it, and gets that worker as its home_worker (with
+ * more than one arena). The arenas must outlive the sweep.
+ */
+ATSweep make_at_sweep(const std::vector<ATConfig>& configs, const EngineOptions& opts = {},
+                      ArenaSet* arenas = nullptr);
+
+} // namespace bp
+
+#endif // BP_AT_REGISTRY_HPP
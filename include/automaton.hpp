@@ -1,7 +1,9 @@
 #ifndef BP_AUTOMATON_HPP
 #define BP_AUTOMATON_HPP
 
+#include <cstddef>
 #include <cstdint>
+#include <string>
 #include "types.hpp"
 
 namespace bp {
@@ -11,22 +13,88 @@ namespace bp {
  *
  *   - LastTime: stores only the last outcome (1 bit).
  *   - A2      : 2-bit saturating up/down counter.
- *   - A3, A4  : similar style counters with more states; in this project we
- *               implement them identically to A2 but keep them as distinct
- *               enum values so that the code structure matches the paper.
+ *   - A3, A4  : 4-state variants of A2 whose weak states jump to the
+ *               strongly-taken state on a taken outcome (see kA3Automaton
+ *               and kA4Automaton).
+ *
+ * Values past A4 are user-defined automata, registered at run time by
+ * define_automaton() (e.g. from --fsm).
  *
  * The paper's notation:
  *   - S_c   : pattern history bits ("state")
  *   - A(S_c): prediction decision function
  *   - δ     : state transition function
  */
-enum class AutomatonType {
+enum class AutomatonType : std::uint8_t {
     LastTime,
     A2,
     A3,
     A4
 };
 
+// Most states an automaton may have, so a state fits in 4 bits.
+constexpr unsigned kMaxAutomatonStates = 16;
+
+// Most user-defined automata per process.
+constexpr unsigned kMaxUserAutomata = 64;
+
+/**
+ * AutomatonTable: an automaton as lookup tables, so that A(S_c) and
+ * δ(S_c, R) are one load each with no data-dependent branch.
+ *
+ *   - delta[S][R] : next state from S on outcome R (0 = not taken,
+ *                   1 = taken); rows past `states` are unused;
+ *   - taken_states: bit S set if state S predicts taken;
+ *   - init        : initial state S_0;
+ *   - states      : number of states, 2..kMaxAutomatonStates.
+ */
+struct AutomatonTable {
+    std::uint8_t  delta[kMaxAutomatonStates][2];
+    std::uint16_t taken_states;
+    std::uint8_t  init;
+    std::uint8_t  states;
+
+    constexpr bool predict(std::uint8_t s) const { return ((taken_states >> s) & 1u) != 0; }
+
+    constexpr std::uint8_t next(std::uint8_t s, Outcome o) const {
+        return delta[s][static_cast<std::uint8_t>(o)];
+    }
+};
+
+/**
+ * The built-in automata. States 0/1 predict not taken and 2/3 taken for
+ * the 4-state machines; all but Last-Time start in state 3 (strongly
+ * taken), Last-Time in state 1 (taken), following Section 4.2.
+ *
+ *   Last-Time: S = last outcome.
+ *   A2       : T: 0→1→2→3→3      N: 3→2→1→0→0
+ *   A3       : T: 0→1, 1→3, 2→3   N: 3→2, 2→0, 1→0
+ *              (a weak state moves to the strong state of the outcome)
+ *   A4       : T: 0→1, 1→3, 2→3   N: 3→2→1→0
+ *              (quick to taken, counts down to not taken)
+ */
+inline constexpr AutomatonTable kLastTimeAutomaton = {{{0, 1}, {0, 1}}, 0b10, 1, 2};
+inline constexpr AutomatonTable kA2Automaton = {{{0, 1}, {0, 2}, {1, 3}, {2, 3}}, 0b1100, 3, 4};
+inline constexpr AutomatonTable kA3Automaton = {{{0, 1}, {0, 3}, {0, 3}, {2, 3}}, 0b1100, 3, 4};
+inline constexpr AutomatonTable kA4Automaton = {{{0, 1}, {0, 3}, {1, 3}, {2, 3}}, 0b1100, 3, 4};
+
+// Table of a user-defined automaton (automaton.cpp).
+const AutomatonTable& user_automaton_table(AutomatonType t);
+
+/**
+ * Table of any automaton. For a constant built-in t this folds to the
+ * constexpr table, so the specialized engines index it directly.
+ */
+constexpr const AutomatonTable& automaton_table(AutomatonType t) {
+    switch (t) {
+        case AutomatonType::LastTime: return kLastTimeAutomaton;
+        case AutomatonType::A2:       return kA2Automaton;
+        case AutomatonType::A3:       return kA3Automaton;
+        case AutomatonType::A4:       return kA4Automaton;
+    }
+    return user_automaton_table(t);
+}
+
 /**
  * Initial state S_0 for each automaton.
  *
@@ -34,18 +102,27 @@ enum class AutomatonType {
  *   - For A1/A2/A3/A4, initialize to state 3 (strongly taken).
  *   - For Last-Time, initialize to predict taken (state = 1).
  */
-inline std::uint8_t automaton_init_state(AutomatonType t) {
-    switch (t) {
-        case AutomatonType::LastTime:
-            // Last outcome = Taken
-            return 1;
-        case AutomatonType::A2:
-        case AutomatonType::A3:
-        case AutomatonType::A4:
-        default:
-            // Strongly taken (2-bit counter = 3)
-            return 3;
-    }
+constexpr std::uint8_t automaton_init_state(AutomatonType t) {
+    return automaton_table(t).init;
+}
+
+/**
+ * Number of bits needed to store one state S_c, ceil(log2(states)):
+ *   - Last-Time: 1 bit (last outcome)
+ *   - A2/A3/A4 : 2 bits (4 states)
+ *   - user     : 1..4 bits
+ */
+constexpr unsigned automaton_state_bits(AutomatonType t) {
+    unsigned bits = 1;
+    while ((1u << bits) < automaton_table(t).states) ++bits;
+    return bits;
+}
+
+// Bits per entry of a packed PT: automaton_state_bits() rounded up to a
+// divisor of 64 (1, 2 or 4).
+constexpr unsigned automaton_packed_bits(AutomatonType t) {
+    const unsigned bits = automaton_state_bits(t);
+    return bits == 3 ? 4u : bits;
 }
 
 /**
@@ -54,56 +131,37 @@ inline std::uint8_t automaton_init_state(AutomatonType t) {
  * Returns:
  *   true  → predict Taken
  *   false → predict Not taken
- *
- * For Last-Time:
- *   - state is just the last outcome bit.
- *
- * For A2/A3/A4 (2-bit counter style):
- *   - states 2 and 3 predict Taken
- *   - states 0 and 1 predict Not taken
  */
-inline bool automaton_predict(AutomatonType t, std::uint8_t state) {
-    switch (t) {
-        case AutomatonType::LastTime:
-            return (state & 1u) != 0;
-        case AutomatonType::A2:
-        case AutomatonType::A3:
-        case AutomatonType::A4:
-        default:
-            return state >= 2;
-    }
+constexpr bool automaton_predict(AutomatonType t, std::uint8_t state) {
+    return automaton_table(t).predict(state);
+}
+
+// State transition δ(S_c, R_{i,c}).
+constexpr std::uint8_t automaton_next(AutomatonType t,
+                                      std::uint8_t state,
+                                      Outcome o) {
+    return automaton_table(t).next(state, o);
 }
 
+// True if every state in [states, states + n) is a state of t, e.g. for a
+// PT restored from a snapshot.
+bool automaton_states_valid(AutomatonType t, const std::uint8_t* states, std::size_t n);
+
+// Name of t: LT, A2, A3, A4, or the name given to define_automaton().
+const char* automaton_name(AutomatonType t);
+
+// The automaton called name (built-in or user-defined); false if none.
+bool find_automaton(const std::string& name, AutomatonType& out);
+
 /**
- * State transition δ(S_c, R_{i,c}).
- *
- * For Last-Time:
- *   - overwrite with the last outcome's bit.
- *
- * For A2/A3/A4:
- *   - standard saturating up/down counter:
- *     * Taken     → increment (up to max 3)
- *     * NotTaken → decrement (down to min 0)
+ * Register a user-defined automaton under name (letters and digits) and
+ * set out to its type. Fails with error set if the name is invalid or
+ * taken, the table is inconsistent (a transition, S_0 or predicting state
+ * outside 0..states-1) or kMaxUserAutomata are already defined. Meant to be
+ * called before simulating: the tables are never removed or changed.
  */
-inline std::uint8_t automaton_next(AutomatonType t,
-                                   std::uint8_t state,
-                                   Outcome o) {
-    switch (t) {
-        case AutomatonType::LastTime:
-            return (o == Outcome::Taken) ? 1 : 0;
-
-        case AutomatonType::A2:
-        case AutomatonType::A3:
-        case AutomatonType::A4:
-        default:
-            if (o == Outcome::Taken) {
-                if (state < 3) ++state;
-            } else {
-                if (state > 0) --state;
-            }
-            return state;
-    }
-}
+bool define_automaton(const std::string& name, const AutomatonTable& table,
+                      AutomatonType& out, std::string& error);
 
 } // namespace bp
 
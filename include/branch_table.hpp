@@ -0,0 +1,153 @@
+#ifndef BP_BRANCH_TABLE_HPP
+#define BP_BRANCH_TABLE_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+
+#include "aligned_alloc.hpp"
+#include "pc_map.hpp"
+#include "snapshot.hpp"
+#include "types.hpp"
+
+namespace bp {
+
+/**
+ * BranchTable<V>: one value per static branch, addressed by branch ID
+ * where the trace provides one (types.hpp) and by PC otherwise.
+ *
+ * Used for the tables of the ideal per-branch schemes (IHRT histories,
+ * bimodal counters):
+ *   - by ID, values sit in a flat array indexed by the ID, so a lookup is
+ *     a bounds check and one load, without hashing or probing;
+ *   - by PC, they sit in a PcMap (pc_map.hpp) as before.
+ *
+ * IDs are only valid within their space, so the array holds the entries of
+ * one space (use_ids()). A block of another space, or any PC access, first
+ * moves the array's entries into the PcMap, and an ID lookup that misses
+ * the array takes the branch's entry from the PcMap, if it has one. Each
+ * branch therefore keeps a single value whichever way it is reached, and
+ * results do not depend on whether the trace carries IDs. Snapshots use
+ * the PcMap layout; array entries are moved there first, in ID order, which
+ * is the order a PC-only run would have inserted them in.
+ *
+ * Pointers returned by find()/find_or_insert() stay valid until the next
+ * insertion or PC access.
+ */
+template <class V>
+class BranchTable {
+public:
+    // expected: number of static branches to size for up front (0 = small).
+    explicit BranchTable(std::size_t expected = 0) : map_(expected), expected_(expected) {}
+
+    // Address entries by the IDs of space from now on.
+    void use_ids(std::uint64_t space) {
+        if (space == space_) return;
+        fold();
+        space_ = space;
+    }
+
+    V* find(BranchId id, std::uint64_t pc) {
+        if (id < slots_.size() && slots_[id].used) return &slots_[id].value;
+        if (map_.size() == 0) return nullptr;
+        const V* v = map_.find(pc);
+        if (!v) return nullptr;
+        V& value = claim(id, pc); // already counted by map_
+        value    = *v;
+        return &value;
+    }
+
+    // Value for branch id (at pc), inserting init first if it has none.
+    V& find_or_insert(BranchId id, std::uint64_t pc, const V& init) {
+        if (V* v = find(id, pc)) return *v;
+        ++added_;
+        V& value = claim(id, pc);
+        value    = init;
+        return value;
+    }
+
+    void insert(BranchId id, std::uint64_t pc, const V& value) {
+        find_or_insert(id, pc, value) = value;
+    }
+
+    V* find(std::uint64_t pc) {
+        fold();
+        return map_.find(pc);
+    }
+
+    const V* find(std::uint64_t pc) const {
+        fold();
+        return map_.find(pc);
+    }
+
+    V& find_or_insert(std::uint64_t pc, const V& init) {
+        fold();
+        return map_.find_or_insert(pc, init);
+    }
+
+    void insert(std::uint64_t pc, const V& value) {
+        fold();
+        map_.insert(pc, value);
+    }
+
+    // Static branches with an entry.
+    std::size_t size() const { return map_.size() + added_; }
+
+    // Same layout as PcMap::save().
+    void save(SnapshotWriter& out) const {
+        fold();
+        map_.save(out);
+    }
+
+    void load(SnapshotReader& in) {
+        clear_slots();
+        map_.load(in);
+    }
+
+private:
+    struct Slot {
+        V    value;
+        bool used;
+    };
+
+    // Array entries and the PcMap only change together in fold(), which
+    // const accessors call too: it moves entries without changing any.
+    mutable PcMap<V>                  map_;
+    mutable TableVector<Slot>         slots_; // [id]
+    mutable TableVector<std::uint64_t> pcs_;  // [id], for fold()
+    mutable std::size_t               claimed_ = 0; // used slots
+    mutable std::size_t               added_   = 0; // used slots not in map_
+    std::uint64_t                     space_   = 0;
+    std::size_t                       expected_;
+
+    V& claim(BranchId id, std::uint64_t pc) {
+        if (id >= slots_.size()) {
+            const std::size_t n = std::max({std::size_t{id} + 1, slots_.size() * 2, expected_});
+            slots_.resize(n, Slot{V{}, false});
+            pcs_.resize(n, 0);
+        }
+        Slot& s = slots_[id];
+        s.used  = true;
+        pcs_[id] = pc;
+        ++claimed_;
+        return s.value;
+    }
+
+    void fold() const {
+        if (claimed_ == 0) return;
+        for (std::size_t id = 0; id < slots_.size(); ++id) {
+            if (slots_[id].used) map_.insert(pcs_[id], slots_[id].value);
+        }
+        clear_slots();
+    }
+
+    void clear_slots() const {
+        std::fill(slots_.begin(), slots_.end(), Slot{V{}, false});
+        claimed_ = 0;
+        added_   = 0;
+    }
+};
+
+} // namespace bp
+
+#endif // BP_BRANCH_TABLE_HPP
@@ -0,0 +1,74 @@
+#ifndef BP_BYTE_STREAM_HPP
+#define BP_BYTE_STREAM_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace bp {
+
+/**
+ * Compression formats recognised by open_byte_stream(), from the first
+ * bytes of the input.
+ */
+enum class Compression {
+    None,
+    Gzip, // 1f 8b
+    Xz,   // fd 37 7a 58 5a 00
+    Zstd  // 28 b5 2f fd
+};
+
+/**
+ * ByteStream: sequential, non-seekable input of (decompressed) trace bytes.
+ *
+ * Implementations only provide read_some(); read() and peek() add a small
+ * push-back buffer on top, so a reader can look at the first bytes (e.g.
+ * a magic number) without consuming them. read() returns 0 both at end of
+ * input and on error; ok()/error() tell the two apart.
+ */
+class ByteStream {
+public:
+    virtual ~ByteStream() = default;
+
+    // Read up to max bytes into buf; 0 at end of input or on error.
+    std::size_t read(char* buf, std::size_t max);
+
+    // Copy up to n upcoming bytes into buf without consuming them.
+    std::size_t peek(char* buf, std::size_t n);
+
+    bool ok() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+
+    // Name for messages: the path, or "<stdin>".
+    const std::string& name() const { return name_; }
+
+protected:
+    explicit ByteStream(std::string name) : name_(std::move(name)) {}
+
+    virtual std::size_t read_some(char* buf, std::size_t max) = 0;
+
+    std::string error_;
+
+private:
+    std::string name_;
+    std::string pushback_; // peeked bytes not yet consumed
+};
+
+/**
+ * Open path for streaming: "-" is standard input, anything else is opened
+ * with open(2), so FIFOs and character devices work as well as files.
+ *
+ * gzip, xz and zstd input is decompressed on the fly, using zlib, liblzma
+ * or libzstd when the build found them (BP_HAVE_ZLIB / BP_HAVE_LZMA /
+ * BP_HAVE_ZSTD) and otherwise the gzip / xz / zstd command, which is fed
+ * the opened input through a pipe (so the fallback handles FIFOs and
+ * standard input too). Always returns a stream; check ok() before use.
+ */
+std::unique_ptr<ByteStream> open_byte_stream(const std::string& path);
+
+// True for the path naming standard input.
+inline bool is_stdin_path(const std::string& path) { return path == "-"; }
+
+} // namespace bp
+
+#endif // BP_BYTE_STREAM_HPP
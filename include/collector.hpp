@@ -0,0 +1,185 @@
+#ifndef BP_COLLECTOR_HPP
+#define BP_COLLECTOR_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "pc_map.hpp"
+
+namespace bp {
+
+/**
+ * Collector policies for the batched simulation loops.
+ *
+ * Every simulate_batch() loop is a template on a Collector and calls
+ *
+ *     collector.record(pc, correct);
+ *
+ * once per dynamic branch. Units pick the policy once per block:
+ *
+ *   - NoCollector: record() is empty and inlines away, so the default
+ *     loops compile to exactly what they were without collection;
+ *   - BranchStatsCollector: per-interval and per-static-branch counts in
+ *     flat arrays;
+ *   - HitLogCollector: the correctness of every branch of the block, for
+ *     predictors built on this unit's predictions (hybrid.hpp).
+ */
+struct NoCollector {
+    static constexpr bool kEnabled = false;
+
+    void record(std::uint64_t /*pc*/, bool /*correct*/) {}
+};
+
+/**
+ * BranchStatsCollector: detailed statistics for one predictor.
+ *
+ *   - Time series: branches and mispredictions of every interval of
+ *     `interval` consecutive (measured) branches, from which accuracy and
+ *     mispredictions per 1000 branches are derived.
+ *   - Per static branch: executions and mispredictions, for finding the
+ *     branches that cost the most accuracy (top()).
+ *
+ * Static branches get dense IDs on first sight (one PcMap probe per
+ * branch); the counters are plain arrays indexed by ID, pre-sized from the
+ * trace's static-branch count when known.
+ */
+class BranchStatsCollector {
+public:
+    static constexpr bool kEnabled = true;
+
+    explicit BranchStatsCollector(std::uint64_t interval, std::size_t expected_branches = 0)
+        : interval_(interval), ids_(expected_branches) {
+        pcs_.reserve(expected_branches);
+        executions_.reserve(expected_branches);
+        mispredicts_.reserve(expected_branches);
+    }
+
+    void record(std::uint64_t pc, bool correct) {
+        std::uint32_t& id = ids_.find_or_insert(pc, kNoId);
+        if (id == kNoId) {
+            id = static_cast<std::uint32_t>(pcs_.size());
+            pcs_.push_back(pc);
+            executions_.push_back(0);
+            mispredicts_.push_back(0);
+        }
+        const std::uint32_t miss = correct ? 0u : 1u;
+        ++executions_[id];
+        mispredicts_[id] += miss;
+
+        interval_misses_ += miss;
+        if (++interval_branches_ == interval_) close_interval();
+    }
+
+    // Close a partially filled last interval (idempotent).
+    void finish() {
+        if (interval_branches_ != 0) close_interval();
+    }
+
+    struct Interval {
+        std::uint64_t branches;
+        std::uint64_t mispredicts;
+    };
+
+    struct Branch {
+        std::uint64_t pc;
+        std::uint64_t executions;
+        std::uint64_t mispredicts;
+    };
+
+    std::uint64_t interval() const { return interval_; }
+    const std::vector<Interval>& intervals() const { return series_; }
+    std::size_t static_branches() const { return pcs_.size(); }
+
+    // The n static branches with the most mispredictions, worst first.
+    std::vector<Branch> top(std::size_t n) const;
+
+private:
+    static constexpr std::uint32_t kNoId = ~std::uint32_t{0};
+
+    std::uint64_t interval_;
+    std::uint64_t interval_branches_ = 0;
+    std::uint64_t interval_misses_   = 0;
+    std::vector<Interval> series_;
+
+    PcMap<std::uint32_t>       ids_;          // pc → dense ID
+    std::vector<std::uint64_t> pcs_;          // ID → pc
+    std::vector<std::uint64_t> executions_;   // ID → dynamic executions
+    std::vector<std::uint64_t> mispredicts_;  // ID → mispredictions
+
+    void close_interval() {
+        series_.push_back({interval_branches_, interval_misses_});
+        interval_branches_ = 0;
+        interval_misses_   = 0;
+    }
+};
+
+/**
+ * HitLog: whether each branch of a unit's most recent block was predicted
+ * correctly. With the outcome this recovers the prediction itself, so a
+ * hybrid can combine its components' predictions without re-running them.
+ */
+struct HitLog {
+    std::vector<std::uint8_t> hits; // 1 = correct, per record of the block
+};
+
+/**
+ * HitLogCollector: fills a HitLog for one block, and forwards to the
+ * unit's BranchStatsCollector when it has one as well.
+ */
+class HitLogCollector {
+public:
+    static constexpr bool kEnabled = true;
+
+    HitLogCollector(HitLog& log, std::size_t n, BranchStatsCollector* stats) : stats_(stats) {
+        if (log.hits.size() < n) log.hits.resize(n);
+        out_ = log.hits.data();
+    }
+
+    void record(std::uint64_t pc, bool correct) {
+        *out_++ = correct ? 1u : 0u;
+        if (stats_) stats_->record(pc, correct);
+    }
+
+private:
+    std::uint8_t*         out_;
+    BranchStatsCollector* stats_;
+};
+
+/**
+ * Call f(collector) with the policy a unit needs for an n-record block:
+ * HitLogCollector if log is set, else *stats if set, else NoCollector.
+ */
+template <class F>
+void with_collector(BranchStatsCollector* stats, HitLog* log, std::size_t n, F&& f) {
+    if (log) {
+        HitLogCollector c(*log, n, stats);
+        f(c);
+    } else if (stats) {
+        f(*stats);
+    } else {
+        NoCollector none;
+        f(none);
+    }
+}
+
+/**
+ * CSV reports for a set of collectors, one per scheme:
+ *
+ *   intervals: scheme,interval,branches,mispredicts,accuracy,mpkb
+ *   branches : scheme,rank,pc,executions,mispredicts,accuracy
+ *
+ * accuracy is in %, mpkb = mispredictions per 1000 branches, and the
+ * branch report lists the top_n worst branches of each scheme.
+ */
+void write_interval_csv(std::ostream& out, const std::vector<std::string>& schemes,
+                        const std::vector<const BranchStatsCollector*>& collectors);
+void write_top_branches_csv(std::ostream& out, const std::vector<std::string>& schemes,
+                            const std::vector<const BranchStatsCollector*>& collectors,
+                            std::size_t top_n);
+
+} // namespace bp
+
+#endif // BP_COLLECTOR_HPP
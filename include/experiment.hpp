@@ -0,0 +1,158 @@
+#ifndef BP_EXPERIMENT_HPP
+#define BP_EXPERIMENT_HPP
+
+#include <cstddef>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "at_config.hpp"
+#include "at_registry.hpp"
+#include "collector.hpp"
+#include "hybrid.hpp"
+#include "predictor_registry.hpp"
+#include "stats.hpp"
+#include "sweep.hpp"
+#include "trace.hpp"
+
+namespace bp {
+
+/**
+ * ResultRow: one line of the results CSV,
+ *   benchmark,scheme,total,correct,accuracy,hw_bits,
+ *   hrt_hits,hrt_misses,hrt_evictions,hrt_cold,
+ *   pt_used,pt_aliased,pt_pcs_per_entry
+ * with accuracy in %. The columns after hw_bits are the HRTCounters
+ * (hrt.hpp) and PTAliasSummary (pattern_table.hpp) of the configuration;
+ * all of them are 0 for the baselines, as is hw_bits unless the predictor
+ * models its storage. The HRT counters cover the branches of stats; the
+ * PT aliasing covers every branch simulated, warm-up included.
+ */
+struct ResultRow {
+    std::string    benchmark;
+    std::string    scheme;
+    Stats          stats;
+    std::size_t    hw_bits = 0;
+    HRTCounters    hrt;
+    PTAliasSummary pt_alias;
+};
+
+// The CSV header line (without newline).
+extern const char* const kResultsCsvHeader;
+
+// Write rows (no header) in the format of kResultsCsvHeader.
+void write_csv_rows(std::ostream& out, const std::vector<ResultRow>& rows);
+
+/**
+ * SimSet: every predictor simulated on one trace: the AT configurations
+ * (as built by make_at_sweep()), the registry predictors
+ * (predictor_registry.hpp), by default the two baselines, and the hybrids
+ * over both (hybrid.hpp).
+ *
+ * With opts.arena_workers, the AT units and the hybrids are built in an
+ * ArenaSet of that many arenas (arena.hpp), one per run_parallel() worker,
+ * and freed with it. Registry predictors are built by the caller, on the
+ * heap.
+ */
+struct SimSet {
+    // With the default_predictors().
+    SimSet(const std::vector<ATConfig>& configs, const EngineOptions& opts);
+
+    /**
+     * With predictors built by make_predictors(), and hybrids whose
+     * components are among configs and predictors (see check_hybrids()).
+     */
+    SimSet(const std::vector<ATConfig>& configs, const EngineOptions& opts,
+           std::vector<std::unique_ptr<PredictorUnit>> predictors,
+           const std::vector<HybridConfig>& hybrids = {});
+
+    // Declared first, so destroyed after every unit placed in it.
+    std::unique_ptr<ArenaSet> arenas;
+
+    ATSweep                                     sweep;
+    std::vector<std::unique_ptr<PredictorUnit>> predictors;
+    std::vector<std::unique_ptr<HybridSim>>     hybrids;
+
+    // Drives the hybrids and their components; null without hybrids.
+    std::unique_ptr<HybridGroup> hybrid_group;
+
+    /**
+     * Units to schedule: sweep.units, then the predictors, except that the
+     * units driving hybrid components are replaced by the hybrid group at
+     * the end.
+     */
+    std::vector<SimUnit*> units();
+
+    // The Stats behind each result row, in append_rows() order.
+    std::vector<Stats*> reported_stats();
+
+    // The configurations, whose rows also report HRT counters.
+    std::vector<ATUnit*> at_units();
+
+    // Zero every reported Stats and HRT counter (e.g. after restoring a
+    // warm-up snapshot).
+    void reset_stats();
+
+    // Result rows in reporting order: configs, predictors, hybrids.
+    void append_rows(const std::string& benchmark, std::vector<ResultRow>& rows) const;
+
+    // Scheme names in append_rows() order.
+    std::vector<std::string> scheme_names() const;
+
+    /**
+     * Attach a BranchStatsCollector (collector.hpp) with the given interval
+     * to every reported unit; collectors are in append_rows() order.
+     * expected_branches pre-sizes the per-branch arrays.
+     */
+    void enable_collectors(std::uint64_t interval, std::size_t expected_branches);
+
+    std::vector<std::unique_ptr<BranchStatsCollector>> collectors;
+};
+
+/**
+ * Check that every hybrid's components exist: its AT configuration among
+ * configs (parse_hybrid_spec() ensures that) and Bimodal2Bit among the
+ * predictor specs. Returns false with error set otherwise.
+ */
+bool check_hybrids(const std::vector<HybridConfig>& hybrids,
+                   const std::vector<ATConfig>& configs,
+                   const std::vector<std::string>& predictor_specs, std::string& error);
+
+/**
+ * TraceSpec: a trace named on the command line as LABEL=PATH, or PATH alone,
+ * in which case the label is the file name without directory and
+ * extension.
+ */
+struct TraceSpec {
+    std::string label;
+    std::string path;
+};
+
+TraceSpec parse_trace_spec(const std::string& arg);
+
+/**
+ * TraceJob: one trace of a multi-trace run together with its SimSet.
+ */
+struct TraceJob {
+    std::string                  label;
+    std::unique_ptr<LoadedTrace> trace;
+    std::unique_ptr<SimSet>      sims;
+};
+
+/**
+ * Simulate every unit of every job. Each (trace, unit) pair is an
+ * independent work item that walks the whole trace through its own cursor,
+ * so items may run on any thread in any order with results identical to a
+ * serial run.
+ *
+ * Items are dealt to per-worker queues longest-first (cost = trace length)
+ * onto the least-loaded worker; a worker whose queue runs dry steals from
+ * the back of the others, which keeps all threads busy when traces differ
+ * widely in length.
+ */
+void run_trace_jobs(std::vector<TraceJob>& jobs, unsigned threads);
+
+} // namespace bp
+
+#endif // BP_EXPERIMENT_HPP
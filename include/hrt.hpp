@@ -1,10 +1,22 @@
 #ifndef BP_HRT_HPP
 #define BP_HRT_HPP
 
+#include <cstddef>
 #include <cstdint>
-#include <unordered_map>
+#include <memory>
 #include <vector>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "aligned_alloc.hpp"
+#include "branch_table.hpp"
+#include "index_hash.hpp"
+#include "replacement.hpp"
+#include "snapshot.hpp"
+#include "types.hpp"
+
 namespace bp {
 
 /**
@@ -16,18 +28,68 @@ namespace bp {
  *
  * - AHRT: Associative History Register Table
  *         * Implemented as N-entry, W-way set-associative cache.
- *         * Lower bits of PC index the set, higher bits form a tag.
- *         * Uses round-robin for replacement (simplified LRU).
+ *         * Lower bits of PC index the set, higher bits form a tag
+ *           (other index functions: index_hash.hpp).
+ *         * Replacement policy is a parameter (replacement.hpp); the
+ *           default is round-robin (simplified LRU).
  *
  * - HHRT: Hash History Register Table
  *         * Implemented as a fixed-size direct-mapped table.
- *         * Index is a hash of PC (we use simple PC>>2 & mask).
+ *         * Index is a hash of PC (by default simple PC>>2 & mask;
+ *           see index_hash.hpp).
  *         * No tags, so collisions cause history interference.
+ *
+ * - GHR : Global History Register (the first level of GAg/GAs/gshare)
+ *         * A single k-bit register shared by all branches, so the first
+ *           level costs O(1) per branch; see PTSelect (pattern_table.hpp).
  */
 enum class HRTKind {
     AHRT,
     HHRT,
-    IHRT
+    IHRT,
+    GHR
+};
+
+/**
+ * HRTSlot: handle to the history register of one branch, returned by
+ * HistoryTable::lookup() and consumed by HistoryTable::commit().
+ *
+ * A lookup performs the (only) tag search for a dynamic branch; predict
+ * and update then share the handle. lookup() never changes the table: an
+ * AHRT miss only records which victim line would be used, and the line is
+ * allocated when the new history is committed.
+ */
+struct HRTSlot {
+    History        history = 0;       // history register value at lookup time
+    History*       entry   = nullptr; // register storage (nullptr: not allocated yet)
+    std::uint32_t  set     = 0;       // AHRT: set of the line
+    std::uint32_t  way     = 0;       // AHRT: matching or victim way
+    std::uint32_t  tag     = 0;       // AHRT: tag to install on a miss
+    std::uint64_t  pc      = 0;       // IHRT: key to insert on a miss; HHRT: new owner
+    BranchId       id      = kNoBranchId; // IHRT: branch ID to insert under, if any
+    bool           hit     = true;    // false if commit() must allocate
+};
+
+/**
+ * HRTCounters: first-level behaviour of one HRT, counted by commit() for
+ * every dynamic branch:
+ *
+ *   - hits      : the branch found its own history register (IHRT: PC
+ *                 known; AHRT: tag match; HHRT: slot last used by this PC);
+ *   - misses    : all other accesses, i.e. evictions + cold;
+ *   - evictions : the register belonged to another branch (a valid AHRT
+ *                 victim line, or an HHRT collision), so the branch starts
+ *                 from an interfering history (Section 3.1);
+ *   - cold      : the register had never been used.
+ *
+ * These explain accuracy-vs-cost curves: a small AHRT/HHRT loses accuracy
+ * exactly where evictions grow.
+ */
+struct HRTCounters {
+    std::uint64_t hits      = 0;
+    std::uint64_t misses    = 0;
+    std::uint64_t evictions = 0;
+    std::uint64_t cold      = 0;
 };
 
 /**
@@ -39,19 +101,35 @@ enum class HRTKind {
  */
 class HistoryTable {
 public:
+    /**
+     * Concrete tables that set this also provide lookup(id, pc) and
+     * use_ids(space), addressing branches by their branch ID (types.hpp);
+     * the batched loops then use it when the trace has IDs.
+     */
+    static constexpr bool kByBranchId = false;
+
     virtual ~HistoryTable() = default;
 
     /**
-     * Get the current k-bit history for the branch at PC.
-     * If the branch has not been seen before, the implementation should
-     * return a reasonable default (paper uses all 1s to bias to taken).
+     * Find the history register for the branch at PC. If the branch has
+     * not been seen before, slot.history is a reasonable default (paper
+     * uses all 1s to bias to taken), or the interfering history of the
+     * line that will be reused for it.
      */
-    virtual std::uint16_t get(std::uint64_t pc) = 0;
+    virtual HRTSlot lookup(std::uint64_t pc) = 0;
 
     /**
-     * Set the current k-bit history for the branch at PC.
+     * Store the new history for the branch looked up in slot, allocating
+     * its entry on a miss. The slot must come from lookup() on this table
+     * with no other commit() in between.
      */
-    virtual void set(std::uint64_t pc, std::uint16_t history) = 0;
+    virtual void commit(const HRTSlot& slot, History history) = 0;
+
+    // Get the current k-bit history for the branch at PC.
+    History get(std::uint64_t pc) { return lookup(pc).history; }
+
+    // Set the current k-bit history for the branch at PC.
+    void set(std::uint64_t pc, History history) { commit(lookup(pc), history); }
 
     /**
      * Capacity in entries (for approximate hardware cost calculation).
@@ -59,53 +137,227 @@ public:
      * For AHRT/HHRT, it is the fixed table size.
      */
     virtual std::size_t capacity_entries() const = 0;
+
+    /**
+     * Dump / restore the table contents (snapshot.hpp). load() expects a
+     * snapshot of a table with the same geometry.
+     */
+    virtual void save(SnapshotWriter& out) const = 0;
+    virtual void load(SnapshotReader& in) = 0;
+
+    // Access counters since construction (part of the snapshot).
+    const HRTCounters& counters() const { return counters_; }
+
+    // Replace the counters, e.g. to drop the accesses of a warm-up.
+    void set_counters(const HRTCounters& c) { counters_ = c; }
+
+protected:
+    HRTCounters counters_;
 };
 
 /**
  * IHRT: Ideal History Register Table.
  *
- * - Implemented with an std::unordered_map<PC, history>.
+ * - Implemented with a BranchTable<history> (branch_table.hpp): a flat
+ *   array indexed by branch ID when the trace provides IDs, else a PcMap
+ *   (open addressing, see pc_map.hpp), optionally pre-sized to the
+ *   trace's static-branch count.
  * - Conceptually infinite capacity (limited only by memory).
  * - Used to model the upper bound on AT performance with no interference.
  */
-class IHRTTable : public HistoryTable {
+class IHRTTable final : public HistoryTable {
 public:
-    explicit IHRTTable(int history_bits);
+    static constexpr bool kByBranchId = true;
+
+    explicit IHRTTable(int history_bits, std::size_t expected_branches = 0);
+
+    /**
+     * Look up the history for PC.
+     * If PC has not been seen before, report all 1s as in Section 4.2
+     * (bias initial state to Taken); commit() then inserts it.
+     */
+    HRTSlot lookup(std::uint64_t pc) override {
+        HRTSlot slot;
+        if (History* h = table_.find(pc)) {
+            slot.history = *h;
+            slot.entry   = h;
+        } else {
+            slot.history = init_history_;
+            slot.hit     = false;
+            slot.pc      = pc;
+        }
+        return slot;
+    }
+
+    // The same lookup for branch id of space use_ids() (kByBranchId).
+    HRTSlot lookup(BranchId id, std::uint64_t pc) {
+        HRTSlot slot;
+        if (History* h = table_.find(id, pc)) {
+            slot.history = *h;
+            slot.entry   = h;
+        } else {
+            slot.history = init_history_;
+            slot.hit     = false;
+            slot.pc      = pc;
+            slot.id      = id;
+        }
+        return slot;
+    }
+
+    void use_ids(std::uint64_t space) { table_.use_ids(space); }
+
+    // Store the updated history for PC.
+    void commit(const HRTSlot& slot, History history) override {
+        if (slot.entry) {
+            ++counters_.hits;
+            *slot.entry = history;
+        } else {
+            ++counters_.misses;
+            ++counters_.cold;
+            if (slot.id != kNoBranchId) table_.insert(slot.id, slot.pc, history);
+            else                        table_.insert(slot.pc, history);
+        }
+    }
 
-    std::uint16_t get(std::uint64_t pc) override;
-    void set(std::uint64_t pc, std::uint16_t history) override;
     std::size_t capacity_entries() const override;
 
+    void save(SnapshotWriter& out) const override {
+        table_.save(out);
+        out.write(counters_);
+    }
+
+    void load(SnapshotReader& in) override {
+        table_.load(in);
+        in.read(counters_);
+    }
+
 private:
     int history_bits_;
-    std::uint16_t init_history_;
-    std::unordered_map<std::uint64_t, std::uint16_t> table_;
+    History init_history_;
+    BranchTable<History> table_;
+};
+
+/**
+ * GHR: Global History Register.
+ *
+ * - One register, updated by every branch with its outcome.
+ * - Every access counts as a hit: there is no per-branch register to miss.
+ */
+class GlobalHistoryTable final : public HistoryTable {
+public:
+    explicit GlobalHistoryTable(int history_bits) : reg_(history_mask(history_bits)) {}
+
+    HRTSlot lookup(std::uint64_t /*pc*/) override {
+        HRTSlot slot;
+        slot.entry   = &reg_;
+        slot.history = reg_;
+        return slot;
+    }
+
+    void commit(const HRTSlot& /*slot*/, History history) override {
+        ++counters_.hits;
+        reg_ = history;
+    }
+
+    std::size_t capacity_entries() const override { return 1; }
+
+    void save(SnapshotWriter& out) const override {
+        out.write(reg_);
+        out.write(counters_);
+    }
+
+    void load(SnapshotReader& in) override {
+        in.read(reg_);
+        in.read(counters_);
+    }
+
+private:
+    History reg_; // all 1s initially, as the per-address registers
 };
 
 /**
  * HHRT: Hash History Register Table.
  *
- * - Implemented as a simple array indexed by a hash of PC.
+ * - Implemented as a simple array indexed by a hash of PC; the Index
+ *   function (index_hash.hpp) is a template parameter, HHRTTable being the
+ *   original (PC >> 2) & (entries - 1).
  * - No tag stored → collisions lead to history reuse / interference.
  * - Represents a low-cost, but somewhat less accurate, design.
+ *
+ * The PC that last used each slot is kept alongside (owner_), only to
+ * tell hits from collisions in the counters; it is not part of the
+ * modelled hardware or of hardware_cost_bits().
  */
-class HHRTTable : public HistoryTable {
+template <class Index>
+class HHRTTableT final : public HistoryTable {
+    static_assert(!Index::kSkewed, "skewed indexing needs a set-associative table");
+
 public:
-    HHRTTable(int entries, int history_bits);
+    HHRTTableT(int entries, int history_bits)
+        : entries_(entries),
+          init_history_(history_mask(history_bits)),
+          index_(index_bits_for(entries)),
+          hist_(static_cast<std::size_t>(entries), init_history_),
+          owner_(static_cast<std::size_t>(entries), kNoOwner)
+    {}
 
-    std::uint16_t get(std::uint64_t pc) override;
-    void set(std::uint64_t pc, std::uint16_t history) override;
-    std::size_t capacity_entries() const override;
+    // Read the history from the hashed slot.
+    HRTSlot lookup(std::uint64_t pc) override {
+        HRTSlot slot;
+        slot.entry   = &hist_[index_.index(pc)];
+        slot.history = *slot.entry;
+        slot.pc      = pc;
+        return slot;
+    }
+
+    /**
+     * Write the history into the hashed slot.
+     * Note: collisions are not checked; this is the intended behavior to
+     * emulate hash collisions and interference. They are only counted.
+     */
+    void commit(const HRTSlot& slot, History history) override {
+        std::uint64_t& owner = owner_[static_cast<std::size_t>(slot.entry - hist_.data())];
+        if (owner == slot.pc) {
+            ++counters_.hits;
+        } else {
+            ++counters_.misses;
+            if (owner == kNoOwner) ++counters_.cold;
+            else                   ++counters_.evictions;
+            owner = slot.pc;
+        }
+        *slot.entry = history;
+    }
+
+    std::size_t capacity_entries() const override {
+        return static_cast<std::size_t>(entries_);
+    }
+
+    void save(SnapshotWriter& out) const override {
+        out.write_array(hist_);
+        out.write_array(owner_);
+        out.write(counters_);
+    }
+
+    void load(SnapshotReader& in) override {
+        in.read_span(hist_.data(), hist_.size());
+        in.read_span(owner_.data(), owner_.size());
+        in.read(counters_);
+    }
 
 private:
-    int entries_;
-    std::uint32_t mask_;
-    std::uint16_t init_history_;
-    std::vector<std::uint16_t> hist_;
+    static constexpr std::uint64_t kNoOwner = ~std::uint64_t{0};
 
-    std::uint32_t index(std::uint64_t pc) const;
+    int entries_;
+    History init_history_;
+    Index index_;                      // PC → slot
+    TableVector<History> hist_;
+    TableVector<std::uint64_t> owner_; // PC that last used each slot (counters only)
 };
 
+using HHRTTable    = HHRTTableT<LowIndex>;
+using XorHHRTTable = HHRTTableT<XorFoldIndex>;
+using MulHHRTTable = HHRTTableT<MulIndex>;
+
 /**
  * AHRT: Associative History Register Table.
  *
@@ -115,40 +367,235 @@ private:
  *     * tag
  *     * k-bit history register
  * - On miss:
- *     * Choose a victim way via round-robin (simplified LRU).
+ *     * Choose a victim way with the replacement Policy (replacement.hpp);
+ *       AHRTTable is the original round-robin (simplified LRU) table.
  *     * IMPORTANT: We do NOT reinitialize the history register when
  *                  we reassign a line to a new PC, which preserves the
  *                  interference behavior described by the paper.
+ *
+ * Storage is a flat structure of arrays rather than one object per line:
+ *   - tags_   : W tags per set, contiguous and cache-line aligned, so a
+ *               4-way set is 16 bytes and never straddles a line. The valid
+ *               bit is folded into the tag (bit 31); an invalid line holds 0.
+ *   - hist_   : the history registers, in the same [set][way] order.
+ *   - policy_ : the replacement state of every set.
+ * The way search compares 4 tags at a time with SSE2 where available.
+ *
+ * The Index function (index_hash.hpp) maps a PC to its set. With a skewed
+ * index, way w of the PC's line lives in set index(pc, w), so the W
+ * candidate lines are in different sets: they are searched one by one,
+ * invalid lines are always filled first, and the replacement state used
+ * is that of the way-0 set (slot.set).
  */
-class AHRTTable : public HistoryTable {
+template <class Policy, class Index = LowIndex>
+class AHRTTableT final : public HistoryTable {
 public:
-    AHRTTable(int entries, int ways, int history_bits);
+    AHRTTableT(int entries, int ways, int history_bits)
+        : entries_(entries),
+          ways_(ways),
+          sets_(entries / ways),
+          init_history_(history_mask(history_bits)),
+          index_(index_bits_for(entries / ways)),
+          policy_(entries / ways, ways)
+    {
+        // Initialize all entries as invalid with history = all 1s.
+        const std::size_t lines = static_cast<std::size_t>(sets_) * ways_;
+        tags_.assign(lines, 0u);
+        hist_.assign(lines, init_history_);
+    }
 
-    std::uint16_t get(std::uint64_t pc) override;
-    void set(std::uint64_t pc, std::uint16_t history) override;
-    std::size_t capacity_entries() const override;
+    /**
+     * Search the set for PC:
+     *   - On hit, the slot refers to the matching line.
+     *   - On miss, it refers to the line to reuse: an invalid way if the
+     *     policy does not fill those first by itself, else the policy's
+     *     victim. Its (stale) history is reported; commit() claims it.
+     */
+    HRTSlot lookup(std::uint64_t pc) override {
+        HRTSlot slot;
+        slot.set = index_.index(pc, 0);
+        slot.tag = index_.tag(pc);
 
-private:
-    struct Entry {
-        bool          valid;
-        std::uint32_t tag;
-        std::uint16_t history;
-    };
+        std::size_t line;
+        if constexpr (Index::kSkewed) {
+            line = skewed_line(pc, slot);
+        } else {
+            const std::size_t base = static_cast<std::size_t>(slot.set) * ways_;
+            int w = find_way(&tags_[base], slot.tag);
+            if (w < 0) {
+                slot.hit = false;
+                if constexpr (!Policy::kFillsInOrder) w = find_way(&tags_[base], 0u);
+                if (w < 0) w = policy_.victim(slot.set);
+            }
+            slot.way = static_cast<std::uint32_t>(w);
+            line     = base + static_cast<std::size_t>(w);
+        }
+        slot.entry   = &hist_[line];
+        slot.history = *slot.entry;
+        return slot;
+    }
 
+    /**
+     * Write the new history. On a miss this allocates the victim: we mark
+     * it valid and set its tag, but its history was NOT reset to the
+     * initial state, which preserves "interference" as described in
+     * Section 3.1.
+     */
+    void commit(const HRTSlot& slot, History history) override {
+        const int way = static_cast<int>(slot.way);
+        if (slot.hit) {
+            ++counters_.hits;
+            policy_.on_hit(slot.set, way);
+        } else {
+            std::uint32_t& tag = tags_[static_cast<std::size_t>(slot.entry - hist_.data())];
+            ++counters_.misses;
+            if (tag != 0) ++counters_.evictions;
+            else          ++counters_.cold;
+            tag = slot.tag;
+            policy_.on_fill(slot.set, way);
+        }
+        *slot.entry = history;
+    }
+
+    std::size_t capacity_entries() const override {
+        return static_cast<std::size_t>(entries_);
+    }
+
+    void save(SnapshotWriter& out) const override {
+        out.write_array(tags_);
+        out.write_array(hist_);
+        policy_.save(out);
+        out.write(counters_);
+    }
+
+    void load(SnapshotReader& in) override {
+        in.read_span(tags_.data(), tags_.size());
+        in.read_span(hist_.data(), hist_.size());
+        policy_.load(in);
+        in.read(counters_);
+    }
+
+private:
     int entries_;          // total number of lines (e.g., 512)
     int ways_;             // associativity (e.g., 4)
     int sets_;             // entries_ / ways_
-    std::uint16_t init_history_;
-    int set_index_bits_;   // log2(sets_)
+    History init_history_;
+    Index index_;          // PC → set, and the tag (31 bits plus the valid bit)
+
+    CacheAlignedVector<std::uint32_t> tags_;   // [set * ways_ + way], 0 = invalid
+    CacheAlignedVector<History>       hist_;   // [set * ways_ + way]
+    Policy                            policy_; // replacement state per set
 
-    std::vector<std::vector<Entry>> table_; // table_[set][way]
-    std::vector<int>                next_victim_; // round-robin pointer per set
+    // Skewed lookup: way w of pc is line index(pc, w) * W + w.
+    std::size_t skewed_line(std::uint64_t pc, HRTSlot& slot) const {
+        int free_way = -1;
+        for (int w = 0; w < ways_; ++w) {
+            const std::size_t line = static_cast<std::size_t>(index_.index(pc, w)) * ways_ +
+                                     static_cast<std::size_t>(w);
+            if (tags_[line] == slot.tag) {
+                slot.way = static_cast<std::uint32_t>(w);
+                return line;
+            }
+            if (free_way < 0 && tags_[line] == 0) free_way = w;
+        }
+        slot.hit = false;
+        const int w = (free_way >= 0) ? free_way : policy_.victim(slot.set);
+        slot.way    = static_cast<std::uint32_t>(w);
+        return static_cast<std::size_t>(index_.index(pc, w)) * ways_ + static_cast<std::size_t>(w);
+    }
 
-    std::uint32_t set_index(std::uint64_t pc) const;
-    std::uint32_t tag_for(std::uint64_t pc) const;
-    Entry& access(std::uint64_t pc);
+    // Index of the way holding tag in one set, or -1 on a miss.
+    int find_way(const std::uint32_t* tags, std::uint32_t tag) const {
+        int w = 0;
+#ifdef __SSE2__
+        const __m128i key = _mm_set1_epi32(static_cast<int>(tag));
+        for (; w + 4 <= ways_; w += 4) {
+            __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(tags + w));
+            int mask  = _mm_movemask_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(v, key)));
+            if (mask != 0) return w + __builtin_ctz(static_cast<unsigned>(mask));
+        }
+#endif
+        for (; w < ways_; ++w) {
+            if (tags[w] == tag) return w;
+        }
+        return -1;
+    }
 };
 
+using AHRTTable      = AHRTTableT<RoundRobinPolicy>;
+using LRUAHRTTable   = AHRTTableT<LRUPolicy>;
+using PLRUAHRTTable  = AHRTTableT<TreePLRUPolicy>;
+using RandAHRTTable  = AHRTTableT<RandomPolicy>;
+
+/**
+ * The lookup of a batched loop on a concrete HRT type: by ids[i] if ById
+ * (HRT::kByBranchId tables only), else by pc.
+ */
+template <bool ById, class HRT>
+HRTSlot lookup_branch(HRT& hrt, const BranchId* ids, std::size_t i, std::uint64_t pc) {
+    if constexpr (ById) return hrt.lookup(ids[i], pc);
+    else                return hrt.lookup(pc);
+}
+
+/**
+ * Construct the HRT of the given kind; entries, ways, policy and index
+ * apply to the kinds that have them. A skewed index is only valid for an
+ * AHRT (returns nullptr for an HHRT).
+ */
+std::unique_ptr<HistoryTable> make_history_table(HRTKind kind, int entries, int ways,
+                                                 ReplacementPolicy policy, IndexHash index,
+                                                 int history_bits,
+                                                 std::size_t expected_branches = 0);
+
+namespace detail {
+
+template <class Index, class F>
+void visit_ahrt(HistoryTable& table, ReplacementPolicy policy, F& f) {
+    switch (policy) {
+        case ReplacementPolicy::RoundRobin:
+            f(static_cast<AHRTTableT<RoundRobinPolicy, Index>&>(table)); return;
+        case ReplacementPolicy::LRU:
+            f(static_cast<AHRTTableT<LRUPolicy, Index>&>(table)); return;
+        case ReplacementPolicy::TreePLRU:
+            f(static_cast<AHRTTableT<TreePLRUPolicy, Index>&>(table)); return;
+        case ReplacementPolicy::Random:
+            f(static_cast<AHRTTableT<RandomPolicy, Index>&>(table)); return;
+    }
+}
+
+} // namespace detail
+
+/**
+ * Call f(table) with table cast to its concrete final type, so that a
+ * loop written as a template on the HRT type runs with every lookup() and
+ * commit() bound statically, index function included. kind, policy and
+ * index must be those the table was made with.
+ */
+template <class F>
+void visit_history_table(HistoryTable& table, HRTKind kind, ReplacementPolicy policy,
+                         IndexHash index, F&& f) {
+    switch (kind) {
+        case HRTKind::IHRT: f(static_cast<IHRTTable&>(table)); return;
+        case HRTKind::GHR:  f(static_cast<GlobalHistoryTable&>(table)); return;
+        case HRTKind::HHRT:
+            switch (index) {
+                case IndexHash::Low:     f(static_cast<HHRTTable&>(table));    return;
+                case IndexHash::XorFold: f(static_cast<XorHHRTTable&>(table)); return;
+                case IndexHash::Mul:     f(static_cast<MulHHRTTable&>(table)); return;
+                case IndexHash::Skewed:  return; // not constructible
+            }
+            return;
+        case HRTKind::AHRT:
+            switch (index) {
+                case IndexHash::Low:     detail::visit_ahrt<LowIndex>(table, policy, f);     return;
+                case IndexHash::XorFold: detail::visit_ahrt<XorFoldIndex>(table, policy, f); return;
+                case IndexHash::Mul:     detail::visit_ahrt<MulIndex>(table, policy, f);     return;
+                case IndexHash::Skewed:  detail::visit_ahrt<SkewedIndex>(table, policy, f);  return;
+            }
+            return;
+    }
+}
+
 } // namespace bp
 
 #endif // BP_HRT_HPP
@@ -0,0 +1,100 @@
+#ifndef BP_HYBRID_HPP
+#define BP_HYBRID_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "aligned_alloc.hpp"
+#include "at_config.hpp"
+#include "collector.hpp"
+#include "sweep.hpp"
+
+namespace bp {
+
+// Consecutive repeats after which the bias filter (HybridConfig) predicts
+// a chooser entry's branches statically.
+constexpr int kBiasRun = 7;
+
+/**
+ * HybridSim: one HybridConfig. It does not run its components: it reads
+ * their predictions for the current block from their HitLogs, so it must
+ * be advanced after them, which HybridGroup does.
+ */
+class HybridSim : public PredictorUnit {
+public:
+    // bimodal is the Bimodal2Bit unit; logs are the components' hit logs.
+    HybridSim(const HybridConfig& c, const ATUnit& at, const HitLog& at_log,
+              const PredictorUnit& bimodal, const HitLog& bimodal_log);
+
+    void run_block(const TraceBlock& block) override;
+
+    /**
+     * Both components plus the chooser: the cost each component reports in
+     * its own row (for the bimodal table, 2 bits per static branch), and per
+     * chooser entry 2 bits (+ 1 direction and 3 run bits with the filter).
+     */
+    std::size_t hardware_cost_bits() const override;
+
+    // Name, stats and chooser; the components are saved by their units.
+    void save(SnapshotWriter& out) const override;
+    void load(SnapshotReader& in) override;
+
+    HybridConfig cfg;
+
+private:
+    struct Entry {
+        std::uint8_t meta = 2; // 2-bit chooser, >= 2 selects the AT component
+        std::uint8_t dir  = 1; // bias filter: last outcome
+        std::uint8_t run  = 0; // bias filter: repeats of dir, saturating at kBiasRun
+    };
+
+    template <bool Filter, class Collector>
+    void run(const TraceBlock& block, Collector& collector);
+
+    const ATUnit&        at_;
+    const HitLog&        at_log_;
+    const PredictorUnit& bimodal_;
+    const HitLog&        bimodal_log_;
+    std::uint64_t        mask_;
+    TableVector<Entry>   table_;
+};
+
+/**
+ * HybridGroup: the scheduled unit for a set of hybrids. Per block it runs
+ * the units driving their components (AT units or shared-HRT groups, and
+ * the bimodal baseline) with hit logs attached, then every hybrid on those
+ * logs. The components are therefore simulated once, however many hybrids
+ * use them, and their own results are unchanged.
+ */
+class HybridGroup : public SimUnit {
+public:
+    // Take over scheduling of driver (added once, in call order).
+    void add_driver(SimUnit* driver);
+
+    // A log for component (attached as component->hit_log), shared by all
+    // hybrids using it.
+    const HitLog& log_for(SimUnit* component);
+
+    void add_hybrid(HybridSim* hybrid) { hybrids_.push_back(hybrid); }
+
+    const std::vector<SimUnit*>& drivers() const { return drivers_; }
+
+    void run_block(const TraceBlock& block) override;
+
+    // Every driver, then every hybrid.
+    void save(SnapshotWriter& out) const override;
+    void load(SnapshotReader& in) override;
+
+private:
+    std::vector<SimUnit*>                drivers_;
+    std::vector<HybridSim*>              hybrids_;
+    std::vector<SimUnit*>                logged_;
+    std::vector<std::unique_ptr<HitLog>> logs_;
+};
+
+} // namespace bp
+
+#endif // BP_HYBRID_HPP
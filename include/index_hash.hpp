@@ -0,0 +1,148 @@
+#ifndef BP_INDEX_HASH_HPP
+#define BP_INDEX_HASH_HPP
+
+#include <cstdint>
+
+namespace bp {
+
+/**
+ * IndexHash: how a finite HRT maps a PC to its set (AHRT) or slot (HHRT).
+ *
+ *   - Low   : the low bits of PC >> 2, as in the original simulator. Hot
+ *             branches that share low address bits collide.
+ *   - XorFold: the XOR of all index-wide fields of PC >> 2, so the upper
+ *             PC bits also take part.
+ *   - Mul   : multiplicative (Fibonacci) hashing, the top bits of
+ *             (PC >> 2) * 2^64/phi.
+ *   - Skewed: AHRT only; every way has its own multiplicative hash
+ *             (skewed-associative), so branches conflicting in one way
+ *             usually do not conflict in the others.
+ *
+ * The hardware cost is the same for all of them; only interference
+ * changes.
+ */
+enum class IndexHash {
+    Low,
+    XorFold,
+    Mul,
+    Skewed
+};
+
+/**
+ * Index function classes, the Index parameter of AHRTTableT and HHRTTableT
+ * (hrt.hpp). Each is built from the index width and provides
+ *
+ *   uint32_t index(pc, way) : set/slot for pc (way only matters if kSkewed)
+ *   uint32_t tag(pc)        : 31-bit tag identifying pc within its set,
+ *                             with the valid bit (bit 31) set
+ *
+ * Low and XorFold are invertible given the upper PC bits, so those alone
+ * form the tag; Mul and Skewed tag with the low 31 bits of PC >> 2.
+ */
+
+constexpr std::uint32_t kTagValidBit   = 0x80000000u;
+constexpr std::uint64_t kFibonacciHash = 0x9E3779B97F4A7C15ull;
+
+// Index width for a table of n sets or slots: ceil(log2(n)).
+constexpr int index_bits_for(int n) {
+    int bits = 0;
+    while ((1 << bits) < n) ++bits;
+    return bits;
+}
+
+class LowIndex {
+public:
+    static constexpr IndexHash kHash   = IndexHash::Low;
+    static constexpr bool      kSkewed = false;
+
+    explicit LowIndex(int index_bits)
+        : bits_(index_bits), mask_((std::uint32_t{1} << index_bits) - 1u) {}
+
+    std::uint32_t index(std::uint64_t pc, int /*way*/ = 0) const {
+        return static_cast<std::uint32_t>((pc >> 2) & mask_);
+    }
+
+    std::uint32_t tag(std::uint64_t pc) const {
+        return static_cast<std::uint32_t>(pc >> (2 + bits_)) | kTagValidBit;
+    }
+
+private:
+    int           bits_;
+    std::uint32_t mask_;
+};
+
+class XorFoldIndex {
+public:
+    static constexpr IndexHash kHash   = IndexHash::XorFold;
+    static constexpr bool      kSkewed = false;
+
+    explicit XorFoldIndex(int index_bits)
+        : bits_(index_bits), mask_((std::uint32_t{1} << index_bits) - 1u) {}
+
+    std::uint32_t index(std::uint64_t pc, int /*way*/ = 0) const {
+        if (bits_ == 0) return 0;
+        std::uint64_t x   = pc >> 2;
+        std::uint64_t idx = 0;
+        for (; x != 0; x >>= bits_) idx ^= x;
+        return static_cast<std::uint32_t>(idx & mask_);
+    }
+
+    // index = low ^ f(upper), so the upper bits identify pc in its set.
+    std::uint32_t tag(std::uint64_t pc) const {
+        return static_cast<std::uint32_t>(pc >> (2 + bits_)) | kTagValidBit;
+    }
+
+private:
+    int           bits_;
+    std::uint32_t mask_;
+};
+
+class MulIndex {
+public:
+    static constexpr IndexHash kHash   = IndexHash::Mul;
+    static constexpr bool      kSkewed = false;
+
+    explicit MulIndex(int index_bits) : bits_(index_bits) {}
+
+    std::uint32_t index(std::uint64_t pc, int /*way*/ = 0) const {
+        if (bits_ == 0) return 0;
+        return static_cast<std::uint32_t>(((pc >> 2) * kFibonacciHash) >> (64 - bits_));
+    }
+
+    std::uint32_t tag(std::uint64_t pc) const {
+        return static_cast<std::uint32_t>(pc >> 2) | kTagValidBit;
+    }
+
+private:
+    int bits_;
+};
+
+/**
+ * SkewedIndex: way w uses the multiplier kFibonacciHash * (2w + 1), which
+ * is odd for every w, so each way's hash is a different bijection of the
+ * PC before its top bits are taken.
+ */
+class SkewedIndex {
+public:
+    static constexpr IndexHash kHash   = IndexHash::Skewed;
+    static constexpr bool      kSkewed = true;
+
+    explicit SkewedIndex(int index_bits) : bits_(index_bits) {}
+
+    std::uint32_t index(std::uint64_t pc, int way) const {
+        if (bits_ == 0) return 0;
+        const std::uint64_t mul = kFibonacciHash * (2u * static_cast<std::uint64_t>(way) + 1u);
+        return static_cast<std::uint32_t>(((pc >> 2) * mul) >> (64 - bits_));
+    }
+
+    std::uint32_t tag(std::uint64_t pc) const {
+        return static_cast<std::uint32_t>(pc >> 2) | kTagValidBit;
+    }
+
+private:
+    int bits_;
+};
+
+} // namespace bp
+
+#endif // BP_INDEX_HASH_HPP
@@ -1,46 +1,334 @@
 #ifndef BP_PATTERN_TABLE_HPP
 #define BP_PATTERN_TABLE_HPP
 
+#include <algorithm>
 #include <cstdint>
 #include <cstddef>
 #include <vector>
 
+#include "aligned_alloc.hpp"
 #include "automaton.hpp"
+#include "pc_map.hpp"
+#include "snapshot.hpp"
+#include "types.hpp"
 
 namespace bp {
 
+/**
+ * PTLayout selects how PatternTable stores its automaton states:
+ *
+ *   - Bytes : one std::uint8_t per entry (fastest single access).
+ *   - Packed: automaton_packed_bits() per entry in 64-bit words, i.e. 1 bit
+ *             for Last-Time, 2 bits for A2/A3/A4 and up to 4 for
+ *             user-defined automata. A k=16 A2 PT then takes 16 KiB
+ *             instead of 64 KiB.
+ */
+enum class PTLayout {
+    Bytes,
+    Packed
+};
+
+/**
+ * Extract / replace entry idx of a table packed at Bits bits per entry.
+ * Bits must divide 64, so entries never straddle words.
+ */
+template <unsigned Bits>
+constexpr std::uint8_t packed_get(const std::uint64_t* words, std::uint32_t idx) {
+    static_assert(64 % Bits == 0, "entries must not straddle words");
+    constexpr unsigned kPerWord = 64 / Bits;
+    constexpr unsigned kMask    = (1u << Bits) - 1u;
+    return static_cast<std::uint8_t>(
+        (words[idx / kPerWord] >> ((idx % kPerWord) * Bits)) & kMask);
+}
+
+template <unsigned Bits>
+constexpr void packed_set(std::uint64_t* words, std::uint32_t idx, std::uint8_t value) {
+    static_assert(64 % Bits == 0, "entries must not straddle words");
+    constexpr unsigned      kPerWord = 64 / Bits;
+    constexpr std::uint64_t kMask    = (std::uint64_t{1} << Bits) - 1u;
+    const unsigned          shift    = (idx % kPerWord) * Bits;
+    std::uint64_t&          w        = words[idx / kPerWord];
+    w = (w & ~(kMask << shift)) | ((static_cast<std::uint64_t>(value) & kMask) << shift);
+}
+
+/**
+ * Largest PT index width used without an explicit request: histories
+ * longer than this are folded, so the PT never exceeds 2^20 entries unless
+ * the configuration asks for more.
+ */
+constexpr int kDefaultMaxPTIndexBits = 20;
+
+/**
+ * XOR-fold the low history_bits of h into index_bits bits. When
+ * history_bits <= index_bits this is just h masked to history_bits, i.e.
+ * the classic PT(2^k) indexing.
+ */
+constexpr std::uint32_t fold_history(History h, int history_bits, int index_bits) {
+    h &= history_mask(history_bits);
+    if (history_bits <= index_bits) return static_cast<std::uint32_t>(h);
+    const History m   = history_mask(index_bits);
+    History       idx = 0;
+    for (; h != 0; h >>= index_bits) idx ^= h & m;
+    return static_cast<std::uint32_t>(idx);
+}
+
+/**
+ * PTSelect: which pattern a branch uses to pick its PT entry, giving the
+ * second level of the Yeh–Patt variants (with a per-address HRT: PAg, PAs;
+ * with the global history register, HRTKind::GHR: GAg, GAs, gshare):
+ *
+ *   - Global: the history alone; one PT shared by all branches (xAg, the
+ *             scheme of the paper).
+ *   - PerSet: 2^s PTs, selected by s low bits of PC >> 2 (xAs); the
+ *             pattern is set:history, k + s bits.
+ *   - Gshare: the history XOR the low k bits of PC >> 2 (McFarling's
+ *             gshare); one PT of 2^k entries.
+ */
+enum class PTSelect {
+    Global,
+    PerSet,
+    Gshare
+};
+
+/**
+ * PTSelector: computes the PT pattern of PTSelect from a branch's history
+ * and PC. Both variants are one expression,
+ *
+ *     ((pc >> 2) & set_mask) << k  |  (h ^ ((pc >> 2) & xor_mask))
+ *
+ * with the unused mask 0, so callers need no per-branch dispatch; the batch
+ * loops skip it altogether when plain() (Global).
+ */
+class PTSelector {
+public:
+    PTSelector(PTSelect select, int history_bits, int set_bits)
+        : select_(select),
+          history_bits_(history_bits),
+          set_bits_(select == PTSelect::PerSet ? set_bits : 0),
+          set_shift_(set_bits_ != 0 ? history_bits : 0),
+          set_mask_(history_mask(set_bits_)),
+          xor_mask_(select == PTSelect::Gshare ? history_mask(history_bits) : 0) {}
+
+    bool plain() const { return select_ == PTSelect::Global; }
+
+    // Width of the patterns, i.e. the history_bits of the PatternTable.
+    int pattern_bits() const { return history_bits_ + set_bits_; }
+
+    History pattern(History h, std::uint64_t pc) const {
+        const History a = pc >> 2;
+        return ((a & set_mask_) << set_shift_) | (h ^ (a & xor_mask_));
+    }
+
+private:
+    PTSelect select_;
+    int      history_bits_;
+    int      set_bits_;
+    int      set_shift_; // k, or 0 without sets (k may be 64)
+    History  set_mask_;
+    History  xor_mask_;
+};
+
+/**
+ * PTAliasSummary: how many static branches share PT entries, over the
+ * branches observed by PTAliasSampler.
+ *
+ *   - used         : entries used by at least one observed branch;
+ *   - aliased      : entries used by two or more distinct branches;
+ *   - pcs_per_entry: mean (estimated) distinct branches per used entry.
+ */
+struct PTAliasSummary {
+    std::uint64_t used          = 0;
+    std::uint64_t aliased       = 0;
+    double        pcs_per_entry = 0.0;
+};
+
+/**
+ * PTAliasSampler: distinct-PC aliasing per PT entry.
+ *
+ * Keeping the PC set of every entry would cost a hash-table probe per
+ * branch, so each entry has a 64-bit signature instead: a branch sets bit
+ * hash(pc) % 64 of the entry it used. A signature with b bits set holds
+ * about -64 ln(1 - b/64) distinct PCs (linear counting), which is accurate
+ * to a few percent up to well over 100 PCs; a full signature counts as
+ * kSaturatedPcs. One or two set bits tell "private" from "aliased" exactly
+ * unless two PCs hash alike (1 in 64).
+ *
+ * Observing costs a multiply and an OR per branch, which is still
+ * noticeable next to the PT access itself, so only one simulate_batch()
+ * call (trace block) in kBatchPeriod is observed: the batch loops are
+ * instantiated with and without observation and pick one per call
+ * (observe_batch()). Signatures only ever gain bits, so a branch that keeps
+ * using an entry is seen sooner or later; the estimate depends on block
+ * boundaries, e.g. a --range run resumed from a snapshot may differ
+ * slightly from one straight run.
+ *
+ * Space is sampled too: signatures are kept for at most kMaxEntries PT
+ * entries, so the sampler costs at most 32 KiB (and as much snapshot)
+ * however large the PT. Entry idx is watched if its slot, idx times an odd
+ * constant modulo the (power-of-two) PT size, is below kMaxEntries; the
+ * multiplication permutes the indices, so this is a fixed pseudo-random
+ * subset, and every entry of a PT up to kMaxEntries. summary() scales the
+ * subset's counts up to the whole PT.
+ */
+class PTAliasSampler {
+public:
+    static constexpr std::uint32_t kBatchPeriod = 8;
+    static constexpr std::size_t   kMaxEntries  = 4096;
+
+    // entries: the PT size, a power of two.
+    explicit PTAliasSampler(std::size_t entries)
+        : entries_(entries),
+          mask_(static_cast<std::uint32_t>(entries - 1)),
+          sig_(std::min(entries, kMaxEntries), 0) {}
+
+    // True if the next batch should be observed.
+    bool observe_batch() { return (batches_++ % kBatchPeriod) == 0; }
+
+    // Note that the branch at pc used PT entry idx.
+    void observe(std::uint32_t idx, std::uint64_t pc) {
+        const std::uint32_t slot = (idx * 0x9E3779B9u) & mask_;
+        if (slot < sig_.size()) {
+            sig_[slot] |= std::uint64_t{1} << ((pc * 0x9E3779B97F4A7C15ull) >> 58);
+        }
+    }
+
+    PTAliasSummary summary() const;
+
+    void save(SnapshotWriter& out) const;
+    void load(SnapshotReader& in);
+
+private:
+    std::size_t                entries_;
+    std::uint32_t              mask_;     // entries_ - 1
+    std::uint64_t              batches_ = 0;
+    TableVector<std::uint64_t> sig_;      // watched entry (slot) → PC signature
+};
+
 /**
  * PatternTable (PT) – second-level table in Fig. 1.
  *
- * size = 2^k entries, where k = history_bits.
+ * size = 2^k entries, where k = history_bits, for k up to index_bits.
+ * Longer histories (up to 64 bits) are XOR-folded into a 2^index_bits
+ * table, so long-history studies keep a bounded PT instead of allocating
+ * 2^k entries.
  *
  * Each entry corresponds to one possible k-bit history pattern and stores
  * the pattern history bits S_c in the form of a finite-state machine state
- * (Last-Time, A2, A3, A4).
+ * (Last-Time, A2, A3, A4 or a user-defined automaton), stepped through the
+ * automaton's AutomatonTable.
  *
  * - predict(history):
  *     * uses the automaton's A(S_c) to predict taken/not-taken.
  *
  * - update(history, outcome):
  *     * calls δ(S_c, R_{i,c}) to move to the new state.
+ *
+ * - observe(history, pc):
+ *     * feeds the aliasing sampler (alias_summary()) during batches for
+ *       which observe_batch() is true; it has no effect on predictions.
+ *
+ * Bulk operations (reset, copy_from, diff) work a whole 64-bit word at a
+ * time in the packed layout; they are meant for checkpointing and warm-up
+ * experiments.
  */
 class PatternTable {
 public:
-    PatternTable(int history_bits, AutomatonType automaton);
+    // index_bits: PT index width; 0 = min(history_bits, kDefaultMaxPTIndexBits).
+    PatternTable(int history_bits, AutomatonType automaton,
+                 PTLayout layout = PTLayout::Bytes, int index_bits = 0);
+
+    // PT entry selected by a history pattern.
+    std::uint32_t index(History history) const {
+        if (!folded_) return static_cast<std::uint32_t>(history) & mask_;
+        return fold_history(history, history_bits_, index_bits_);
+    }
 
     // Predict next outcome based on current history pattern.
-    bool predict(std::uint16_t history) const;
+    bool predict(History history) const {
+        return fsm_->predict(state(index(history)));
+    }
 
     // Update pattern entry with the actual outcome.
-    void update(std::uint16_t history, Outcome o);
+    void update(History history, Outcome o) {
+        std::uint32_t idx = index(history);
+        if (layout_ == PTLayout::Bytes) {
+            std::uint8_t& st = entries_[idx];
+            st = fsm_->next(st, o);
+        } else {
+            set_packed(idx, fsm_->next(state(idx), o));
+        }
+    }
+
+    // Record which branch used the entry of history (PTAliasSampler).
+    bool observe_batch() { return alias_.observe_batch(); }
+    void observe(History history, std::uint64_t pc) { alias_.observe(index(history), pc); }
+
+    PTAliasSummary alias_summary() const { return alias_.summary(); }
 
-    std::size_t num_entries() const { return entries_.size(); }
+    // Automaton state of entry idx.
+    std::uint8_t state(std::uint32_t idx) const {
+        if (layout_ == PTLayout::Bytes) return entries_[idx];
+        switch (state_bits_) {
+            case 1:  return packed_get<1>(words_.data(), idx);
+            case 2:  return packed_get<2>(words_.data(), idx);
+            default: return packed_get<4>(words_.data(), idx);
+        }
+    }
+
+    // Set entry idx to automaton state st.
+    void set_state(std::uint32_t idx, std::uint8_t st) {
+        if (layout_ == PTLayout::Bytes) entries_[idx] = st;
+        else                            set_packed(idx, st);
+    }
+
+    std::size_t num_entries() const { return num_entries_; }
+    int index_bits() const { return index_bits_; }
+    PTLayout layout() const { return layout_; }
+    AutomatonType automaton() const { return automaton_; }
+
+    // Put every entry back into automaton_init_state().
+    void reset();
+
+    // Copy all states from other, which must have the same size, automaton
+    // and layout.
+    void copy_from(const PatternTable& other);
+
+    // Number of entries whose state differs from other (same geometry).
+    std::size_t diff(const PatternTable& other) const;
+
+    /**
+     * Dump / restore the entries (snapshot.hpp): the layout tag, then the
+     * byte array or the packed words as stored, then the alias sampler. A
+     * byte-layout dump is the same as TwoLevelAT's; load() fails on a byte
+     * that is no state of the automaton.
+     */
+    void save(SnapshotWriter& out) const;
+    void load(SnapshotReader& in);
 
 private:
     int history_bits_;
-    std::uint32_t mask_;
+    int index_bits_;           // log2(num_entries_)
+    bool folded_;              // history_bits_ > index_bits_
+    std::uint32_t mask_;       // index mask when not folded
     AutomatonType automaton_;
-    std::vector<std::uint8_t> entries_; // pattern history bits S_c
+    const AutomatonTable* fsm_; // automaton_table(automaton_)
+    PTLayout layout_;
+    unsigned state_bits_;      // bits per entry in the packed layout
+    std::size_t num_entries_;
+    TableVector<std::uint8_t> entries_;  // Bytes : pattern history bits S_c
+    TableVector<std::uint64_t> words_;   // Packed: S_c, state_bits_ each
+    PTAliasSampler alias_;
+
+    void set_packed(std::uint32_t idx, std::uint8_t st) {
+        switch (state_bits_) {
+            case 1:  packed_set<1>(words_.data(), idx, st); break;
+            case 2:  packed_set<2>(words_.data(), idx, st); break;
+            default: packed_set<4>(words_.data(), idx, st); break;
+        }
+    }
+
+    // init state replicated into every field of a packed word
+    std::uint64_t init_word() const;
 };
 
 } // namespace bp
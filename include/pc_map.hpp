@@ -0,0 +1,163 @@
+#ifndef BP_PC_MAP_HPP
+#define BP_PC_MAP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aligned_alloc.hpp"
+#include "snapshot.hpp"
+
+namespace bp {
+
+/**
+ * PcMap<V>: open-addressing hash map from branch PC to a small value.
+ *
+ * Used for the per-static-branch tables (IHRT histories, bimodal counters),
+ * where entries are inserted once and never removed. That allows a simple
+ * layout:
+ *   - power-of-two capacity, linear probing, no tombstones;
+ *   - key and value stored side by side in one flat array, so a lookup is
+ *     normally a single cache miss and inserting allocates nothing until
+ *     the table grows (load factor <= 1/2);
+ *   - Fibonacci hashing of the word-aligned PC.
+ *
+ * The key ~0 marks empty slots; a branch whose PC happens to be ~0 is kept
+ * in a dedicated side slot.
+ *
+ * Pointers returned by find()/find_or_insert() stay valid until the next
+ * insertion.
+ */
+template <class V>
+class PcMap {
+public:
+    // expected: number of distinct PCs to size for up front (0 = small).
+    explicit PcMap(std::size_t expected = 0) { rehash(capacity_for(expected)); }
+
+    V* find(std::uint64_t pc) {
+        if (pc == kEmpty) return has_empty_key_ ? &empty_key_value_ : nullptr;
+        for (std::size_t i = home(pc);; i = (i + 1) & mask_) {
+            Slot& s = slots_[i];
+            if (s.key == pc) return &s.value;
+            if (s.key == kEmpty) return nullptr;
+        }
+    }
+
+    const V* find(std::uint64_t pc) const {
+        return const_cast<PcMap*>(this)->find(pc);
+    }
+
+    // Value for pc, inserting init first if pc is not present.
+    V& find_or_insert(std::uint64_t pc, const V& init) {
+        if (pc == kEmpty) {
+            if (!has_empty_key_) {
+                has_empty_key_   = true;
+                empty_key_value_ = init;
+                ++size_;
+            }
+            return empty_key_value_;
+        }
+        for (std::size_t i = home(pc);; i = (i + 1) & mask_) {
+            Slot& s = slots_[i];
+            if (s.key == pc) return s.value;
+            if (s.key == kEmpty) {
+                if ((size_ + 1) * 2 > slots_.size()) {
+                    grow();
+                    return find_or_insert(pc, init);
+                }
+                s.key   = pc;
+                s.value = init;
+                ++size_;
+                return s.value;
+            }
+        }
+    }
+
+    // Insert or overwrite the value for pc.
+    void insert(std::uint64_t pc, const V& value) { find_or_insert(pc, value) = value; }
+
+    std::size_t size() const { return size_; }
+
+    // Snapshot the slot array as is (snapshot.hpp); load() restores it,
+    // capacity included, so probe sequences are unchanged.
+    void save(SnapshotWriter& out) const {
+        out.write_array(slots_);
+        out.write<std::uint64_t>(size_);
+        out.write<std::uint8_t>(has_empty_key_ ? 1 : 0);
+        out.write(empty_key_value_);
+    }
+
+    void load(SnapshotReader& in) {
+        TableVector<Slot> slots(slots_.get_allocator());
+        std::uint64_t     size      = 0;
+        std::uint8_t      has_empty = 0;
+        V                 empty_value{};
+        in.read_array(slots);
+        in.read(size);
+        in.read(has_empty);
+        in.read(empty_value);
+        if (!in.ok()) return;
+        if (slots.size() < 16 || (slots.size() & (slots.size() - 1)) != 0 ||
+            size > slots.size()) {
+            in.fail("corrupt branch table");
+            return;
+        }
+
+        slots_.swap(slots);
+        mask_  = slots_.size() - 1;
+        shift_ = 64;
+        for (std::size_t c = slots_.size(); c > 1; c >>= 1) --shift_;
+        size_            = static_cast<std::size_t>(size);
+        has_empty_key_   = has_empty != 0;
+        empty_key_value_ = empty_value;
+    }
+
+private:
+    static constexpr std::uint64_t kEmpty = ~std::uint64_t{0};
+
+    struct Slot {
+        std::uint64_t key;
+        V             value;
+    };
+
+    TableVector<Slot> slots_;
+    std::size_t       mask_  = 0;
+    unsigned          shift_ = 0; // 64 - log2(capacity)
+    std::size_t       size_  = 0;
+    bool              has_empty_key_   = false;
+    V                 empty_key_value_ = V{};
+
+    static std::size_t capacity_for(std::size_t expected) {
+        std::size_t cap = 16;
+        while (cap < expected * 2) cap <<= 1;
+        return cap;
+    }
+
+    std::size_t home(std::uint64_t pc) const {
+        return static_cast<std::size_t>(((pc >> 2) * 0x9E3779B97F4A7C15ull) >> shift_);
+    }
+
+    void rehash(std::size_t capacity) {
+        // old takes slots_'s allocator, and the swap hands it back, so the
+        // table stays in the arena it was built in.
+        TableVector<Slot> old(slots_.get_allocator());
+        old.swap(slots_);
+        slots_.assign(capacity, Slot{kEmpty, V{}});
+        mask_  = capacity - 1;
+        shift_ = 64;
+        for (std::size_t c = capacity; c > 1; c >>= 1) --shift_;
+
+        for (const Slot& s : old) {
+            if (s.key == kEmpty) continue;
+            std::size_t i = home(s.key);
+            while (slots_[i].key != kEmpty) i = (i + 1) & mask_;
+            slots_[i] = s;
+        }
+    }
+
+    void grow() { rehash(slots_.size() * 2); }
+};
+
+} // namespace bp
+
+#endif // BP_PC_MAP_HPP
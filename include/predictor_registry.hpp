@@ -0,0 +1,133 @@
+#ifndef BP_PREDICTOR_REGISTRY_HPP
+#define BP_PREDICTOR_REGISTRY_HPP
+
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "sweep.hpp"
+
+namespace bp {
+
+/**
+ * PredictorArgs: what a factory gets to build one unit from a predictor
+ * spec "NAME[:PARAMS]" (see PredictorRegistry::make()).
+ *
+ *   - label           : scheme name for the results (the whole spec);
+ *   - params          : the text after ':', empty if none; its syntax is up
+ *                       to the predictor;
+ *   - static_branches : trace hint for sizing per-branch tables (0 = unknown).
+ */
+struct PredictorArgs {
+    std::string label;
+    std::string params;
+    std::size_t static_branches = 0;
+};
+
+/**
+ * Build a unit, or return null with error set (e.g. bad params). Factories
+ * normally return a PredictorSim<P> (sweep.hpp), so the per-branch loop is
+ * P's simulate_batch() compiled into whoever registered the factory.
+ */
+using PredictorFactory =
+    std::function<std::unique_ptr<PredictorUnit>(const PredictorArgs&, std::string& error)>;
+
+/**
+ * PredictorRegistry: predictors selectable by name, besides the AT sweep
+ * (whose engines have their own registry, at_registry.hpp).
+ *
+ * The built-in baselines are registered on first use:
+ *
+ *   AlwaysTaken   static always-taken
+ *   Bimodal2Bit   per-branch 2-bit saturating counter
+ *
+ * and plugins add more through load_predictor_plugin(). Names are unique;
+ * add() of an existing name fails.
+ */
+class PredictorRegistry {
+public:
+    struct Entry {
+        std::string      name;
+        std::string      description;
+        PredictorFactory factory;
+        std::string      plugin; // path of the plugin that added it; "" for built-ins
+    };
+
+    // The process-wide registry, with the built-ins.
+    static PredictorRegistry& instance();
+
+    // Register a predictor; false if the name is taken.
+    bool add(std::string name, std::string description, PredictorFactory factory);
+
+    // Entry for name, or null.
+    const Entry* find(const std::string& name) const;
+
+    /**
+     * Build the unit for spec "NAME[:PARAMS]". Returns null with error set
+     * if the name is unknown or the factory rejects the params.
+     */
+    std::unique_ptr<PredictorUnit> make(const std::string& spec, std::size_t static_branches,
+                                        std::string& error) const;
+
+    // Every registered predictor, in registration order.
+    const std::vector<Entry>& entries() const { return entries_; }
+
+private:
+    PredictorRegistry();
+
+    // Records each new entry's plugin.
+    friend bool load_predictor_plugin(const std::string& path, std::string& error);
+
+    std::vector<Entry> entries_;
+};
+
+// The predictors every run reports after the AT configurations.
+std::vector<std::string> default_predictors();
+
+/**
+ * Build units for every spec, in order (PredictorRegistry::make()). On
+ * failure (including a spec given twice, which would report two rows under
+ * one name) returns false with error set; units is then incomplete.
+ */
+bool make_predictors(const std::vector<std::string>& specs, std::size_t static_branches,
+                     std::vector<std::unique_ptr<PredictorUnit>>& units, std::string& error);
+
+/**
+ * Plugins: a shared object exporting
+ *
+ *   extern "C" int  bp_predictor_plugin_abi();   // kPredictorPluginAbi
+ *   extern "C" void bp_register_predictors(bp::PredictorRegistry& registry);
+ *
+ * where the second add()s the plugin's predictors. BP_PREDICTOR_PLUGIN()
+ * below defines the first and opens the definition of the second:
+ *
+ *   BP_PREDICTOR_PLUGIN(registry) {
+ *       registry.add("MyScheme", "...", factory);
+ *   }
+ *
+ * The plugin is compiled against these headers with the same compiler and
+ * standard library as bp_sim (the interface is C++), and resolves the
+ * bp_core symbols it uses from the executable. See plugins/.
+ */
+constexpr int kPredictorPluginAbi = 4;
+
+/**
+ * dlopen() path, check its ABI and run its bp_register_predictors(). The
+ * library stays loaded for the life of the process. Returns false with
+ * error set if it cannot be loaded, lacks the entry points, reports another
+ * ABI or registers nothing new.
+ */
+bool load_predictor_plugin(const std::string& path, std::string& error);
+
+} // namespace bp
+
+#define BP_PREDICTOR_PLUGIN(registry)                                               \
+    extern "C" __attribute__((visibility("default"))) int bp_predictor_plugin_abi() { \
+        return bp::kPredictorPluginAbi;                                             \
+    }                                                                               \
+    extern "C" __attribute__((visibility("default"))) void bp_register_predictors(  \
+        bp::PredictorRegistry& registry)
+
+#endif // BP_PREDICTOR_REGISTRY_HPP
@@ -1,14 +1,63 @@
 #ifndef BP_PREDICTORS_HPP
 #define BP_PREDICTORS_HPP
 
+#include <cstddef>
 #include <cstdint>
-#include <unordered_map>
 
 #include "types.hpp"
 #include "automaton.hpp"
+#include "branch_table.hpp"
+#include "collector.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
 
 namespace bp {
 
+/**
+ * The predictor concept: what PredictorSim (sweep.hpp) and the predictor
+ * registry (predictor_registry.hpp) need from a scheme.
+ *
+ *   bool predict(pc) const / void update(pc, outcome)
+ *   void simulate_batch(pcs, outs, n, stats, collector)
+ *        predict, score and update n consecutive branches; Collector is a
+ *        template parameter (collector.hpp)
+ *   void simulate_batch(ids, pcs, outs, n, stats, collector)   (optional)
+ *        the same with the records' BranchIds (types.hpp), used instead
+ *        when the trace has them; results must not differ
+ *   void save(SnapshotWriter&) const / void load(SnapshotReader&)
+ *   std::size_t hardware_cost_bits() const
+ *
+ * PredictorBase<Derived> provides everything but predict()/update(): its
+ * simulate_batch() calls them through Derived, so they bind statically and
+ * inline. A scheme overrides simulate_batch() (by hiding it) when a fused
+ * predict-and-update is cheaper, as Bimodal2BitPredictor does.
+ */
+template <class Derived>
+class PredictorBase {
+public:
+    template <class Collector>
+    void simulate_batch(const std::uint64_t* pcs, const Outcome* outs,
+                        std::size_t n, Stats& stats, Collector& collector) {
+        Derived&      self    = static_cast<Derived&>(*this);
+        std::uint64_t correct = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const bool hit = (self.predict(pcs[i]) == (outs[i] == Outcome::Taken));
+            correct += hit ? 1u : 0u;
+            collector.record(pcs[i], hit);
+            self.update(pcs[i], outs[i]);
+        }
+        stats.total   += n;
+        stats.correct += correct;
+    }
+
+    // Stateless by default: nothing to snapshot.
+    void save(SnapshotWriter&) const {}
+    void load(SnapshotReader&) {}
+
+    // Predictor storage in bits; 0 = not modelled (reported as such).
+    std::size_t hardware_cost_bits() const { return 0; }
+};
+
 /**
  * AlwaysTakenPredictor:
  *
@@ -16,10 +65,25 @@ namespace bp {
  * Used as a baseline, similar to the "Always Taken" scheme
  * evaluated in the paper.
  */
-class AlwaysTakenPredictor {
+class AlwaysTakenPredictor : public PredictorBase<AlwaysTakenPredictor> {
 public:
     bool predict(std::uint64_t /*pc*/) const { return true; }
     void update(std::uint64_t /*pc*/, Outcome /*o*/) {}
+
+    // Every taken branch is a correct prediction.
+    // Collector: see collector.hpp.
+    template <class Collector>
+    void simulate_batch(const std::uint64_t* pcs, const Outcome* outs,
+                        std::size_t n, Stats& stats, Collector& collector) {
+        std::uint64_t taken = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            const bool hit = (outs[i] == Outcome::Taken);
+            taken += hit ? 1u : 0u;
+            collector.record(pcs[i], hit);
+        }
+        stats.total   += n;
+        stats.correct += taken;
+    }
 };
 
 /**
@@ -34,24 +98,73 @@ public:
  *   - States 2 and 3 predict taken; 0 and 1 predict not-taken.
  *
  * This serves as a dynamic baseline for comparison to Two-Level AT.
+ * The counters are a BranchTable (branch_table.hpp), indexed by branch ID
+ * when the trace provides IDs.
  */
-class Bimodal2BitPredictor {
+class Bimodal2BitPredictor : public PredictorBase<Bimodal2BitPredictor> {
 public:
+    // expected_branches: static-branch count to pre-size the table for.
+    explicit Bimodal2BitPredictor(std::size_t expected_branches = 0)
+        : table_(expected_branches) {}
+
     bool predict(std::uint64_t pc) const {
-        auto it = table_.find(pc);
-        std::uint8_t st = (it == table_.end()) ? 3 : it->second; // default strongly taken
-        return automaton_predict(AutomatonType::A2, st);
+        const std::uint8_t* st = table_.find(pc);
+        return automaton_predict(AutomatonType::A2, st ? *st : 3); // default strongly taken
     }
 
     void update(std::uint64_t pc, Outcome o) {
-        auto it = table_.find(pc);
-        std::uint8_t st = (it == table_.end()) ? 3 : it->second;
+        std::uint8_t& st = table_.find_or_insert(pc, 3);
         st = automaton_next(AutomatonType::A2, st, o);
-        table_[pc] = st;
     }
 
+    // Predict, score and update n consecutive branches.
+    // Collector: see collector.hpp.
+    template <class Collector>
+    void simulate_batch(const std::uint64_t* pcs, const Outcome* outs,
+                        std::size_t n, Stats& stats, Collector& collector) {
+        std::uint64_t correct = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            std::uint8_t& st  = table_.find_or_insert(pcs[i], 3);
+            const bool    hit = (automaton_predict(AutomatonType::A2, st) ==
+                                 (outs[i] == Outcome::Taken));
+            correct += hit ? 1u : 0u;
+            collector.record(pcs[i], hit);
+            st = automaton_next(AutomatonType::A2, st, outs[i]);
+        }
+        stats.total   += n;
+        stats.correct += correct;
+    }
+
+    // The same by branch ID.
+    template <class Collector>
+    void simulate_batch(const BranchIds& ids, const std::uint64_t* pcs, const Outcome* outs,
+                        std::size_t n, Stats& stats, Collector& collector) {
+        table_.use_ids(ids.space);
+        std::uint64_t correct = 0;
+        for (std::size_t i = 0; i < n; ++i) {
+            std::uint8_t& st  = table_.find_or_insert(ids.ids[i], pcs[i], 3);
+            const bool    hit = (automaton_predict(AutomatonType::A2, st) ==
+                                 (outs[i] == Outcome::Taken));
+            correct += hit ? 1u : 0u;
+            collector.record(pcs[i], hit);
+            st = automaton_next(AutomatonType::A2, st, outs[i]);
+        }
+        stats.total   += n;
+        stats.correct += correct;
+    }
+
+    // Static branches with a counter so far.
+    std::size_t size() const { return table_.size(); }
+
+    // 2 bits per counter; like the IHRT's, the table grows with the branches seen.
+    std::size_t hardware_cost_bits() const { return table_.size() * 2u; }
+
+    // Dump / restore the counter table (snapshot.hpp).
+    void save(SnapshotWriter& out) const { table_.save(out); }
+    void load(SnapshotReader& in) { table_.load(in); }
+
 private:
-    std::unordered_map<std::uint64_t, std::uint8_t> table_; // pc → 2-bit state
+    BranchTable<std::uint8_t> table_; // branch → 2-bit state
 };
 
 } // namespace bp
@@ -0,0 +1,221 @@
+#ifndef BP_REPLACEMENT_HPP
+#define BP_REPLACEMENT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "aligned_alloc.hpp"
+#include "snapshot.hpp"
+
+namespace bp {
+
+/**
+ * ReplacementPolicy: how an AHRT picks the line to reuse on a miss.
+ *
+ *   - RoundRobin: a victim pointer per set, advanced on every fill. This is
+ *                 the original simulator's "simplified LRU".
+ *   - LRU       : true least-recently-used, from per-way age ranks.
+ *   - TreePLRU  : tree pseudo-LRU, W-1 bits per set, as in most hardware
+ *                 caches with 8 or more ways.
+ *   - Random    : a pseudo-random way; the generator has a fixed seed, so
+ *                 results are reproducible.
+ */
+enum class ReplacementPolicy {
+    RoundRobin,
+    LRU,
+    TreePLRU,
+    Random
+};
+
+/**
+ * Replacement policy classes, the Policy parameter of AHRTTableT (hrt.hpp).
+ *
+ * All of them keep their state in one flat array (or a single word) sized
+ * at construction, so no access allocates. The interface is:
+ *
+ *   Policy(sets, ways)
+ *   int  victim(set) const     : way to reuse on a miss (no side effects,
+ *                                lookup() reports its stale history);
+ *   void on_hit(set, way)      : the branch found its line;
+ *   void on_fill(set, way)     : commit() installed a new tag in way;
+ *   save(out) / load(in)       : snapshot the state (snapshot.hpp).
+ *
+ * kFillsInOrder is true when the policy always fills the invalid ways of a
+ * set first, on its own; otherwise AHRTTableT looks for an invalid way
+ * before asking for a victim.
+ */
+
+/**
+ * RoundRobinPolicy: one 8-bit pointer per set (ways <= 256), the next way
+ * to fill. Hits do not change it.
+ */
+class RoundRobinPolicy {
+public:
+    static constexpr ReplacementPolicy kPolicy       = ReplacementPolicy::RoundRobin;
+    static constexpr bool              kFillsInOrder = true;
+
+    RoundRobinPolicy(int sets, int ways)
+        : ways_(ways), next_(static_cast<std::size_t>(sets), 0) {}
+
+    int victim(std::uint32_t set) const { return next_[set]; }
+    void on_hit(std::uint32_t /*set*/, int /*way*/) {}
+    void on_fill(std::uint32_t set, int way) {
+        next_[set] = static_cast<std::uint8_t>((way + 1) % ways_);
+    }
+
+    void save(SnapshotWriter& out) const { out.write_array(next_); }
+    void load(SnapshotReader& in) { in.read_span(next_.data(), next_.size()); }
+
+private:
+    int                       ways_;
+    TableVector<std::uint8_t> next_; // round-robin pointer per set
+};
+
+/**
+ * LRUPolicy: true LRU with a 4-bit age rank per way, packed into one
+ * 64-bit word per set (ways <= 16). Rank 0 is the most and rank W-1 the
+ * least recently used line.
+ *
+ * A touch of the way with rank r ages every way younger than r by one and
+ * makes the touched way rank 0; the set's state stays in one register
+ * throughout, and a touch of the MRU way (the common case for loops)
+ * returns at once.
+ *
+ * Way i starts with rank W-1-i, so an empty set fills ways 0, 1, 2, ... as
+ * under round-robin, and untouched (invalid) ways are always the oldest.
+ */
+class LRUPolicy {
+public:
+    static constexpr ReplacementPolicy kPolicy       = ReplacementPolicy::LRU;
+    static constexpr bool              kFillsInOrder = true;
+    static constexpr int               kMaxWays      = 16;
+
+    LRUPolicy(int sets, int ways) : ways_(ways), ages_(static_cast<std::size_t>(sets)) {
+        std::uint64_t init = 0;
+        for (int w = 0; w < ways; ++w) {
+            init |= static_cast<std::uint64_t>(ways - 1 - w) << (4 * w);
+        }
+        ages_.assign(ages_.size(), init);
+    }
+
+    int victim(std::uint32_t set) const {
+        const std::uint64_t a = ages_[set];
+        for (int w = 0; w < ways_; ++w) {
+            if (((a >> (4 * w)) & 0xF) == static_cast<std::uint64_t>(ways_ - 1)) return w;
+        }
+        return 0; // unreachable: ranks are a permutation of 0..W-1
+    }
+
+    void on_hit(std::uint32_t set, int way) { touch(set, way); }
+    void on_fill(std::uint32_t set, int way) { touch(set, way); }
+
+    void save(SnapshotWriter& out) const { out.write_array(ages_); }
+    void load(SnapshotReader& in) { in.read_span(ages_.data(), ages_.size()); }
+
+private:
+    int                        ways_;
+    TableVector<std::uint64_t> ages_; // 4-bit rank per way, way 0 in the low nibble
+
+    void touch(std::uint32_t set, int way) {
+        std::uint64_t  a    = ages_[set];
+        const unsigned rank = static_cast<unsigned>((a >> (4 * way)) & 0xF);
+        if (rank == 0) return;
+        for (int w = 0; w < ways_; ++w) {
+            const unsigned x = static_cast<unsigned>((a >> (4 * w)) & 0xF);
+            a += (x < rank) ? (std::uint64_t{1} << (4 * w)) : 0u;
+        }
+        ages_[set] = a & ~(std::uint64_t{0xF} << (4 * way));
+    }
+};
+
+/**
+ * TreePLRUPolicy: tree pseudo-LRU over W = 2^n ways (ways <= 64), W-1 node
+ * bits per set in one word. Node 1 is the root and node j has children 2j
+ * and 2j+1; the leaves W..2W-1 are the ways. A node bit of 0 means "the
+ * pseudo-LRU side is the left subtree".
+ */
+class TreePLRUPolicy {
+public:
+    static constexpr ReplacementPolicy kPolicy       = ReplacementPolicy::TreePLRU;
+    static constexpr bool              kFillsInOrder = false;
+    static constexpr int               kMaxWays      = 64;
+
+    TreePLRUPolicy(int sets, int ways)
+        : ways_(ways), bits_(static_cast<std::size_t>(sets), 0) {}
+
+    int victim(std::uint32_t set) const {
+        const std::uint64_t b    = bits_[set];
+        unsigned            node = 1;
+        while (node < static_cast<unsigned>(ways_)) node = 2 * node + ((b >> node) & 1u);
+        return static_cast<int>(node) - ways_;
+    }
+
+    void on_hit(std::uint32_t set, int way) { touch(set, way); }
+    void on_fill(std::uint32_t set, int way) { touch(set, way); }
+
+    void save(SnapshotWriter& out) const { out.write_array(bits_); }
+    void load(SnapshotReader& in) { in.read_span(bits_.data(), bits_.size()); }
+
+private:
+    int                        ways_;
+    TableVector<std::uint64_t> bits_; // node j in bit j (bit 0 unused)
+
+    // Point every node on the way's path away from it.
+    void touch(std::uint32_t set, int way) {
+        std::uint64_t& b    = bits_[set];
+        unsigned       node = static_cast<unsigned>(way + ways_);
+        while (node > 1) {
+            const unsigned      parent = node / 2;
+            const std::uint64_t bit    = std::uint64_t{1} << parent;
+            if (node & 1u) b &= ~bit; // touched right: LRU side is left
+            else           b |= bit;  // touched left : LRU side is right
+            node = parent;
+        }
+    }
+};
+
+/**
+ * RandomPolicy: xorshift64* with a fixed seed; one generator per table.
+ * The next victim is drawn ahead of time and only replaced when a fill
+ * consumes it, so victim() stays free of side effects.
+ */
+class RandomPolicy {
+public:
+    static constexpr ReplacementPolicy kPolicy       = ReplacementPolicy::Random;
+    static constexpr bool              kFillsInOrder = false;
+
+    RandomPolicy(int /*sets*/, int ways) : ways_(static_cast<std::uint64_t>(ways)) { draw(); }
+
+    int victim(std::uint32_t /*set*/) const { return next_; }
+    void on_hit(std::uint32_t /*set*/, int /*way*/) {}
+    void on_fill(std::uint32_t /*set*/, int /*way*/) { draw(); }
+
+    void save(SnapshotWriter& out) const {
+        out.write(state_);
+        out.write<std::int64_t>(next_);
+    }
+
+    void load(SnapshotReader& in) {
+        std::int64_t next = 0;
+        in.read(state_);
+        in.read(next);
+        next_ = static_cast<int>(next);
+    }
+
+private:
+    std::uint64_t ways_;
+    std::uint64_t state_ = 0x9E3779B97F4A7C15ull;
+    int           next_  = 0;
+
+    void draw() {
+        state_ ^= state_ >> 12;
+        state_ ^= state_ << 25;
+        state_ ^= state_ >> 27;
+        next_ = static_cast<int>(((state_ * 0x2545F4914F6CDD1Dull) >> 32) % ways_);
+    }
+};
+
+} // namespace bp
+
+#endif // BP_REPLACEMENT_HPP
@@ -0,0 +1,134 @@
+#ifndef BP_RESULTS_CACHE_HPP
+#define BP_RESULTS_CACHE_HPP
+
+#include <cstddef>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "at_config.hpp"
+#include "experiment.hpp"
+
+namespace bp {
+
+/**
+ * Results cache (bp_sim --cache DIR): the result row of every (trace,
+ * scheme) pair simulated so far, so that a run only simulates the pairs it
+ * has not seen and merges the rest from the cache.
+ *
+ * A row is keyed by
+ *   - the trace's content hash (trace_content_hash()): DIR/<hash>/ holds
+ *     the rows of one trace, in results files (results_file.hpp) with a
+ *     cache_key column, one file added per run;
+ *   - the scheme in canonical form (cache_key()): every field of an
+ *     ATConfig that changes its results, with the automaton as its full
+ *     transition table (so an --fsm redefined under the same name is a new
+ *     key), the spec of a registry predictor (with the content hash of its
+ *     plugin, if any, so a rebuilt plugin is a new key), or a hybrid's
+ *     parameters and the key of its AT component. Names, PT layout and engine options
+ *     (--dynamic, --no-share-hrt, --packed-pt) give identical results and
+ *     are not part of the key;
+ *   - kResultsCacheVersion, which must be bumped by any change to the
+ *     simulator that changes a result. Rows of other versions are ignored.
+ *
+ * Rows are cached for full runs only (no --range, --sample or snapshots).
+ * Files are added atomically, so concurrent runs may share a cache.
+ */
+constexpr const char* kResultsCacheVersion = "3";
+
+/**
+ * Hash of the bytes of the file at path, as 16 hex digits. Returns false
+ * with error set if it cannot be read.
+ */
+bool trace_content_hash(const std::string& path, std::string& hash, std::string& error);
+
+/**
+ * Canonical key of an AT configuration, a predictor spec, and a hybrid over
+ * at. The key of a plugin predictor whose plugin file cannot be read is
+ * "": such a row is never cached.
+ */
+std::string cache_key(const ATConfig& cfg);
+std::string cache_key(const std::string& predictor_spec);
+std::string cache_key(const HybridConfig& hybrid, const ATConfig& at);
+
+/**
+ * ResultsCache: the cached rows of one trace, loaded from DIR/<hash>/,
+ * plus the rows added by this run, written there by save().
+ */
+class ResultsCache {
+public:
+    ResultsCache(const std::string& dir, const std::string& trace_hash);
+
+    // Read every results file of the trace. A missing directory is empty.
+    bool load(std::string& error);
+
+    // The cached row for key, or nullptr (always for the key "").
+    const ResultRow* find(const std::string& key) const;
+
+    // Add a row to save(); a row with key "" is not cached.
+    void add(const std::string& key, const ResultRow& row);
+
+    // Write the rows added since load() as a new file (none: no file).
+    bool save(std::string& error);
+
+private:
+    std::string                                root_; // DIR
+    std::string                                dir_;  // DIR/<hash>
+    std::unordered_map<std::string, ResultRow> rows_;
+    std::vector<ResultRow>                     added_;
+    std::vector<std::string>                   added_keys_;
+};
+
+/**
+ * CachedRun: one trace's schemes split into those the cache has and those
+ * to simulate. An uncached hybrid needs its components, so they are
+ * simulated too even when cached themselves.
+ *
+ * Simulate configs(), predictors() and hybrids() in a SimSet (if
+ * complete() is false), then merge() its rows with the cached ones.
+ */
+class CachedRun {
+public:
+    CachedRun(ResultsCache& cache, const std::vector<ATConfig>& configs,
+              const std::vector<std::string>& predictor_specs,
+              const std::vector<HybridConfig>& hybrids);
+
+    const std::vector<ATConfig>&     configs() const { return sim_configs_; }
+    const std::vector<std::string>&  predictors() const { return sim_predictors_; }
+    const std::vector<HybridConfig>& hybrids() const { return sim_hybrids_; }
+
+    // True if every row is cached: nothing to simulate.
+    bool complete() const { return sim_configs_.empty() && sim_predictors_.empty() &&
+                                   sim_hybrids_.empty(); }
+
+    // Rows taken from the cache.
+    std::size_t cached() const { return cached_; }
+
+    /**
+     * Append every row, in SimSet::append_rows() order of the full run, to
+     * rows: the cached ones relabelled as benchmark, the others from
+     * simulated (the SimSet's rows), which are added to the cache.
+     */
+    void merge(const std::string& benchmark, const std::vector<ResultRow>& simulated,
+               std::vector<ResultRow>& rows);
+
+private:
+    // One row of the full run.
+    struct Slot {
+        std::string      key;
+        std::string      scheme;     // "" for predictors: the simulated or cached name
+        const ResultRow* cached;     // or nullptr
+        std::size_t      simulated;  // index in the SimSet's rows, if not cached
+    };
+
+    ResultsCache&             cache_;
+    std::vector<Slot>         slots_;
+    std::vector<ATConfig>     sim_configs_;
+    std::vector<std::string>  sim_predictors_;
+    std::vector<HybridConfig> sim_hybrids_;
+    std::size_t               cached_ = 0;
+};
+
+} // namespace bp
+
+#endif // BP_RESULTS_CACHE_HPP
@@ -0,0 +1,81 @@
+#ifndef BP_RESULTS_FILE_HPP
+#define BP_RESULTS_FILE_HPP
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "experiment.hpp"
+
+namespace bp {
+
+/**
+ * Results files ("bpres"): the rows of kResultsCsvHeader in columnar
+ * binary form, written by bp_sim --results and read by
+ * analysis/bpres.py without any text parsing.
+ *
+ *   ResultsFileHeader                       (header_bytes bytes)
+ *   ResultsColumn columns[column_count]     the column directory
+ *   column data                             each at its offset, 8-byte aligned
+ *
+ * A column of type U64 or F64 is row_count values; a Str column is
+ * row_count std::uint64_t end offsets (string i is bytes
+ * end[i-1] .. end[i]-1, from 0) followed by the string bytes. The columns
+ * are those of the CSV, in its order, except that accuracy is an unrounded
+ * F64 percentage; the files of a results cache (results_cache.hpp) add a
+ * Str column cache_key. Readers look columns up by name, so later versions
+ * may add columns.
+ *
+ * All fields are stored in the host's native (little-endian) byte order,
+ * as in bptrace files.
+ *
+ * A file is written to a temporary name and renamed into place, so a
+ * reader never sees a partial one. Given a directory, bp_sim writes a new
+ * uniquely named file into it per run, and the directory as a whole is the
+ * result set: concurrent runs can share it, and adding a run is adding a
+ * file.
+ */
+struct ResultsFileHeader {
+    char          magic[8];       // "BPRES\0\0\0"
+    std::uint32_t version;        // kResultsFileVersion
+    std::uint32_t header_bytes;   // sizeof(ResultsFileHeader)
+    std::uint64_t row_count;
+    std::uint32_t column_count;
+    std::uint32_t reserved;       // 0
+};
+
+enum class ResultsColumnType : std::uint32_t { U64 = 1, F64 = 2, Str = 3 };
+
+struct ResultsColumn {
+    char          name[24];       // NUL-padded
+    std::uint32_t type;           // ResultsColumnType
+    std::uint32_t reserved;       // 0
+    std::uint64_t offset;         // from the start of the file
+    std::uint64_t bytes;          // without padding
+};
+
+constexpr char          kResultsFileMagic[8] = {'B', 'P', 'R', 'E', 'S', '\0', '\0', '\0'};
+constexpr std::uint32_t kResultsFileVersion  = 1;
+constexpr const char*   kResultsFileExt      = ".bpres";
+
+/**
+ * Write rows to path, atomically replacing any existing file. If path is
+ * a directory, write a new file <benchmark>.<host>.<pid>.<time>.bpres in
+ * it instead (benchmark of the first row). On success, written is the
+ * file's path; on failure, error says why. With keys (one per row), the
+ * file also has a cache_key column.
+ */
+bool write_results_file(const std::string& path, const std::vector<ResultRow>& rows,
+                        std::string& written, std::string& error,
+                        const std::vector<std::string>* keys = nullptr);
+
+/**
+ * Read the rows of a results file (appending them to rows). With keys,
+ * also append each row's cache_key ("" if the file has none).
+ */
+bool read_results_file(const std::string& path, std::vector<ResultRow>& rows,
+                       std::string& error, std::vector<std::string>* keys = nullptr);
+
+} // namespace bp
+
+#endif // BP_RESULTS_FILE_HPP
@@ -0,0 +1,188 @@
+#ifndef BP_SHARED_HRT_HPP
+#define BP_SHARED_HRT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+#include "aligned_alloc.hpp"
+#include "at_config.hpp"
+#include "hrt.hpp"
+#include "pattern_table.hpp"
+#include "sweep.hpp"
+#include "types.hpp"
+
+namespace bp {
+
+/**
+ * Shared first level for configurations that differ only in the second.
+ *
+ * The first level of AT(HRT(kSR), PT(2^k, A)) does not depend on the
+ * automaton A, and its k-bit history registers are always the low k bits
+ * of the registers of the same HRT run with K >= k bits:
+ *   - the initial value is all 1s (Section 4.2) for every k;
+ *   - the update (h << 1 | R) & mask commutes with masking to k bits;
+ *   - AHRT tag matching and replacement look only at the PC, so the same
+ *     lines hit, miss and are reused, and a reused line's stale history
+ *     (Section 3.1) is again the masked K-bit value.
+ *
+ * A SharedHRTGroup therefore runs one HRT with the largest k of its
+ * members and, per trace block, records the history each branch saw. Every
+ * SharedATMember then replays that history stream through its own PT,
+ * masked to its own k. Results are identical to separate predictors, and
+ * the HRT work of an automaton or history-length sweep is divided by the
+ * number of configurations sharing it. The PT selection (PTSelect) is part
+ * of the second level, so e.g. GAg, GAs and gshare share one GHR.
+ *
+ * Members that also use the same PT entries are simulated together as
+ * automaton lanes (AutomatonLanes below).
+ */
+class SharedHRTGroup;
+
+/**
+ * SharedATMember: the PT and Stats of one configuration in a group. It is
+ * advanced by its group, so run_block() does nothing and only the group is
+ * scheduled.
+ */
+class SharedATMember : public ATUnit {
+public:
+    SharedATMember(const ATConfig& c, SharedHRTGroup& group);
+
+    void run_block(const TraceBlock&) override {}
+
+    // HRT bits at this member's k + PT bits, as TwoLevelATPredictor.
+    std::size_t hardware_cost_bits() const override;
+
+    // The group's HRT counters (identical to a private HRT's) and own PT.
+    HRTCounters    hrt_counters() const override;
+    PTAliasSummary pt_alias() const override { return pt_.alias_summary(); }
+    void           set_hrt_counters(const HRTCounters& c) override;
+
+    // Name, stats and PT; the HRT is saved by the group.
+    void save(SnapshotWriter& out) const override;
+    void load(SnapshotReader& in) override;
+
+    // Predict and train on the branches of block, whose K-bit histories
+    // are hist[]; reports to the member's collector if one is attached.
+    void replay(const History* hist, const TraceBlock& block);
+
+    // For AutomatonLanes: the mask to this member's k, its PT selection
+    // and PT.
+    History             mask() const { return mask_; }
+    const PTSelector&   selector() const { return select_; }
+    PatternTable&       pattern_table() { return pt_; }
+    const PatternTable& pattern_table() const { return pt_; }
+
+private:
+    // Observe: feed the PT aliasing sampler (pattern_table.hpp); Plain: as
+    // in two_level_at.cpp, the PT is indexed by the history itself.
+    template <bool Observe, bool Plain, class Collector>
+    void replay(const History* hist, const TraceBlock& block, Collector& collector);
+
+    SharedHRTGroup&       group_;
+    History               mask_;
+    PTSelector            select_;
+    PatternTable          pt_;
+};
+
+// Most members one AutomatonLanes simulates together.
+constexpr std::size_t kMaxAutomatonLanes = 4;
+
+/**
+ * AutomatonLanes: members of a group whose PT index is the same function
+ * of the history and PC (same k, PT selection and PT index width), which
+ * therefore read and train the same PT entry for every branch and differ
+ * only in their automata, e.g. the members of an fsm=LT,A2,A3,A4 sweep.
+ *
+ * A PT entry's state depends only on the outcomes of the branches that
+ * selected it, so entry i of every member's PT together is one state of
+ * the product automaton, whose transition and predictions follow from the
+ * members' AutomatonTables. The lanes keep a single PT of product states
+ * (at most 256, one byte each) and replay a block with one PT access and
+ * one table step for all members, counting each member's correct
+ * predictions in a 16-bit field of one 64-bit word. Results are identical
+ * to replaying every member on its own, at a quarter of the PT work for
+ * four members.
+ *
+ * While lanes run fused, the members' own PTs are out of date; flush()
+ * writes the product states back (e.g. before a snapshot), invalidate()
+ * re-reads them on the next block (after one). A member with a collector
+ * or hit log needs every branch in order, so in blocks where any has one
+ * the lanes flush and replay each member separately.
+ */
+class AutomatonLanes {
+public:
+    explicit AutomatonLanes(SharedATMember* first);
+
+    // True if member uses the same PT entries and still fits.
+    bool accepts(const SharedATMember& member) const;
+    void add(SharedATMember* member);
+
+    // Replay one block through every lane (SharedATMember::replay()).
+    void replay(const History* hist, const TraceBlock& block);
+
+    // Copy the product states back into the members' PTs.
+    void flush() const;
+    // The members' PTs changed: read them again before the next block.
+    void invalidate() { fused_ = false; }
+
+private:
+    template <bool Observe, bool Plain>
+    void replay_fused(const History* hist, const TraceBlock& block, unsigned observed);
+
+    // Build entries_ from the members' PTs.
+    void fuse();
+
+    std::vector<SharedATMember*> lanes_;
+    unsigned                     stride_[kMaxAutomatonLanes] = {}; // place value of each lane
+    unsigned                     states_ = 1;                      // product states
+    std::uint8_t                 next_[256][2] = {};               // [S][R]: δ of the product
+    std::uint64_t                hits_[256][2] = {};               // [S][R]: 1 in each correct lane
+    TableVector<std::uint8_t>    entries_;                         // product PT, when fused
+    bool                         fused_ = false;                   // entries_ are current
+};
+
+/**
+ * SharedHRTGroup: the HRT shared by a set of configurations with the same
+ * kind, entries, ways and replacement policy.
+ */
+class SharedHRTGroup : public SimUnit {
+public:
+    // history_bits: the largest k among the members.
+    SharedHRTGroup(const ATConfig& geometry, int history_bits,
+                   std::size_t expected_branches = 0);
+
+    // Add a member (the group keeps a reference; the caller owns it), to
+    // the first AutomatonLanes that accepts it or to new ones.
+    void add_member(SharedATMember* member);
+
+    void run_block(const TraceBlock& block) override;
+
+    // The shared HRT, then every member in order.
+    void save(SnapshotWriter& out) const override;
+    void load(SnapshotReader& in) override;
+
+    const HistoryTable& hrt() const { return *hrt_; }
+    HistoryTable&       hrt() { return *hrt_; }
+
+private:
+    HRTKind                       kind_;
+    ReplacementPolicy             replacement_;
+    IndexHash                     index_;
+    History                       mask_;
+    std::unique_ptr<HistoryTable> hrt_;
+    std::vector<SharedATMember*>  members_;
+    std::vector<AutomatonLanes>   lanes_; // members_, by PT entries used
+    TableVector<History>          hist_;  // per block: history seen by each branch
+};
+
+/**
+ * Key deciding which configurations may share an HRT: same kind and,
+ * where they matter, the same entries, ways and replacement policy.
+ */
+bool same_hrt_geometry(const ATConfig& a, const ATConfig& b);
+
+} // namespace bp
+
+#endif // BP_SHARED_HRT_HPP
@@ -0,0 +1,176 @@
+#ifndef BP_SNAPSHOT_HPP
+#define BP_SNAPSHOT_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace bp {
+
+/**
+ * Predictor snapshots ("bpsnap").
+ *
+ * A snapshot is a straight memory dump of predictor state: the raw arrays
+ * of every HRT, PT and baseline table, in the order the units write them.
+ *
+ *   SnapshotHeader                          (header_bytes bytes)
+ *   item*                                   payload_bytes bytes
+ *
+ * Every item is padded to a multiple of 8 bytes, and arrays are written as
+ * a std::uint64_t element count followed by the elements, so in a mapped
+ * snapshot every array starts 8-byte aligned and can be used in place.
+ * SnapshotReader maps the file and copies each array straight back into
+ * its table; there is no per-entry decoding.
+ *
+ * Snapshots are host byte order and are only meant to be restored into the
+ * same configurations built by the same simulator. Units record their
+ * names and table sizes so that a mismatch is reported rather than
+ * restored.
+ */
+struct SnapshotHeader {
+    char          magic[8];       // "BPSNAP\0\0"
+    std::uint32_t version;        // kSnapshotVersion
+    std::uint32_t header_bytes;   // sizeof(SnapshotHeader)
+    std::uint64_t payload_bytes;  // bytes after the header
+};
+
+constexpr char          kSnapshotMagic[8] = {'B', 'P', 'S', 'N', 'A', 'P', '\0', '\0'};
+constexpr std::uint32_t kSnapshotVersion  = 3;
+
+/**
+ * SnapshotWriter: appends items to a snapshot file; finish() writes the
+ * final header. Errors are sticky: check ok() (or finish()'s result) once
+ * at the end.
+ */
+class SnapshotWriter {
+public:
+    explicit SnapshotWriter(const std::string& path);
+    ~SnapshotWriter();
+
+    SnapshotWriter(const SnapshotWriter&)            = delete;
+    SnapshotWriter& operator=(const SnapshotWriter&) = delete;
+
+    bool ok() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+
+    // n raw bytes, followed by padding to a multiple of 8.
+    void write_bytes(const void* data, std::size_t n);
+
+    template <class T>
+    void write(const T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshots are raw dumps");
+        write_bytes(&value, sizeof(T));
+    }
+
+    // Element count, then the n elements.
+    template <class T>
+    void write_span(const T* data, std::size_t n) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshots are raw dumps");
+        write<std::uint64_t>(n);
+        write_bytes(data, n * sizeof(T));
+    }
+
+    template <class T, class Alloc>
+    void write_array(const std::vector<T, Alloc>& v) { write_span(v.data(), v.size()); }
+
+    void write_string(const std::string& s) { write_span(s.data(), s.size()); }
+
+    // Write the header with the final payload size. Returns ok().
+    bool finish();
+
+private:
+    std::FILE*    out_     = nullptr;
+    std::uint64_t payload_ = 0;
+    std::string   path_;
+    std::string   error_;
+
+    void write_header();
+};
+
+/**
+ * SnapshotReader: mmap()s a snapshot and hands its items back in order.
+ * Reads past the end or of the wrong size set error() (and leave the
+ * destination unchanged); errors are sticky.
+ */
+class SnapshotReader {
+public:
+    explicit SnapshotReader(const std::string& path);
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader&)            = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    bool ok() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+
+    // Record the first error (later ones are dropped).
+    void fail(const std::string& what);
+
+    // Pointer to the next n bytes in the mapping (nullptr on error), and
+    // skip them plus padding.
+    const void* read_bytes(std::size_t n);
+
+    template <class T>
+    void read(T& value) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshots are raw dumps");
+        if (const void* p = read_bytes(sizeof(T))) copy(&value, p, sizeof(T));
+    }
+
+    // An array of exactly n elements (the table's current size).
+    template <class T>
+    void read_span(T* data, std::size_t n) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshots are raw dumps");
+        std::uint64_t count = 0;
+        read(count);
+        if (!ok()) return;
+        if (count != n) {
+            fail("table size mismatch (snapshot has " + std::to_string(count) +
+                 " entries, predictor has " + std::to_string(n) + ")");
+            return;
+        }
+        if (const void* p = read_bytes(n * sizeof(T))) copy(data, p, n * sizeof(T));
+    }
+
+    // An array of any length; v is resized to match.
+    template <class T, class Alloc>
+    void read_array(std::vector<T, Alloc>& v) {
+        static_assert(std::is_trivially_copyable<T>::value, "snapshots are raw dumps");
+        std::uint64_t count = 0;
+        read(count);
+        if (!ok()) return;
+        if (count > remaining() / sizeof(T)) {
+            fail("truncated snapshot");
+            return;
+        }
+        const void* p = read_bytes(static_cast<std::size_t>(count) * sizeof(T));
+        if (!p) return;
+        v.resize(static_cast<std::size_t>(count));
+        copy(v.data(), p, v.size() * sizeof(T));
+    }
+
+    std::string read_string();
+
+    // Read a string and fail unless it equals want (what names it).
+    void expect_string(const std::string& want, const char* what);
+
+    // True once every payload byte has been consumed.
+    bool at_end() const { return pos_ == end_; }
+
+private:
+    void*         base_   = nullptr;
+    std::size_t   length_ = 0;
+    std::size_t   pos_    = 0;   // offset of the next item
+    std::size_t   end_    = 0;   // end of the payload
+    std::string   path_;
+    std::string   error_;
+
+    std::size_t remaining() const { return end_ - pos_; }
+    static void copy(void* dst, const void* src, std::size_t n);
+};
+
+} // namespace bp
+
+#endif // BP_SNAPSHOT_HPP
@@ -1,6 +1,7 @@
 #ifndef BP_STATS_HPP
 #define BP_STATS_HPP
 
+#include <cmath>
 #include <cstdint>
 
 namespace bp {
@@ -14,15 +15,48 @@ namespace bp {
  *
  * The accuracy is defined exactly as in the paper:
  *   accuracy = correct / total
+ *
+ * Sampled runs (run_sampled() in sweep.hpp) also record the accuracy of
+ * every measured interval, from which ci95() estimates the uncertainty of
+ * the sampled accuracy.
  */
 struct Stats {
     std::uint64_t total   = 0;
     std::uint64_t correct = 0;
 
+    std::uint64_t samples        = 0;   // measured intervals
+    double        sample_sum     = 0.0; // Σ interval accuracy
+    double        sample_sum_sq  = 0.0; // Σ interval accuracy²
+
     double accuracy() const {
         if (total == 0) return 0.0;
         return static_cast<double>(correct) / static_cast<double>(total);
     }
+
+    // Add one measured interval (its own total/correct).
+    void add_sample(const Stats& interval) {
+        total   += interval.total;
+        correct += interval.correct;
+        if (interval.total == 0) return;
+        const double a = interval.accuracy();
+        ++samples;
+        sample_sum    += a;
+        sample_sum_sq += a * a;
+    }
+
+    /**
+     * Half-width of the 95% confidence interval of the accuracy, from the
+     * spread of the interval accuracies (normal approximation,
+     * 1.96 * s / sqrt(n)). 0 with fewer than two samples.
+     */
+    double ci95() const {
+        if (samples < 2) return 0.0;
+        const double n    = static_cast<double>(samples);
+        const double mean = sample_sum / n;
+        double var = (sample_sum_sq - n * mean * mean) / (n - 1.0);
+        if (var < 0.0) var = 0.0;
+        return 1.96 * std::sqrt(var / n);
+    }
 };
 
 } // namespace bp
@@ -0,0 +1,259 @@
+#ifndef BP_SWEEP_HPP
+#define BP_SWEEP_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "arena.hpp"
+#include "at_config.hpp"
+#include "collector.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
+#include "trace.hpp"
+#include "two_level_at.hpp"
+#include "types.hpp"
+
+namespace bp {
+
+/**
+ * SimUnit: one predictor and its Stats, advanced one TraceBlock at a time.
+ *
+ * Every unit owns all of its state, so different units may be run on
+ * different threads as long as each one sees the blocks in trace order.
+ *
+ * Units created inside an ArenaScope are placed in its arena, together
+ * with the tables they allocate (arena.hpp).
+ */
+class SimUnit {
+public:
+    virtual ~SimUnit() = default;
+
+    static void* operator new(std::size_t bytes) { return arena_new(bytes); }
+    static void  operator delete(void* p) noexcept { arena_delete(p); }
+
+    virtual void run_block(const TraceBlock& block) = 0;
+
+    /**
+     * Dump / restore predictor state and stats (snapshot.hpp). Units write
+     * their name first, so restoring into a different unit fails cleanly.
+     */
+    virtual void save(SnapshotWriter& out) const = 0;
+    virtual void load(SnapshotReader& in) = 0;
+
+    Stats stats;
+
+    // Optional detailed statistics (collector.hpp); not owned. When null the
+    // unit runs its NoCollector loop.
+    BranchStatsCollector* collector = nullptr;
+
+    // Optional per-branch correctness of the last block, for hybrids built
+    // on this unit (hybrid.hpp); not owned.
+    HitLog* hit_log = nullptr;
+
+    // run_parallel() worker that owns the unit, modulo the worker count, or
+    // -1 to deal it round-robin. Set for units built in an ArenaSet.
+    int home_worker = -1;
+};
+
+namespace detail {
+
+// Whether Engine has the simulate_batch() form taking BranchIds first.
+template <class Engine, class Collector, class = void>
+struct takes_branch_ids : std::false_type {};
+
+template <class Engine, class Collector>
+struct takes_branch_ids<Engine, Collector,
+                        std::void_t<decltype(std::declval<Engine&>().simulate_batch(
+                            std::declval<const BranchIds&>(), std::declval<const std::uint64_t*>(),
+                            std::declval<const Outcome*>(), std::size_t{},
+                            std::declval<Stats&>(), std::declval<Collector&>()))>>
+    : std::true_type {};
+
+} // namespace detail
+
+/**
+ * Run one block through engine.simulate_batch() with the collector policy
+ * chosen once per block (with_collector()): the NoCollector instantiation
+ * when the unit has neither a collector nor a hit log, so units pay
+ * nothing for collection they do not use. Blocks with branch IDs go to the
+ * engine's BranchIds form where it has one (predictors.hpp).
+ */
+template <class Engine>
+void simulate_block(Engine& engine, const TraceBlock& block, SimUnit& unit) {
+    with_collector(unit.collector, unit.hit_log, block.n, [&](auto& collector) {
+        using Collector = std::decay_t<decltype(collector)>;
+        if constexpr (detail::takes_branch_ids<Engine, Collector>::value) {
+            if (block.ids) {
+                engine.simulate_batch(BranchIds{block.ids, block.id_space}, block.pcs,
+                                      block.outs, block.n, unit.stats, collector);
+                return;
+            }
+        }
+        engine.simulate_batch(block.pcs, block.outs, block.n, unit.stats, collector);
+    });
+}
+
+/**
+ * ATUnit: a SimUnit simulating one Two-Level AT configuration.
+ */
+class ATUnit : public SimUnit {
+public:
+    explicit ATUnit(const ATConfig& c) : cfg(c) {}
+
+    virtual std::size_t hardware_cost_bits() const = 0;
+
+    // HRT access counters and sampled PT aliasing, for the results CSV.
+    virtual HRTCounters    hrt_counters() const = 0;
+    virtual PTAliasSummary pt_alias() const = 0;
+
+    /**
+     * Replace the HRT access counters, so that like Stats they cover only
+     * the reported branches (run_sampled(), SimSet::reset_stats()).
+     */
+    virtual void set_hrt_counters(const HRTCounters& c) = 0;
+
+    ATConfig cfg;
+};
+
+/**
+ * ATSim: the runtime-configured TwoLevelATPredictor, which handles any
+ * ATConfig.
+ */
+class ATSim : public ATUnit {
+public:
+    explicit ATSim(const ATConfig& c, std::size_t expected_branches = 0)
+        : ATUnit(c), pred(c, expected_branches) {}
+
+    void run_block(const TraceBlock& block) override { simulate_block(pred, block, *this); }
+
+    std::size_t hardware_cost_bits() const override {
+        return pred.hardware_cost_bits();
+    }
+
+    HRTCounters    hrt_counters() const override { return pred.hrt_counters(); }
+    PTAliasSummary pt_alias() const override { return pred.pt_alias(); }
+    void           set_hrt_counters(const HRTCounters& c) override { pred.set_hrt_counters(c); }
+
+    void save(SnapshotWriter& out) const override {
+        out.write_string(cfg.name);
+        out.write(stats);
+        pred.save(out);
+    }
+
+    void load(SnapshotReader& in) override {
+        in.expect_string(cfg.name, "unit");
+        in.read(stats);
+        pred.load(in);
+    }
+
+    TwoLevelATPredictor pred;
+};
+
+/**
+ * PredictorUnit: a SimUnit for a named predictor other than the AT sweep,
+ * such as the baselines or a scheme from the predictor registry
+ * (predictor_registry.hpp). name is its scheme name in the results.
+ */
+class PredictorUnit : public SimUnit {
+public:
+    explicit PredictorUnit(std::string n) : name(std::move(n)) {}
+
+    virtual std::size_t hardware_cost_bits() const = 0;
+
+    std::string name;
+};
+
+/**
+ * PredictorSim: wraps any predictor following the predictor concept
+ * (predictors.hpp). The only virtual call is run_block(), once per block;
+ * the per-branch loop is Predictor's simulate_batch().
+ */
+template <class Predictor>
+class PredictorSim : public PredictorUnit {
+public:
+    template <class... Args>
+    explicit PredictorSim(std::string n, Args&&... args)
+        : PredictorUnit(std::move(n)), pred(std::forward<Args>(args)...) {}
+
+    void run_block(const TraceBlock& block) override { simulate_block(pred, block, *this); }
+
+    std::size_t hardware_cost_bits() const override { return pred.hardware_cost_bits(); }
+
+    void save(SnapshotWriter& out) const override {
+        out.write_string(name);
+        out.write(stats);
+        pred.save(out);
+    }
+
+    void load(SnapshotReader& in) override {
+        in.expect_string(name, "unit");
+        in.read(stats);
+        pred.load(in);
+    }
+
+    Predictor pred;
+};
+
+/**
+ * Drive every unit over the whole trace on the calling thread.
+ * Returns source.ok() once the trace is exhausted.
+ */
+bool run_serial(TraceSource& source, const std::vector<SimUnit*>& units);
+
+/**
+ * Parallel sweep: the calling thread decodes the trace once into a ring of
+ * shared read-only blocks, and `threads` workers each own a fixed subset of
+ * the units and advance them through every block in trace order. Stats are
+ * therefore identical to run_serial(). Returns source.ok().
+ *
+ * Units with a home_worker go to that worker, the others round-robin. If
+ * any unit has one and the host has several NUMA nodes, worker w is pinned
+ * to worker_numa_node(w), where its ArenaSet arena lives (arena.hpp).
+ */
+bool run_parallel(TraceSource& source, const std::vector<SimUnit*>& units,
+                  unsigned threads);
+
+/**
+ * SamplingPlan: which parts of a trace run_sampled() simulates.
+ *
+ * The trace is cut into intervals of `interval` records, and the last
+ * interval of every `period` is measured. The `warmup` records just before
+ * each measured interval are simulated without being counted (functional
+ * warm-up of the HRTs/PTs); everything else is skipped, which is a seek on
+ * binary traces.
+ */
+struct SamplingPlan {
+    std::uint64_t interval = 10000;
+    std::uint64_t period   = 10;
+    std::uint64_t warmup   = 0;
+};
+
+/**
+ * Sampled run: units are advanced over the warm-up and measured segments
+ * only (with `threads` workers as in run_parallel()). reported lists the
+ * Stats to fill, e.g. one per configuration; each ends up holding the
+ * measured branches only, with one Stats::add_sample() per interval.
+ * An interval cut short by the end of the trace is dropped. The HRT
+ * counters of at_units are scoped the same way. Returns source.ok().
+ */
+bool run_sampled(TraceSource& source, const std::vector<SimUnit*>& units,
+                 const std::vector<Stats*>& reported, const std::vector<ATUnit*>& at_units,
+                 const SamplingPlan& plan, unsigned threads);
+
+/**
+ * Write the state of every unit, in order, to a snapshot file; restore it
+ * into the same list of units. Return false with error set on failure
+ * (I/O, or a snapshot taken from a different set of units).
+ */
+bool save_snapshot(const std::string& path, const std::vector<SimUnit*>& units,
+                   std::string& error);
+bool load_snapshot(const std::string& path, const std::vector<SimUnit*>& units,
+                   std::string& error);
+
+} // namespace bp
+
+#endif // BP_SWEEP_HPP
@@ -0,0 +1,112 @@
+#ifndef BP_SWEEP_SPEC_HPP
+#define BP_SWEEP_SPEC_HPP
+
+#include <string>
+#include <vector>
+
+#include "at_config.hpp"
+
+namespace bp {
+
+/**
+ * Sweep specifications: compact descriptions of grids of ATConfigs.
+ *
+ * A spec is a whitespace-separated list of key=value terms; the grid is the
+ * cartesian product of all values:
+ *
+ *   hrt=AHRT:256..4096:x2,HHRT:512,IHRT ways=1,2,4,8 k=4..16 fsm=LT,A2
+ *
+ * Keys (missing keys take the default in brackets):
+ *   hrt    : KIND[:entries] items,                            [AHRT:512]
+ *            KIND = AHRT | HHRT | IHRT | GHR (global history)
+ *   ways   : AHRT associativity                               [4]
+ *   k      : history bits, 1..64                              [12]
+ *   fsm    : LT | A2 | A3 | A4 | a parse_fsm_spec() name     [A2]
+ *   ptbits : PT index bits, 0 = k (capped, see pattern_table) [0]
+ *   layout : bytes | packed                                   [bytes]
+ *   repl   : AHRT replacement, rr | lru | plru | random       [rr]
+ *            (lru up to 16 ways, plru up to 64)
+ *   index  : AHRT/HHRT index function, low | xor | mul | skew [low]
+ *            (skew: AHRT only, see index_hash.hpp)
+ *   pt     : PT selection, global | set[:N] | gshare          [global]
+ *            (set: N PTs picked by PC bits, default 16; see PTSelect)
+ *
+ * Numeric values are comma-separated items, each either N or a range
+ * A..B[:+S | :xF] (step +S or factor F). Ranges step by +1, except HRT
+ * entry and PT set ranges, which double by default. IHRT and GHR ignore
+ * entries and ways, HHRT ignores ways and repl and skips index=skew (an
+ * HHRT with no other index is an error).
+ *
+ * The single word "default" stands for the built-in configurations of
+ * default_sweep().
+ *
+ * Config names follow the built-in scheme, e.g. AT_AHRT_512_12_A2; a
+ * non-default associativity, replacement policy, index function, PT index
+ * width or layout is appended, as in AT_AHRT_512x8_12_A2_lru_skew or
+ * AT_AHRT_512_24_A2_pt16_packed; a PT selection adds _sN or _gshare. In
+ * Yeh–Patt terms, hrt=GHR gives GAg, GAs (pt=set) and gshare, and a
+ * per-address HRT gives PAg and PAs.
+ */
+
+/**
+ * The built-in configurations (Table 2 / Figs. 5–7 of the paper), used
+ * when no sweep is given on the command line.
+ */
+std::vector<ATConfig> default_sweep();
+
+/**
+ * Expand one spec and append its configs to out, skipping names that are
+ * already present. Returns false (with error set) on a malformed spec.
+ */
+bool parse_sweep_spec(const std::string& spec, std::vector<ATConfig>& out,
+                      std::string& error);
+
+/**
+ * Expand every spec in a file: one spec per line, '#' starts a comment and
+ * blank lines are ignored. Errors name the offending line.
+ */
+bool load_sweep_file(const std::string& path, std::vector<ATConfig>& out,
+                     std::string& error);
+
+// Canonical config name used for expanded specs.
+std::string sweep_config_name(const ATConfig& cfg);
+
+/**
+ * Hybrid specs (--hybrid): the same syntax, expanding to HybridConfigs
+ * (at_config.hpp) with the keys
+ *
+ *   at     : AT components by config name, or "all"          (required)
+ *   meta   : chooser index bits, 1..24                        [12]
+ *   filter : off | on, the static-when-biased filter          [off]
+ *
+ * e.g. "at=AT_GHR_12_A2_s16,AT_AHRT_512_12_A2 meta=10..14:+2 filter=off,on".
+ * configs are the sweep's configurations, against which the names and
+ * "all" are resolved. Hybrids are named Hybrid_<at>_M<meta>[_F], with _F
+ * for the filter. Appends to out, skipping names already present.
+ */
+bool parse_hybrid_spec(const std::string& spec, const std::vector<ATConfig>& configs,
+                       std::vector<HybridConfig>& out, std::string& error);
+
+/**
+ * Automaton specs (--fsm): define a user automaton for fsm= from its
+ * tables, in the same key=value syntax,
+ *
+ *   name    : the name used in fsm= and config names (letters, digits)
+ *   taken   : next state of states 0, 1, ... on a taken outcome
+ *   not     : next state of states 0, 1, ... on a not-taken outcome
+ *   predict : the states that predict taken (numbers or ranges)
+ *   init    : initial state                                 [last state]
+ *
+ * e.g. a 3-bit saturating counter:
+ *
+ *   name=S3 taken=1,2,3,4,5,6,7,7 not=0,0,1,2,3,4,5,6 predict=4..7
+ *
+ * taken and not give the number of states, 2..kMaxAutomatonStates. On
+ * success the automaton is registered (define_automaton()) and out is its
+ * type; otherwise returns false with error set.
+ */
+bool parse_fsm_spec(const std::string& spec, AutomatonType& out, std::string& error);
+
+} // namespace bp
+
+#endif // BP_SWEEP_SPEC_HPP
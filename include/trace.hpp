@@ -0,0 +1,390 @@
+#ifndef BP_TRACE_HPP
+#define BP_TRACE_HPP
+
+#include <cstdint>
+#include <cstddef>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "byte_stream.hpp"
+#include "pc_map.hpp"
+#include "types.hpp"
+
+namespace bp {
+
+/**
+ * Binary trace format ("bptrace").
+ *
+ * The text format (<pc_hex> <taken_bit>) is convenient to generate but slow
+ * to parse for traces with hundreds of millions of branches. The binary
+ * format stores the same records in a layout that can be mmap()ed and
+ * iterated without any decoding. Version 2 numbers the static branches in
+ * order of first appearance (branch IDs, types.hpp) and stores each record
+ * as its ID, plus the PC of every ID once:
+ *
+ *   BinaryTraceHeader                       (header_bytes bytes)
+ *   std::uint32_t ids[record_count]         branch ID of every dynamic branch,
+ *                                           zero-padded to a multiple of 8 bytes
+ *   std::uint64_t outcomes[(record_count + 63) / 64]
+ *                                           R_i = bit (i % 64) of word i / 64
+ *   std::uint64_t branch_pcs[static_branches]
+ *                                           PC of each branch ID
+ *
+ * That halves the file and hands the IDs to the predictors as they are,
+ * so per-branch tables are indexed by ID instead of hashing every PC
+ * (branch_table.hpp). Version 1 files, with a 64-bit PC per record in
+ * place of the IDs and no PC table, are still read; their readers number
+ * the branches while reading.
+ *
+ * All fields are stored in the host's native (little-endian) byte order.
+ * The IDs come first so that the converter can stream them straight to
+ * disk and only has to buffer the packed outcome bits (1 bit per record)
+ * and the PC table.
+ */
+struct BinaryTraceHeader {
+    char          magic[8];         // "BPTRACE\0"
+    std::uint32_t version;          // kBinaryTraceVersion (or 1)
+    std::uint32_t header_bytes;     // sizeof(BinaryTraceHeader)
+    std::uint64_t record_count;     // number of dynamic branches
+    std::uint64_t static_branches;  // number of distinct PCs in the trace
+};
+
+constexpr char          kBinaryTraceMagic[8]  = {'B', 'P', 'T', 'R', 'A', 'C', 'E', '\0'};
+constexpr std::uint32_t kBinaryTraceVersion   = 2;
+constexpr std::uint32_t kBinaryTraceVersionV1 = 1; // PCs per record; read only
+
+// Number of records the trace readers hand to the simulation loop at once.
+constexpr std::size_t   kTraceBlockRecords    = 4096;
+
+// Decoded blocks a streamed text trace may be read ahead (open_trace_source).
+constexpr std::size_t   kPrefetchBlocks       = 8;
+
+/**
+ * BranchDictionary: numbers static branches in order of first appearance
+ * and keeps the PC of every branch ID. Trace readers without stored IDs
+ * use one to number the records they hand out.
+ */
+class BranchDictionary {
+public:
+    explicit BranchDictionary(std::size_t expected = 0) : ids_(expected) {
+        pcs_.reserve(expected);
+    }
+
+    // ID of pc, numbering it if new; kNoBranchId once every ID is taken.
+    BranchId id(std::uint64_t pc) {
+        BranchId& id = ids_.find_or_insert(pc, kNoBranchId);
+        if (id == kNoBranchId && pcs_.size() < kNoBranchId) {
+            id = static_cast<BranchId>(pcs_.size());
+            pcs_.push_back(pc);
+        }
+        return id;
+    }
+
+    // ids[i] = id(pcs[i]) for n records; false if the IDs ran out.
+    bool number(const std::uint64_t* pcs, BranchId* ids, std::size_t n) {
+        bool ok = true;
+        for (std::size_t i = 0; i < n; ++i) {
+            ids[i] = id(pcs[i]);
+            ok     = ok && ids[i] != kNoBranchId;
+        }
+        return ok;
+    }
+
+    std::size_t size() const { return pcs_.size(); }
+
+    // PC of every ID.
+    const std::vector<std::uint64_t>& pcs() const { return pcs_; }
+
+private:
+    PcMap<BranchId>            ids_;
+    std::vector<std::uint64_t> pcs_;
+};
+
+// A branch-ID space number no other caller gets (BranchIds, types.hpp).
+std::uint64_t new_branch_id_space();
+
+/**
+ * Returns true if path is a regular file starting with the bptrace magic.
+ * Pipes and devices are never opened (that would consume their input).
+ */
+bool is_binary_trace(const std::string& path);
+
+/**
+ * MappedTrace: read-only, zero-copy view of a binary trace.
+ *
+ * The whole file is mapped with mmap(); ids() and branch_pcs() (version 2)
+ * or pcs() (version 1) point directly into the mapping, and outcome(i)
+ * extracts one bit from the packed outcome words. IDs are not checked
+ * against branch_pcs() here; see ids_valid(). Check ok() after
+ * construction; error() describes what went wrong.
+ *
+ * access is the madvise() hint for the mapping: Sequential for a trace
+ * read front to back once (MappedTraceSource), so pages can be dropped
+ * behind the reader; Repeated for one traversed by many cursors
+ * (LoadedTrace), so pages are read ahead and kept.
+ */
+class MappedTrace {
+public:
+    enum class Access { Sequential, Repeated };
+
+    explicit MappedTrace(const std::string& path, Access access = Access::Sequential);
+    ~MappedTrace();
+
+    MappedTrace(const MappedTrace&)            = delete;
+    MappedTrace& operator=(const MappedTrace&) = delete;
+
+    bool ok() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+
+    std::uint64_t size() const { return records_; }
+    std::uint64_t static_branches() const { return static_branches_; }
+    std::uint32_t version() const { return version_; }
+
+    // Version 1: PC of every record; else null.
+    const std::uint64_t* pcs() const { return pcs_; }
+
+    // Version 2: branch ID of every record and PC of every ID; else null.
+    const BranchId*      ids() const { return ids_; }
+    const std::uint64_t* branch_pcs() const { return branch_pcs_; }
+
+    const std::uint64_t* outcome_words() const { return outcomes_; }
+
+    // Whether records [first, first + n) all have IDs below static_branches().
+    bool ids_valid(std::uint64_t first, std::uint64_t n) const;
+
+    Outcome outcome(std::uint64_t i) const {
+        return ((outcomes_[i >> 6] >> (i & 63u)) & 1u) ? Outcome::Taken
+                                                        : Outcome::NotTaken;
+    }
+
+private:
+    void*                base_     = nullptr;
+    std::size_t          length_   = 0;
+    std::uint64_t        records_  = 0;
+    std::uint64_t        static_branches_ = 0;
+    std::uint32_t        version_  = 0;
+    const std::uint64_t* pcs_      = nullptr;
+    const BranchId*      ids_      = nullptr;
+    const std::uint64_t* branch_pcs_ = nullptr;
+    const std::uint64_t* outcomes_ = nullptr;
+    std::string          error_;
+};
+
+/**
+ * TextTraceReader: buffered parser for the text trace format.
+ *
+ * Each line is "<pc_hex> <taken_bit>", where pc_hex may carry a 0x/0X
+ * prefix and taken_bit is 0 or 1; blank lines are skipped. The input is a
+ * ByteStream (byte_stream.hpp), so a path may also be "-" (stdin), a FIFO
+ * or a gzip / xz / zstd file. It is read in large chunks and scanned by
+ * hand, so there is no locale, no per-token stream state and no allocation
+ * per record.
+ *
+ * read_block() returns 0 both at end of file and on error; a malformed line
+ * stops parsing and error() then names the offending line number.
+ */
+class TextTraceReader {
+public:
+    explicit TextTraceReader(const std::string& path);
+    explicit TextTraceReader(std::unique_ptr<ByteStream> input);
+    ~TextTraceReader();
+
+    TextTraceReader(const TextTraceReader&)            = delete;
+    TextTraceReader& operator=(const TextTraceReader&) = delete;
+
+    bool ok() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+
+    // Parse up to max records into pcs/outs; returns the number parsed.
+    std::size_t read_block(std::uint64_t* pcs, Outcome* outs, std::size_t max);
+
+    // Number of lines consumed so far.
+    std::uint64_t line() const { return line_; }
+
+private:
+    static constexpr std::size_t kBufferBytes = 1u << 20;
+
+    std::unique_ptr<ByteStream> input_;
+    std::vector<char> buf_;
+    std::size_t       pos_ = 0;     // next unparsed byte in buf_
+    std::size_t       end_ = 0;     // one past the last valid byte in buf_
+    bool              eof_ = false;
+    std::uint64_t     line_ = 0;
+    std::string       path_;
+    std::string       error_;
+
+    bool refill();
+    bool parse_line(const char* p, const char* e, std::uint64_t& pc, Outcome& o);
+};
+
+/**
+ * BinaryTraceWriter: streaming producer of the binary format (version 2).
+ *
+ * Branch IDs are written to the output file as records arrive; outcome
+ * bits (1 bit per record) and the PC of every ID are accumulated in memory
+ * and appended by finish(), which also rewrites the header with the final
+ * record and static-branch counts.
+ */
+class BinaryTraceWriter {
+public:
+    explicit BinaryTraceWriter(const std::string& path);
+    ~BinaryTraceWriter();
+
+    BinaryTraceWriter(const BinaryTraceWriter&)            = delete;
+    BinaryTraceWriter& operator=(const BinaryTraceWriter&) = delete;
+
+    bool ok() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+
+    void append(std::uint64_t pc, Outcome o);
+
+    // Flush outcome bits and the final header. Returns ok().
+    bool finish();
+
+    std::uint64_t size() const { return records_; }
+
+private:
+    std::FILE*                        out_     = nullptr;
+    std::uint64_t                     records_ = 0;
+    std::vector<std::uint64_t>        outcome_words_;
+    BranchDictionary                  branches_;
+    std::string                       error_;
+
+    void write_header();
+};
+
+/**
+ * TraceBlock: a read-only run of consecutive trace records.
+ *
+ * pcs/outs/ids point either into a BlockBuffer owned by the caller or
+ * directly into a mapped trace; they stay valid until the buffer is
+ * refilled. ids are the records' branch IDs in space id_space (types.hpp),
+ * the same for every block of a source; null if the source has none.
+ */
+struct TraceBlock {
+    const std::uint64_t* pcs  = nullptr;
+    const Outcome*       outs = nullptr;
+    std::size_t          n    = 0;
+    const BranchId*      ids  = nullptr;
+    std::uint64_t        id_space = 0;
+};
+
+/**
+ * BlockBuffer: storage a TraceSource may decode a block into. Its size()
+ * bounds the block; the three arrays always have that size.
+ */
+struct BlockBuffer {
+    std::vector<std::uint64_t> pcs;
+    std::vector<Outcome>       outs;
+    std::vector<BranchId>      ids;
+
+    BlockBuffer() : pcs(kTraceBlockRecords), outs(kTraceBlockRecords), ids(kTraceBlockRecords) {}
+
+    std::size_t size() const { return pcs.size(); }
+
+    void resize(std::size_t n) {
+        pcs.resize(n);
+        outs.resize(n);
+        ids.resize(n);
+    }
+};
+
+/**
+ * TraceSource: uniform block-at-a-time access to text and binary traces.
+ *
+ * next_block() returns false at end of trace or on error; ok()/error()
+ * distinguish the two.
+ */
+class TraceSource {
+public:
+    virtual ~TraceSource() = default;
+
+    // Blocks carry branch IDs, from the trace file or numbered on the way.
+    virtual bool next_block(BlockBuffer& storage, TraceBlock& block) = 0;
+
+    /**
+     * Advance past the next n records without handing them out; returns
+     * the number skipped (fewer at end of trace). Binary and loaded traces
+     * seek in O(1); text traces are parsed and discarded.
+     */
+    virtual std::uint64_t skip(std::uint64_t n);
+
+    // Number of distinct PCs if known up front (binary header), else 0.
+    virtual std::uint64_t static_branches() const { return 0; }
+
+    virtual bool ok() const = 0;
+    virtual const std::string& error() const = 0;
+};
+
+/**
+ * Open a trace by path, choosing the reader from the file's magic number:
+ *
+ *   - a binary trace file is mmapped (MappedTrace);
+ *   - any other input is opened as a ByteStream, so "-" (stdin), FIFOs and
+ *     gzip / xz / zstd files work too. A streamed binary trace is read
+ *     into memory first (its outcome bits follow all PCs); a text trace is
+ *     parsed, and decompressed, on a separate thread that runs up to
+ *     kPrefetchBlocks blocks ahead of the simulation.
+ *
+ * Always returns a source; check ok() before use.
+ */
+std::unique_ptr<TraceSource> open_trace_source(const std::string& path);
+
+/**
+ * Wrap source so that it ends after at most count more records. The
+ * wrapper never reads past the limit, so the second form (which does not
+ * take ownership) leaves source positioned right after that segment.
+ */
+std::unique_ptr<TraceSource> limit_trace_source(std::unique_ptr<TraceSource> source,
+                                                std::uint64_t count);
+std::unique_ptr<TraceSource> limit_trace_source(TraceSource& source, std::uint64_t count);
+
+/**
+ * LoadedTrace: a whole trace resident in memory, for runs that traverse
+ * the same trace many times (e.g. one pass per work unit).
+ *
+ * Binary trace files stay memory-mapped; text traces and streamed inputs
+ * (see open_trace_source()) are decoded once into PC and outcome arrays.
+ * Branch IDs are those of a version 2 file, or numbered once at load time,
+ * so all cursors share one ID space. source() returns independent cursors
+ * that hand out blocks without copying PCs or IDs (the PCs of a mapped
+ * version 2 file are looked up per block), so any number of threads may
+ * read the trace concurrently. Check ok() after construction.
+ */
+class LoadedTrace {
+public:
+    explicit LoadedTrace(const std::string& path);
+    explicit LoadedTrace(std::unique_ptr<ByteStream> input);
+
+    LoadedTrace(const LoadedTrace&)            = delete;
+    LoadedTrace& operator=(const LoadedTrace&) = delete;
+
+    bool ok() const { return error_.empty(); }
+    const std::string& error() const { return error_; }
+
+    std::uint64_t size() const { return records_; }
+    std::uint64_t static_branches() const { return static_branches_; }
+
+    // New cursor at the start of the trace; this object must outlive it.
+    std::unique_ptr<TraceSource> source() const;
+
+private:
+    std::unique_ptr<MappedTrace> mapped_; // binary trace files
+    std::vector<std::uint64_t>   pcs_;    // decoded traces
+    std::vector<Outcome>         outs_;   // decoded traces
+    std::vector<BranchId>        ids_;    // all but mapped version 2 files
+    std::uint64_t                records_         = 0;
+    std::uint64_t                static_branches_ = 0;
+    std::uint64_t                id_space_        = new_branch_id_space();
+    std::string                  error_;
+
+    void read_binary(ByteStream& input);
+    void read_text(std::unique_ptr<ByteStream> input);
+    std::size_t number_branches(const std::uint64_t* pcs, std::uint64_t expected);
+};
+
+} // namespace bp
+
+#endif // BP_TRACE_HPP
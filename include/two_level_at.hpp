@@ -7,8 +7,11 @@
 #include <string>
 
 #include "at_config.hpp"
+#include "collector.hpp"
 #include "pattern_table.hpp"
 #include "hrt.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
 #include "types.hpp"
 
 namespace bp {
@@ -22,19 +25,27 @@ namespace bp {
  *
  * Operation for each dynamic branch at PC:
  *
- *   1. Get local history:
- *        H_i = HRT.get(pc)
+ *   1. Get local history (the only HRT tag search for this branch):
+ *        slot = HRT.lookup(pc), H_i = slot.history
  *
  *   2. Prediction:
  *        z_c = A( S_c(H_i) ) = PT.predict(H_i)
  *
  *   3. After the branch is resolved:
  *        S_{c+1} = δ(S_c, R_{i,c})      → PT.update(H_i, outcome)
- *        H_i'    = (H_i << 1) | bit     → HRT.set(pc, H_i')
+ *        H_i'    = (H_i << 1) | bit     → HRT.commit(slot, H_i')
+ *
+ * predict() keeps the slot so that the following update() for the same PC
+ * does not search the HRT again.
+ *
+ * With cfg.pt_select other than Global, the PT is indexed by the pattern
+ * PTSelector::pattern(H_i, pc) instead of H_i (PAs, gshare); with the GHR
+ * first level the same engine runs GAg, GAs and gshare.
  */
 class TwoLevelATPredictor {
 public:
-    explicit TwoLevelATPredictor(const ATConfig& cfg);
+    // expected_branches: static-branch count used to pre-size an IHRT.
+    explicit TwoLevelATPredictor(const ATConfig& cfg, std::size_t expected_branches = 0);
 
     const std::string& name() const { return name_; }
 
@@ -44,21 +55,77 @@ public:
     // Update HRT & PT with actual outcome.
     void update(std::uint64_t pc, Outcome o);
 
+    /**
+     * Predict, score and update n consecutive branches.
+     *
+     * Equivalent to calling predict()/update() for each record in order and
+     * counting correct predictions into stats, but the HRT type is resolved
+     * once per call so the per-branch HRT and PT accesses are inlined.
+     * Each outcome is also reported to collector (collector.hpp); the
+     * instantiations are NoCollector and BranchStatsCollector.
+     */
+    template <class Collector>
+    void simulate_batch(const std::uint64_t* pcs, const Outcome* outs,
+                        std::size_t n, Stats& stats, Collector& collector);
+
+    void simulate_batch(const std::uint64_t* pcs, const Outcome* outs,
+                        std::size_t n, Stats& stats) {
+        NoCollector none;
+        simulate_batch(pcs, outs, n, stats, none);
+    }
+
+    /**
+     * The same with the branch IDs of the records: an IHRT then indexes its
+     * histories by ID (branch_table.hpp) instead of hashing the PC. Results
+     * are identical.
+     */
+    template <class Collector>
+    void simulate_batch(const BranchIds& ids, const std::uint64_t* pcs, const Outcome* outs,
+                        std::size_t n, Stats& stats, Collector& collector);
+
     /**
      * Approximate hardware cost in bits.
      *
      * This is not an exact transistor count, but a simple metric:
      *   - HRT cost = (#HRT entries) * history_bits
-     *   - PT cost  = (#PT entries) * 2   (assuming 2-bit FSMs)
+     *   - PT cost  = (#PT entries) * automaton_state_bits(), i.e.
+     *                ceil(log2(states)): 1 bit for LT, 2 for A2..A4, more
+     *                for a user --fsm with over 4 states
      */
     std::size_t hardware_cost_bits() const;
 
+    // First-level counters and second-level aliasing (hrt.hpp, pattern_table.hpp).
+    const HRTCounters& hrt_counters() const { return hrt_->counters(); }
+    void set_hrt_counters(const HRTCounters& c) { hrt_->set_counters(c); }
+    PTAliasSummary pt_alias() const { return pt_.alias_summary(); }
+
+    /**
+     * Dump / restore HRT and PT contents (snapshot.hpp). A predict() still
+     * waiting for its update() is not part of the snapshot.
+     */
+    void save(SnapshotWriter& out) const;
+    void load(SnapshotReader& in);
+
 private:
     std::string              name_;
+    HRTKind                  hrt_kind_;
+    ReplacementPolicy        hrt_replacement_;
+    IndexHash                hrt_index_;
     int                      history_bits_;
-    std::uint32_t            mask_;
+    History                  mask_;
+    PTSelector               select_;
     PatternTable             pt_;
     std::unique_ptr<HistoryTable> hrt_;
+
+    // Slot from the last predict(), reused by update() for the same PC.
+    HRTSlot                  pending_;
+    std::uint64_t            pending_pc_ = 0;
+    bool                     has_pending_ = false;
+
+    // Both simulate_batch() forms; ids may be null.
+    template <class Collector>
+    void simulate(const BranchIds* ids, const std::uint64_t* pcs, const Outcome* outs,
+                  std::size_t n, Stats& stats, Collector& collector);
 };
 
 } // namespace bp
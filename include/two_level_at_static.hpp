@@ -0,0 +1,178 @@
+#ifndef BP_TWO_LEVEL_AT_STATIC_HPP
+#define BP_TWO_LEVEL_AT_STATIC_HPP
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "at_config.hpp"
+#include "automaton.hpp"
+#include "collector.hpp"
+#include "hrt.hpp"
+#include "pattern_table.hpp"
+#include "snapshot.hpp"
+#include "stats.hpp"
+#include "types.hpp"
+
+namespace bp {
+
+/**
+ * TwoLevelAT<HRT, HistoryBits, Automaton>:
+ *
+ * Compile-time specialized version of TwoLevelATPredictor. It implements the
+ * same AT(HRT(kSR), PT(2^k, Automaton)) scheme with identical results, but:
+ *
+ *   - the HRT is held by value as its concrete (final) type, so every HRT
+ *     access binds statically and inlines;
+ *   - k is a template parameter, so the history mask and PT size are
+ *     constants and the PT is a fixed-size array;
+ *   - the automaton is a template parameter, so automaton_predict() and
+ *     automaton_next() index its constexpr AutomatonTable directly.
+ *
+ * The HRT geometry (entries, ways) stays a runtime parameter taken from the
+ * ATConfig. Instances are created through make_at_unit() (at_registry.hpp).
+ */
+template <class HRT, int HistoryBits, AutomatonType Automaton>
+class TwoLevelAT {
+public:
+    static_assert(HistoryBits > 0 && HistoryBits <= kDefaultMaxPTIndexBits,
+                  "specialized engines index the PT directly (no folding)");
+
+    static constexpr History       kMask      = history_mask(HistoryBits);
+    static constexpr std::size_t   kPTEntries = std::size_t{1} << HistoryBits;
+
+    explicit TwoLevelAT(const ATConfig& cfg, std::size_t expected_branches = 0)
+        : hrt_(make_hrt(cfg, expected_branches)), alias_(kPTEntries) {
+        pt_.fill(automaton_init_state(Automaton));
+    }
+
+    // predict()/update() share one HRT lookup, as in TwoLevelATPredictor.
+    bool predict(std::uint64_t pc) {
+        pending_     = hrt_.lookup(pc);
+        pending_pc_  = pc;
+        has_pending_ = true;
+        return automaton_predict(Automaton, pt_[pending_.history & kMask]);
+    }
+
+    void update(std::uint64_t pc, Outcome o) {
+        HRTSlot slot = (has_pending_ && pending_pc_ == pc) ? pending_ : hrt_.lookup(pc);
+        has_pending_ = false;
+
+        History       h    = slot.history;
+        std::uint8_t& st   = pt_[h & kMask];
+        st = automaton_next(Automaton, st, o);
+        hrt_.commit(slot, ((h << 1) | (o == Outcome::Taken ? 1u : 0u)) & kMask);
+    }
+
+    // Same contract as TwoLevelATPredictor::simulate_batch().
+    void simulate_batch(const std::uint64_t* pcs, const Outcome* outs,
+                        std::size_t n, Stats& stats) {
+        NoCollector none;
+        simulate_batch(pcs, outs, n, stats, none);
+    }
+
+    template <class Collector>
+    void simulate_batch(const std::uint64_t* pcs, const Outcome* outs,
+                        std::size_t n, Stats& stats, Collector& collector) {
+        if (alias_.observe_batch()) run<true, false>(nullptr, pcs, outs, n, stats, collector);
+        else                        run<false, false>(nullptr, pcs, outs, n, stats, collector);
+    }
+
+    // With branch IDs; only an IHRT uses them (HRT::kByBranchId).
+    template <class Collector>
+    void simulate_batch(const BranchIds& ids, const std::uint64_t* pcs, const Outcome* outs,
+                        std::size_t n, Stats& stats, Collector& collector) {
+        if constexpr (HRT::kByBranchId) {
+            hrt_.use_ids(ids.space);
+            if (alias_.observe_batch()) run<true, true>(ids.ids, pcs, outs, n, stats, collector);
+            else                        run<false, true>(ids.ids, pcs, outs, n, stats, collector);
+        } else {
+            simulate_batch(pcs, outs, n, stats, collector);
+        }
+    }
+
+    // Same metric as TwoLevelATPredictor::hardware_cost_bits().
+    std::size_t hardware_cost_bits() const {
+        return hrt_.capacity_entries() * HistoryBits +
+               kPTEntries * automaton_state_bits(Automaton);
+    }
+
+    const HRTCounters& hrt_counters() const { return hrt_.counters(); }
+    void set_hrt_counters(const HRTCounters& c) { hrt_.set_counters(c); }
+    PTAliasSummary pt_alias() const { return alias_.summary(); }
+
+    // Same snapshot layout as TwoLevelATPredictor with a byte-layout PT.
+    void save(SnapshotWriter& out) const {
+        hrt_.save(out);
+        out.write<std::uint32_t>(static_cast<std::uint32_t>(PTLayout::Bytes));
+        out.write_span(pt_.data(), pt_.size());
+        alias_.save(out);
+    }
+
+    void load(SnapshotReader& in) {
+        hrt_.load(in);
+        std::uint32_t layout = 0;
+        in.read(layout);
+        if (in.ok() && layout != static_cast<std::uint32_t>(PTLayout::Bytes)) {
+            in.fail("pattern table layout mismatch");
+            return;
+        }
+        in.read_span(pt_.data(), pt_.size());
+        if (in.ok() && !automaton_states_valid(Automaton, pt_.data(), pt_.size())) {
+            in.fail("pattern table state out of range for its automaton");
+            return;
+        }
+        alias_.load(in);
+        has_pending_ = false;
+    }
+
+private:
+    HRT                                 hrt_;
+    std::array<std::uint8_t, kPTEntries> pt_;
+    PTAliasSampler                       alias_;
+
+    HRTSlot       pending_;
+    std::uint64_t pending_pc_  = 0;
+    bool          has_pending_ = false;
+
+    // The batch loop; Observe feeds the PT aliasing sampler, ById looks
+    // branches up by ids[i].
+    template <bool Observe, bool ById, class Collector>
+    void run(const BranchId* ids, const std::uint64_t* pcs, const Outcome* outs,
+             std::size_t n, Stats& stats, Collector& collector) {
+        std::uint64_t correct = 0;
+
+        for (std::size_t i = 0; i < n; ++i) {
+            const std::uint64_t pc    = pcs[i];
+            const bool          taken = (outs[i] == Outcome::Taken);
+
+            HRTSlot       slot = lookup_branch<ById>(hrt_, ids, i, pc);
+            History       h    = slot.history;
+            std::uint8_t& st   = pt_[h & kMask];
+            const bool    hit  = (automaton_predict(Automaton, st) == taken);
+            correct += hit ? 1u : 0u;
+            collector.record(pc, hit);
+            if constexpr (Observe) alias_.observe(static_cast<std::uint32_t>(h & kMask), pc);
+            st = automaton_next(Automaton, st, outs[i]);
+            hrt_.commit(slot, ((h << 1) | (taken ? 1u : 0u)) & kMask);
+        }
+        stats.total   += n;
+        stats.correct += correct;
+    }
+
+    static HRT make_hrt(const ATConfig& cfg, std::size_t expected_branches) {
+        if constexpr (std::is_same_v<HRT, IHRTTable>) {
+            return IHRTTable(HistoryBits, expected_branches);
+        } else if constexpr (std::is_same_v<HRT, HHRTTable>) {
+            return HHRTTable(cfg.hrt_entries, HistoryBits);
+        } else {
+            // AHRTTableT<Policy, Index>, for any replacement policy
+            return HRT(cfg.hrt_entries, cfg.hrt_ways, HistoryBits);
+        }
+    }
+};
+
+} // namespace bp
+
+#endif // BP_TWO_LEVEL_AT_STATIC_HPP
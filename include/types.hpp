@@ -19,6 +19,39 @@ enum class Outcome : std::uint8_t {
     Taken    = 1
 };
 
+/**
+ * History: a k-bit branch history shift register (k <= 64), holding
+ * R_{i,c-k+1} ... R_{i,c} with the newest outcome in bit 0.
+ */
+using History = std::uint64_t;
+
+constexpr int kMaxHistoryBits = 64;
+
+// Mask selecting the low k bits of a History (well-defined for k = 64).
+constexpr History history_mask(int k) {
+    return (k >= kMaxHistoryBits) ? ~History{0} : ((History{1} << k) - 1u);
+}
+
+/**
+ * BranchId: dense number of a static branch (0, 1, ... in order of first
+ * appearance), assigned by the trace readers (trace.hpp) so that
+ * per-branch tables can be plain arrays instead of hash maps.
+ */
+using BranchId = std::uint32_t;
+
+constexpr BranchId kNoBranchId = ~BranchId{0};
+
+/**
+ * BranchIds: the branch IDs of a run of records, ids[i] naming the branch
+ * of pcs[i]. An ID only means something within its space: every trace
+ * source numbers its branches itself, under a space number no other
+ * source uses.
+ */
+struct BranchIds {
+    const BranchId* ids   = nullptr;
+    std::uint64_t   space = 0;
+};
+
 } // namespace bp
 
 #endif // BP_TYPES_HPP
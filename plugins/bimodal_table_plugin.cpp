@@ -0,0 +1,78 @@
+/*
+ * Example predictor plugin: a finite bimodal predictor, 2^BITS untagged
+ * 2-bit counters indexed by the low bits of PC >> 2, so unlike the
+ * built-in Bimodal2Bit (one counter per static branch) distinct branches
+ * can collide.
+ *
+ *   cmake --build build --target bp_plugin_bimodal_table
+ *   ./bp_sim --plugin ./libbp_plugin_bimodal_table.so \
+ *       --predictor BimodalTable:12 trace.bptrace bench
+ *
+ * The predictor only provides predict() and update(); PredictorBase turns
+ * them into simulate_batch(), instantiated here, so bp_sim makes one
+ * virtual call per block of branches and none per branch.
+ */
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "automaton.hpp"
+#include "predictor_registry.hpp"
+#include "predictors.hpp"
+
+namespace {
+
+using namespace bp;
+
+class BimodalTablePredictor : public PredictorBase<BimodalTablePredictor> {
+public:
+    explicit BimodalTablePredictor(int bits)
+        : mask_((std::uint64_t{1} << bits) - 1u), table_(std::size_t{1} << bits, 3) {}
+
+    bool predict(std::uint64_t pc) const {
+        return automaton_predict(AutomatonType::A2, table_[index(pc)]);
+    }
+
+    void update(std::uint64_t pc, Outcome o) {
+        std::uint8_t& st = table_[index(pc)];
+        st = automaton_next(AutomatonType::A2, st, o);
+    }
+
+    std::size_t hardware_cost_bits() const { return table_.size() * 2; }
+
+    void save(SnapshotWriter& out) const { out.write_array(table_); }
+    void load(SnapshotReader& in) {
+        const std::size_t size = table_.size();
+        in.read_array(table_);
+        if (table_.size() != size) in.fail("BimodalTable size differs from the snapshot");
+    }
+
+private:
+    std::uint64_t             mask_;
+    std::vector<std::uint8_t> table_; // 2-bit A2 states
+
+    std::size_t index(std::uint64_t pc) const { return static_cast<std::size_t>((pc >> 2) & mask_); }
+};
+
+} // namespace
+
+BP_PREDICTOR_PLUGIN(registry) {
+    registry.add("BimodalTable", "2^BITS untagged 2-bit counters (BimodalTable:BITS, 1..24)",
+                 [](const PredictorArgs& args,
+                    std::string&         error) -> std::unique_ptr<PredictorUnit> {
+                     int bits = 0;
+                     for (char c : args.params) {
+                         if (c < '0' || c > '9' || bits > 24) {
+                             bits = 0;
+                             break;
+                         }
+                         bits = bits * 10 + (c - '0');
+                     }
+                     if (bits < 1 || bits > 24) {
+                         error = "BimodalTable expects BITS in 1..24, got '" + args.params + "'";
+                         return nullptr;
+                     }
+                     return std::make_unique<PredictorSim<BimodalTablePredictor>>(args.label, bits);
+                 });
+}
@@ -0,0 +1,213 @@
+#include "arena.hpp"
+
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <linux/mempolicy.h>
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <new>
+#include <string>
+
+namespace bp {
+
+namespace {
+
+thread_local Arena* current_arena = nullptr;
+
+// Requests above this get a chunk of their own; smaller ones share.
+constexpr std::size_t kLargeRequestBytes = kHugePageBytes / 4;
+
+std::size_t round_up(std::size_t v, std::size_t to) { return (v + to - 1) / to * to; }
+
+/**
+ * Parse a sysfs CPU / node list such as "0-3,8,10-11" and call f(i) for
+ * every number in it. False if the text is malformed.
+ */
+template <class F>
+bool for_each_in_list(const std::string& list, F f) {
+    std::size_t pos = 0;
+    while (pos < list.size() && list[pos] != '\n') {
+        char*         end = nullptr;
+        unsigned long lo  = std::strtoul(list.c_str() + pos, &end, 10);
+        if (end == list.c_str() + pos) return false;
+        unsigned long hi = lo;
+        pos = static_cast<std::size_t>(end - list.c_str());
+        if (pos < list.size() && list[pos] == '-') {
+            const char* start = list.c_str() + pos + 1;
+            hi  = std::strtoul(start, &end, 10);
+            if (end == start || hi < lo) return false;
+            pos = static_cast<std::size_t>(end - list.c_str());
+        }
+        for (unsigned long i = lo; i <= hi; ++i) f(static_cast<unsigned>(i));
+        if (pos < list.size() && list[pos] == ',') ++pos;
+    }
+    return true;
+}
+
+std::string read_line(const std::string& path) {
+    std::ifstream in(path);
+    std::string   line;
+    std::getline(in, line);
+    return line;
+}
+
+} // namespace
+
+// ======================= Arena =======================
+
+Arena::Arena(int numa_node) : node_(numa_node) {}
+
+Arena::~Arena() {
+    for (const Chunk& c : chunks_) ::munmap(c.base, c.size);
+}
+
+Arena* Arena::current() { return current_arena; }
+
+/**
+ * Map bytes (rounded up to huge pages) at a huge-page boundary: map one
+ * huge page more than needed and unmap the misaligned head and tail.
+ */
+Arena::Chunk Arena::map_chunk(std::size_t bytes) {
+    const std::size_t size = round_up(bytes, kHugePageBytes);
+    void* raw = ::mmap(nullptr, size + kHugePageBytes, PROT_READ | PROT_WRITE,
+                       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (raw == MAP_FAILED) throw std::bad_alloc();
+
+    char*       base = static_cast<char*>(raw);
+    const auto  addr = reinterpret_cast<std::uintptr_t>(base);
+    const std::size_t head = round_up(addr, kHugePageBytes) - addr;
+    if (head) ::munmap(base, head);
+    if (kHugePageBytes - head) ::munmap(base + head + size, kHugePageBytes - head);
+    base += head;
+
+#ifdef MADV_HUGEPAGE
+    ::madvise(base, size, MADV_HUGEPAGE); // advisory; fails harmlessly without THP
+#endif
+    if (node_ >= 0) {
+        // Raw syscall: no libnuma dependency. A failure only loses locality.
+        constexpr unsigned kBitsPerWord = 8 * sizeof(unsigned long);
+        std::vector<unsigned long> mask(static_cast<unsigned>(node_) / kBitsPerWord + 1, 0);
+        mask[static_cast<unsigned>(node_) / kBitsPerWord] |= 1ul << (node_ % kBitsPerWord);
+        ::syscall(SYS_mbind, base, size, MPOL_PREFERRED, mask.data(),
+                  mask.size() * kBitsPerWord + 1, 0);
+    }
+    chunks_.push_back({base, size});
+    return chunks_.back();
+}
+
+void* Arena::allocate(std::size_t bytes, std::size_t alignment) {
+    if (bytes == 0) bytes = 1;
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (bytes > kLargeRequestBytes) return map_chunk(bytes).base;
+
+    auto aligned = [&] {
+        const auto a = reinterpret_cast<std::uintptr_t>(cur_);
+        return cur_ + (round_up(a, alignment) - a);
+    };
+    if (!cur_ || aligned() + bytes > end_) {
+        const Chunk c = map_chunk(kHugePageBytes);
+        cur_ = c.base;
+        end_ = c.base + c.size;
+    }
+    char* p = aligned();
+    cur_    = p + bytes;
+    return p;
+}
+
+std::size_t Arena::mapped_bytes() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::size_t bytes = 0;
+    for (const Chunk& c : chunks_) bytes += c.size;
+    return bytes;
+}
+
+// ======================= ArenaScope =======================
+
+ArenaScope::ArenaScope(Arena* arena) : previous_(current_arena) { current_arena = arena; }
+
+ArenaScope::~ArenaScope() { current_arena = previous_; }
+
+// ======================= Arena objects =======================
+
+namespace {
+
+// Header in front of every arena_new() block; keeps the default alignment.
+constexpr std::size_t kObjectHeader = __STDCPP_DEFAULT_NEW_ALIGNMENT__;
+static_assert(kObjectHeader >= sizeof(Arena*), "header must hold the arena");
+
+} // namespace
+
+void* arena_new(std::size_t bytes) {
+    Arena* arena = current_arena;
+    void*  raw   = arena ? arena->allocate(kObjectHeader + bytes, kObjectHeader)
+                         : ::operator new(kObjectHeader + bytes);
+    char*  block = static_cast<char*>(raw);
+    *reinterpret_cast<Arena**>(block) = arena;
+    return block + kObjectHeader;
+}
+
+void arena_delete(void* p) noexcept {
+    if (!p) return;
+    char* block = static_cast<char*>(p) - kObjectHeader;
+    if (!*reinterpret_cast<Arena**>(block)) ::operator delete(block);
+}
+
+// ======================= ArenaSet =======================
+
+ArenaSet::ArenaSet(unsigned workers) {
+    if (workers == 0) workers = 1;
+    const bool place = workers > 1 && numa_node_count() > 1;
+    for (unsigned w = 0; w < workers; ++w) {
+        arenas_.push_back(std::make_unique<Arena>(place ? static_cast<int>(worker_numa_node(w))
+                                                        : -1));
+    }
+}
+
+unsigned ArenaSet::next() {
+    const unsigned w = next_;
+    next_ = (next_ + 1) % size();
+    return w;
+}
+
+std::size_t ArenaSet::mapped_bytes() const {
+    std::size_t bytes = 0;
+    for (const auto& a : arenas_) bytes += a->mapped_bytes();
+    return bytes;
+}
+
+// ======================= NUMA =======================
+
+unsigned numa_node_count() {
+    static const unsigned count = [] {
+        unsigned nodes = 0;
+        const bool ok  = for_each_in_list(read_line("/sys/devices/system/node/online"),
+                                          [&](unsigned n) { nodes = std::max(nodes, n + 1); });
+        return (ok && nodes > 0) ? nodes : 1u;
+    }();
+    return count;
+}
+
+unsigned worker_numa_node(unsigned w) { return w % numa_node_count(); }
+
+bool pin_thread_to_numa_node(unsigned node) {
+    const std::string list =
+        read_line("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    bool any = false;
+    const bool ok = for_each_in_list(list, [&](unsigned cpu) {
+        if (cpu < CPU_SETSIZE) {
+            CPU_SET(cpu, &set);
+            any = true;
+        }
+    });
+    return ok && any && ::sched_setaffinity(0, sizeof(set), &set) == 0;
+}
+
+} // namespace bp
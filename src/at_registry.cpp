@@ -0,0 +1,187 @@
+#include "at_registry.hpp"
+
+#include <algorithm>
+
+#include "shared_hrt.hpp"
+#include "two_level_at_static.hpp"
+
+namespace bp {
+
+namespace {
+
+/**
+ * StaticATSim: SimUnit wrapper around one TwoLevelAT<> instantiation.
+ */
+template <class Engine>
+class StaticATSim : public ATUnit {
+public:
+    StaticATSim(const ATConfig& c, std::size_t expected_branches)
+        : ATUnit(c), engine_(c, expected_branches) {}
+
+    void run_block(const TraceBlock& block) override { simulate_block(engine_, block, *this); }
+
+    std::size_t hardware_cost_bits() const override {
+        return engine_.hardware_cost_bits();
+    }
+
+    HRTCounters    hrt_counters() const override { return engine_.hrt_counters(); }
+    void           set_hrt_counters(const HRTCounters& c) override { engine_.set_hrt_counters(c); }
+    PTAliasSummary pt_alias() const override { return engine_.pt_alias(); }
+
+    void save(SnapshotWriter& out) const override {
+        out.write_string(cfg.name);
+        out.write(stats);
+        engine_.save(out);
+    }
+
+    void load(SnapshotReader& in) override {
+        in.expect_string(cfg.name, "unit");
+        in.read(stats);
+        engine_.load(in);
+    }
+
+private:
+    Engine engine_;
+};
+
+using Factory = std::unique_ptr<ATUnit> (*)(const ATConfig&, std::size_t);
+
+template <class HRT, int K, AutomatonType A>
+std::unique_ptr<ATUnit> make_static(const ATConfig& cfg, std::size_t expected_branches) {
+    return std::make_unique<StaticATSim<TwoLevelAT<HRT, K, A>>>(cfg, expected_branches);
+}
+
+template <class HRT, int K>
+Factory factory_for(AutomatonType a) {
+    switch (a) {
+        case AutomatonType::LastTime: return &make_static<HRT, K, AutomatonType::LastTime>;
+        case AutomatonType::A2:       return &make_static<HRT, K, AutomatonType::A2>;
+        case AutomatonType::A3:       return &make_static<HRT, K, AutomatonType::A3>;
+        case AutomatonType::A4:       return &make_static<HRT, K, AutomatonType::A4>;
+    }
+    return nullptr;
+}
+
+template <class HRT>
+Factory factory_for(int history_bits, AutomatonType a) {
+    switch (history_bits) {
+        case 6:  return factory_for<HRT, 6>(a);
+        case 8:  return factory_for<HRT, 8>(a);
+        case 10: return factory_for<HRT, 10>(a);
+        case 12: return factory_for<HRT, 12>(a);
+        default: return nullptr;
+    }
+}
+
+Factory lookup(const ATConfig& cfg) {
+    // The specialized engines keep their PT as a byte array indexed by the
+    // full, unfolded history.
+    if (cfg.pt_layout != PTLayout::Bytes) return nullptr;
+    if (cfg.pt_index_bits != 0 && cfg.pt_index_bits < cfg.history_bits) return nullptr;
+    // Hashed HRT indices run on the runtime engine, whose loop is still
+    // specialized per HRT (and so per index function) type.
+    if (cfg.hrt_kind != HRTKind::IHRT && cfg.hrt_index != IndexHash::Low) return nullptr;
+    // Likewise the global-history schemes and per-set / gshare PT selection.
+    if (cfg.pt_select != PTSelect::Global) return nullptr;
+
+    switch (cfg.hrt_kind) {
+        case HRTKind::AHRT:
+            switch (cfg.hrt_replacement) {
+                case ReplacementPolicy::RoundRobin:
+                    return factory_for<AHRTTable>(cfg.history_bits, cfg.automaton);
+                case ReplacementPolicy::LRU:
+                    return factory_for<LRUAHRTTable>(cfg.history_bits, cfg.automaton);
+                case ReplacementPolicy::TreePLRU:
+                    return factory_for<PLRUAHRTTable>(cfg.history_bits, cfg.automaton);
+                case ReplacementPolicy::Random:
+                    return factory_for<RandAHRTTable>(cfg.history_bits, cfg.automaton);
+            }
+            return nullptr;
+        case HRTKind::HHRT: return factory_for<HHRTTable>(cfg.history_bits, cfg.automaton);
+        case HRTKind::IHRT: return factory_for<IHRTTable>(cfg.history_bits, cfg.automaton);
+        case HRTKind::GHR:  return nullptr;
+    }
+    return nullptr;
+}
+
+} // namespace
+
+bool has_specialized_engine(const ATConfig& cfg) {
+    return lookup(cfg) != nullptr;
+}
+
+std::unique_ptr<ATUnit> make_at_unit(const ATConfig& cfg, const EngineOptions& opts) {
+    if (opts.allow_specialized) {
+        if (Factory f = lookup(cfg)) return f(cfg, opts.static_branches);
+    }
+    return std::make_unique<ATSim>(cfg, opts.static_branches);
+}
+
+ATSweep make_at_sweep(const std::vector<ATConfig>& configs, const EngineOptions& opts,
+                      ArenaSet* arenas) {
+    ATSweep sweep;
+    sweep.configs.resize(configs.size());
+    sweep.drivers.resize(configs.size());
+
+    // Partition into sets with the same HRT geometry, keeping input order.
+    std::vector<std::vector<std::size_t>> sets;
+    for (std::size_t i = 0; i < configs.size(); ++i) {
+        auto it = std::find_if(sets.begin(), sets.end(), [&](const auto& s) {
+            return opts.share_hrt && same_hrt_geometry(configs[s.front()], configs[i]);
+        });
+        if (it == sets.end()) sets.push_back({i});
+        else                  it->push_back(i);
+    }
+
+    // Split the largest sets while some worker would have no unit.
+    while (sets.size() < opts.workers) {
+        auto largest = std::max_element(sets.begin(), sets.end(), [](const auto& a, const auto& b) {
+            return a.size() < b.size();
+        });
+        if (largest->size() < 2) break;
+        const std::size_t        keep = largest->size() / 2;
+        std::vector<std::size_t> rest(largest->begin() + static_cast<std::ptrdiff_t>(keep),
+                                      largest->end());
+        largest->resize(keep);
+        sets.insert(largest + 1, std::move(rest));
+    }
+
+    for (const auto& set : sets) {
+        // Build each scheduled unit, with everything it drives, in the arena
+        // of the worker that will run it.
+        Arena* arena = nullptr;
+        int    home  = -1;
+        if (arenas) {
+            const unsigned w = arenas->next();
+            arena = &arenas->arena(w);
+            if (arenas->size() > 1) home = static_cast<int>(w);
+        }
+        ArenaScope scope(arena);
+
+        if (set.size() == 1) {
+            sweep.configs[set.front()] = make_at_unit(configs[set.front()], opts);
+            sweep.drivers[set.front()] = sweep.configs[set.front()].get();
+            sweep.drivers[set.front()]->home_worker = home;
+            sweep.units.push_back(sweep.drivers[set.front()]);
+            continue;
+        }
+
+        int k = 0;
+        for (std::size_t i : set) k = std::max(k, configs[i].history_bits);
+
+        auto group = std::make_unique<SharedHRTGroup>(configs[set.front()], k,
+                                                      opts.static_branches);
+        for (std::size_t i : set) {
+            auto member = std::make_unique<SharedATMember>(configs[i], *group);
+            group->add_member(member.get());
+            sweep.configs[i] = std::move(member);
+            sweep.drivers[i] = group.get();
+        }
+        group->home_worker = home;
+        sweep.units.push_back(group.get());
+        sweep.groups.push_back(std::move(group));
+    }
+    return sweep;
+}
+
+} // namespace bp
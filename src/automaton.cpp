@@ -0,0 +1,107 @@
+#include "automaton.hpp"
+
+#include <deque>
+
+namespace bp {
+
+namespace {
+
+constexpr unsigned kFirstUserAutomaton = static_cast<unsigned>(AutomatonType::A4) + 1;
+
+struct UserAutomaton {
+    std::string    name;
+    AutomatonTable table;
+};
+
+// A deque, so the tables handed out by user_automaton_table() never move.
+std::deque<UserAutomaton>& user_automata() {
+    static std::deque<UserAutomaton> automata;
+    return automata;
+}
+
+const char* const kBuiltinNames[] = {"LT", "A2", "A3", "A4"};
+
+} // namespace
+
+const AutomatonTable& user_automaton_table(AutomatonType t) {
+    return user_automata()[static_cast<unsigned>(t) - kFirstUserAutomaton].table;
+}
+
+bool automaton_states_valid(AutomatonType t, const std::uint8_t* states, std::size_t n) {
+    const std::uint8_t count = automaton_table(t).states;
+    for (std::size_t i = 0; i < n; ++i) {
+        if (states[i] >= count) return false;
+    }
+    return true;
+}
+
+const char* automaton_name(AutomatonType t) {
+    const unsigned i = static_cast<unsigned>(t);
+    if (i < kFirstUserAutomaton) return kBuiltinNames[i];
+    return user_automata()[i - kFirstUserAutomaton].name.c_str();
+}
+
+bool find_automaton(const std::string& name, AutomatonType& out) {
+    for (unsigned i = 0; i < kFirstUserAutomaton; ++i) {
+        if (name == kBuiltinNames[i]) {
+            out = static_cast<AutomatonType>(i);
+            return true;
+        }
+    }
+    const std::deque<UserAutomaton>& automata = user_automata();
+    for (std::size_t i = 0; i < automata.size(); ++i) {
+        if (automata[i].name == name) {
+            out = static_cast<AutomatonType>(kFirstUserAutomaton + i);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool define_automaton(const std::string& name, const AutomatonTable& table,
+                      AutomatonType& out, std::string& error) {
+    bool word = !name.empty();
+    for (char c : name) {
+        word = word && ((c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || (c >= '0' && c <= '9'));
+    }
+    if (!word) {
+        error = "automaton name '" + name + "' must be letters and digits";
+        return false;
+    }
+    AutomatonType existing;
+    if (find_automaton(name, existing)) {
+        error = "automaton '" + name + "' is already defined";
+        return false;
+    }
+    if (user_automata().size() >= kMaxUserAutomata) {
+        error = "too many automata (at most " + std::to_string(kMaxUserAutomata) + ")";
+        return false;
+    }
+
+    const unsigned states = table.states;
+    if (states < 2 || states > kMaxAutomatonStates) {
+        error = "automaton '" + name + "' needs 2.." + std::to_string(kMaxAutomatonStates) +
+                " states";
+        return false;
+    }
+    bool in_range = table.init < states && (table.taken_states >> states) == 0;
+    for (unsigned s = 0; s < states; ++s) {
+        in_range = in_range && table.delta[s][0] < states && table.delta[s][1] < states;
+    }
+    if (!in_range) {
+        error = "automaton '" + name + "' refers to a state outside 0.." +
+                std::to_string(states - 1);
+        return false;
+    }
+
+    // Unused rows go to state 0, so even a stray state stays in the table.
+    UserAutomaton a{name, table};
+    for (unsigned s = states; s < kMaxAutomatonStates; ++s) {
+        a.table.delta[s][0] = a.table.delta[s][1] = 0;
+    }
+    user_automata().push_back(a);
+    out = static_cast<AutomatonType>(kFirstUserAutomaton + user_automata().size() - 1);
+    return true;
+}
+
+} // namespace bp
@@ -0,0 +1,429 @@
+#include "byte_stream.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#ifdef BP_HAVE_ZLIB
+#include <zlib.h>
+#endif
+#ifdef BP_HAVE_LZMA
+#include <lzma.h>
+#endif
+#ifdef BP_HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+namespace bp {
+
+// ======================= ByteStream =======================
+
+std::size_t ByteStream::read(char* buf, std::size_t max) {
+    if (!pushback_.empty()) {
+        std::size_t n = pushback_.size() < max ? pushback_.size() : max;
+        std::memcpy(buf, pushback_.data(), n);
+        pushback_.erase(0, n);
+        return n;
+    }
+    if (!ok()) return 0;
+    return read_some(buf, max);
+}
+
+std::size_t ByteStream::peek(char* buf, std::size_t n) {
+    while (pushback_.size() < n && ok()) {
+        char        tmp[64];
+        std::size_t want = n - pushback_.size();
+        std::size_t got  = read_some(tmp, want < sizeof(tmp) ? want : sizeof(tmp));
+        if (got == 0) break;
+        pushback_.append(tmp, got);
+    }
+    std::size_t avail = pushback_.size() < n ? pushback_.size() : n;
+    std::memcpy(buf, pushback_.data(), avail);
+    return avail;
+}
+
+namespace {
+
+constexpr std::size_t kInputBytes = 1u << 18; // compressed bytes per refill
+
+/**
+ * A file descriptor: a file, a FIFO or standard input (not closed).
+ */
+class FdStream final : public ByteStream {
+public:
+    explicit FdStream(const std::string& path)
+        : ByteStream(is_stdin_path(path) ? "<stdin>" : path) {
+        if (is_stdin_path(path)) {
+            fd_ = STDIN_FILENO;
+            return;
+        }
+        fd_ = ::open(path.c_str(), O_RDONLY);
+        if (fd_ < 0) {
+            error_ = "could not open trace file '" + path + "'";
+            return;
+        }
+        owned_ = true;
+#ifdef POSIX_FADV_SEQUENTIAL
+        ::posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL); // no-op on pipes
+#endif
+    }
+
+    ~FdStream() override {
+        if (owned_) ::close(fd_);
+    }
+
+protected:
+    std::size_t read_some(char* buf, std::size_t max) override {
+        for (;;) {
+            ssize_t n = ::read(fd_, buf, max);
+            if (n >= 0) return static_cast<std::size_t>(n);
+            if (errno == EINTR) continue;
+            error_ = "read error on '" + name() + "'";
+            return 0;
+        }
+    }
+
+private:
+    int  fd_    = -1;
+    bool owned_ = false;
+};
+
+/**
+ * Base of the library decoders: compressed input is pulled from another
+ * stream kInputBytes at a time.
+ */
+class DecoderStream : public ByteStream {
+protected:
+    explicit DecoderStream(std::unique_ptr<ByteStream> in)
+        : ByteStream(in->name()), in_(std::move(in)), input_(kInputBytes) {}
+
+    // Refill input_ once it is consumed; false at end of compressed input.
+    bool refill(const std::uint8_t*& next, std::size_t& avail) {
+        if (avail != 0) return true;
+        if (in_eof_) return false;
+        avail = in_->read(input_.data(), input_.size());
+        next  = reinterpret_cast<const std::uint8_t*>(input_.data());
+        if (avail == 0) {
+            in_eof_ = true;
+            if (!in_->ok()) error_ = in_->error();
+        }
+        return avail != 0;
+    }
+
+    std::unique_ptr<ByteStream> in_;
+    std::vector<char>           input_;
+    bool                        in_eof_ = false;
+    bool                        done_   = false;
+};
+
+#ifdef BP_HAVE_ZLIB
+// gzip (and zlib) streams; concatenated members are decoded in turn.
+class GzipStream final : public DecoderStream {
+public:
+    explicit GzipStream(std::unique_ptr<ByteStream> in) : DecoderStream(std::move(in)) {
+        // 15 + 32: maximum window, detect gzip or zlib headers
+        if (inflateInit2(&zs_, 15 + 32) != Z_OK) error_ = "zlib initialisation failed";
+        else                                      init_ = true;
+    }
+
+    ~GzipStream() override {
+        if (init_) inflateEnd(&zs_);
+    }
+
+protected:
+    std::size_t read_some(char* buf, std::size_t max) override {
+        zs_.next_out  = reinterpret_cast<Bytef*>(buf);
+        zs_.avail_out = static_cast<uInt>(max);
+        while (!done_ && zs_.avail_out == max) {
+            const std::uint8_t* next  = zs_.next_in;
+            std::size_t         avail = zs_.avail_in;
+            if (!refill(next, avail)) {
+                if (ok()) error_ = "'" + name() + "' is truncated (gzip)";
+                break;
+            }
+            zs_.next_in  = const_cast<Bytef*>(next);
+            zs_.avail_in = static_cast<uInt>(avail);
+
+            int ret = inflate(&zs_, Z_NO_FLUSH);
+            if (ret == Z_STREAM_END) {
+                const std::uint8_t* n2 = zs_.next_in;
+                std::size_t         a2 = zs_.avail_in;
+                if (refill(n2, a2)) {
+                    zs_.next_in  = const_cast<Bytef*>(n2);
+                    zs_.avail_in = static_cast<uInt>(a2);
+                    inflateReset(&zs_); // another member follows
+                } else {
+                    done_ = true;
+                }
+            } else if (ret != Z_OK && ret != Z_BUF_ERROR) {
+                error_ = "'" + name() + "': gzip data error";
+                break;
+            }
+        }
+        return max - zs_.avail_out;
+    }
+
+private:
+    z_stream zs_{};
+    bool     init_ = false;
+};
+#endif
+
+#ifdef BP_HAVE_LZMA
+class XzStream final : public DecoderStream {
+public:
+    explicit XzStream(std::unique_ptr<ByteStream> in) : DecoderStream(std::move(in)) {
+        if (lzma_stream_decoder(&ls_, UINT64_MAX, LZMA_CONCATENATED) != LZMA_OK) {
+            error_ = "liblzma initialisation failed";
+        }
+    }
+
+    ~XzStream() override { lzma_end(&ls_); }
+
+protected:
+    std::size_t read_some(char* buf, std::size_t max) override {
+        ls_.next_out  = reinterpret_cast<std::uint8_t*>(buf);
+        ls_.avail_out = max;
+        while (!done_ && ls_.avail_out == max) {
+            const std::uint8_t* next  = ls_.next_in;
+            std::size_t         avail = ls_.avail_in;
+            const bool more = refill(next, avail);
+            if (!ok()) break;
+            ls_.next_in  = next;
+            ls_.avail_in = avail;
+
+            lzma_ret ret = lzma_code(&ls_, more ? LZMA_RUN : LZMA_FINISH);
+            if (ret == LZMA_STREAM_END) {
+                done_ = true;
+            } else if (ret != LZMA_OK) {
+                error_ = "'" + name() + "': xz data error or truncated input";
+                break;
+            }
+        }
+        return max - ls_.avail_out;
+    }
+
+private:
+    lzma_stream ls_ = LZMA_STREAM_INIT;
+};
+#endif
+
+#ifdef BP_HAVE_ZSTD
+// zstd frames; concatenated frames are decoded in turn.
+class ZstdStream final : public DecoderStream {
+public:
+    explicit ZstdStream(std::unique_ptr<ByteStream> in)
+        : DecoderStream(std::move(in)), ds_(ZSTD_createDStream()) {
+        if (!ds_ || ZSTD_isError(ZSTD_initDStream(ds_))) error_ = "libzstd initialisation failed";
+    }
+
+    ~ZstdStream() override { ZSTD_freeDStream(ds_); }
+
+protected:
+    std::size_t read_some(char* buf, std::size_t max) override {
+        ZSTD_outBuffer out = {buf, max, 0};
+        while (out.pos == 0) {
+            std::size_t avail = in_buf_.size - in_buf_.pos;
+            const std::uint8_t* next =
+                static_cast<const std::uint8_t*>(in_buf_.src) + in_buf_.pos;
+            if (!refill(next, avail)) {
+                if (ok() && !frame_done_) error_ = "'" + name() + "' is truncated (zstd)";
+                break;
+            }
+            in_buf_ = {next, avail, 0};
+
+            std::size_t ret = ZSTD_decompressStream(ds_, &out, &in_buf_);
+            if (ZSTD_isError(ret)) {
+                error_ = "'" + name() + "': zstd data error (" + ZSTD_getErrorName(ret) + ")";
+                break;
+            }
+            frame_done_ = (ret == 0);
+            // Consumed input must be reported back to refill() as empty.
+            if (in_buf_.pos == in_buf_.size) in_buf_ = {nullptr, 0, 0};
+        }
+        return out.pos;
+    }
+
+private:
+    ZSTD_DStream* ds_;
+    ZSTD_inBuffer in_buf_    = {nullptr, 0, 0};
+    bool          frame_done_ = true;
+};
+#endif
+
+Compression detect(ByteStream& s) {
+    unsigned char m[6] = {};
+    std::size_t   n    = s.peek(reinterpret_cast<char*>(m), sizeof(m));
+    if (n >= 2 && m[0] == 0x1f && m[1] == 0x8b) return Compression::Gzip;
+    if (n >= 6 && std::memcmp(m, "\xfd" "7zXZ\0", 6) == 0) return Compression::Xz;
+    if (n >= 4 && m[0] == 0x28 && m[1] == 0xb5 && m[2] == 0x2f && m[3] == 0xfd) {
+        return Compression::Zstd;
+    }
+    return Compression::None;
+}
+
+#if !defined(BP_HAVE_ZLIB) || !defined(BP_HAVE_LZMA) || !defined(BP_HAVE_ZSTD)
+/**
+ * The decompressor fallback: `tool -dc` with the already-opened stream
+ * (including the bytes detect() peeked) fed to its standard input, so
+ * FIFOs and standard input work as well as files.
+ *
+ * The stream is pumped from read_some() itself: poll() waits until the
+ * tool has output or can take more input, so no thread is needed. Its
+ * input is one end of a socket pair, written with MSG_NOSIGNAL, so a tool
+ * that exits early yields an error rather than SIGPIPE. A non-zero exit
+ * status is reported as an error at end of output.
+ */
+class ToolStream final : public ByteStream {
+public:
+    ToolStream(std::unique_ptr<ByteStream> in, const char* tool)
+        : ByteStream(in->name()), in_(std::move(in)), tool_(tool), buffer_(kInputBytes) {
+        int to_tool[2];
+        int from_tool[2];
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, to_tool) != 0) {
+            error_ = "could not run '" + tool_ + "'";
+            return;
+        }
+        if (::pipe(from_tool) != 0) {
+            ::close(to_tool[0]);
+            ::close(to_tool[1]);
+            error_ = "could not run '" + tool_ + "'";
+            return;
+        }
+        pid_ = ::fork();
+        if (pid_ == 0) {
+            ::dup2(to_tool[1], STDIN_FILENO);
+            ::dup2(from_tool[1], STDOUT_FILENO);
+            for (int fd : {to_tool[0], to_tool[1], from_tool[0], from_tool[1]}) ::close(fd);
+            ::execlp(tool, tool, "-dc", static_cast<char*>(nullptr));
+            ::_exit(127);
+        }
+        ::close(to_tool[1]);
+        ::close(from_tool[1]);
+        to_   = to_tool[0];
+        from_ = from_tool[0];
+        if (pid_ < 0) {
+            error_ = "could not run '" + tool_ + "'";
+            return;
+        }
+        ::fcntl(to_, F_SETFL, ::fcntl(to_, F_GETFL) | O_NONBLOCK);
+    }
+
+    ~ToolStream() override {
+        close_input();
+        if (from_ >= 0) ::close(from_);
+        if (pid_ > 0) ::waitpid(pid_, nullptr, 0);
+    }
+
+protected:
+    std::size_t read_some(char* buf, std::size_t max) override {
+        while (from_ >= 0) {
+            pollfd fds[2] = {{from_, POLLIN, 0}, {to_, POLLOUT, 0}};
+            const nfds_t n = (to_ >= 0) ? 2 : 1;
+            if (::poll(fds, n, -1) < 0) {
+                if (errno == EINTR) continue;
+                error_ = "poll error on '" + tool_ + "'";
+                return 0;
+            }
+            if (fds[0].revents) {
+                ssize_t got = ::read(from_, buf, max);
+                if (got > 0) return static_cast<std::size_t>(got);
+                if (got < 0 && errno == EINTR) continue;
+                finish(got < 0);
+                return 0;
+            }
+            if (n == 2 && fds[1].revents) feed();
+        }
+        return 0;
+    }
+
+private:
+    std::unique_ptr<ByteStream> in_;
+    std::string                 tool_;
+    std::vector<char>           buffer_;     // compressed bytes read from in_
+    std::size_t                 begin_ = 0;  // not yet written: buffer_[begin_, end_)
+    std::size_t                 end_   = 0;
+    pid_t                       pid_   = -1;
+    int                         to_    = -1; // the tool's standard input
+    int                         from_  = -1; // its standard output
+
+    // Hand the tool more input; close its input at the end of in_.
+    void feed() {
+        if (begin_ == end_) {
+            begin_ = 0;
+            end_   = in_->read(buffer_.data(), buffer_.size());
+            if (end_ == 0) {
+                if (!in_->ok()) error_ = in_->error();
+                close_input();
+                return;
+            }
+        }
+        ssize_t put = ::send(to_, buffer_.data() + begin_, end_ - begin_, MSG_NOSIGNAL);
+        if (put > 0) {
+            begin_ += static_cast<std::size_t>(put);
+        } else if (put < 0 && errno != EAGAIN && errno != EINTR) {
+            close_input(); // the tool stopped reading; its exit status tells why
+        }
+    }
+
+    void close_input() {
+        if (to_ >= 0) ::close(to_);
+        to_ = -1;
+    }
+
+    // End of the tool's output: reap it.
+    void finish(bool read_failed) {
+        ::close(from_);
+        from_ = -1;
+        close_input();
+        int status = 0;
+        ::waitpid(pid_, &status, 0);
+        pid_ = -1;
+        if (!ok()) return;
+        if (read_failed || !WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            error_ = "'" + tool_ + " -dc' failed on '" + name() + "'";
+        }
+    }
+};
+#endif
+
+} // namespace
+
+std::unique_ptr<ByteStream> open_byte_stream(const std::string& path) {
+    std::unique_ptr<ByteStream> raw = std::make_unique<FdStream>(path);
+    if (!raw->ok()) return raw;
+
+    switch (detect(*raw)) {
+        case Compression::None:
+            return raw;
+        case Compression::Gzip:
+#ifdef BP_HAVE_ZLIB
+            return std::make_unique<GzipStream>(std::move(raw));
+#else
+            return std::make_unique<ToolStream>(std::move(raw), "gzip");
+#endif
+        case Compression::Xz:
+#ifdef BP_HAVE_LZMA
+            return std::make_unique<XzStream>(std::move(raw));
+#else
+            return std::make_unique<ToolStream>(std::move(raw), "xz");
+#endif
+        case Compression::Zstd:
+#ifdef BP_HAVE_ZSTD
+            return std::make_unique<ZstdStream>(std::move(raw));
+#else
+            return std::make_unique<ToolStream>(std::move(raw), "zstd");
+#endif
+    }
+    return raw;
+}
+
+} // namespace bp
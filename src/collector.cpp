@@ -0,0 +1,71 @@
+#include "collector.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <numeric>
+
+namespace bp {
+
+std::vector<BranchStatsCollector::Branch> BranchStatsCollector::top(std::size_t n) const {
+    std::vector<std::uint32_t> ids(pcs_.size());
+    std::iota(ids.begin(), ids.end(), 0u);
+    n = std::min(n, ids.size());
+
+    // Most mispredictions first; ties by more executions, then lower PC.
+    std::partial_sort(ids.begin(), ids.begin() + static_cast<std::ptrdiff_t>(n), ids.end(),
+                      [&](std::uint32_t a, std::uint32_t b) {
+                          if (mispredicts_[a] != mispredicts_[b]) return mispredicts_[a] > mispredicts_[b];
+                          if (executions_[a] != executions_[b]) return executions_[a] > executions_[b];
+                          return pcs_[a] < pcs_[b];
+                      });
+
+    std::vector<Branch> worst;
+    worst.reserve(n);
+    for (std::size_t i = 0; i < n; ++i) {
+        worst.push_back({pcs_[ids[i]], executions_[ids[i]], mispredicts_[ids[i]]});
+    }
+    return worst;
+}
+
+namespace {
+
+double percent_correct(std::uint64_t total, std::uint64_t misses) {
+    if (total == 0) return 0.0;
+    return 100.0 * static_cast<double>(total - misses) / static_cast<double>(total);
+}
+
+} // namespace
+
+void write_interval_csv(std::ostream& out, const std::vector<std::string>& schemes,
+                        const std::vector<const BranchStatsCollector*>& collectors) {
+    out << "scheme,interval,branches,mispredicts,accuracy,mpkb\n";
+    out << std::fixed << std::setprecision(2);
+    for (std::size_t s = 0; s < collectors.size(); ++s) {
+        const auto& series = collectors[s]->intervals();
+        for (std::size_t i = 0; i < series.size(); ++i) {
+            const auto& iv = series[i];
+            double mpkb = iv.branches ? 1000.0 * static_cast<double>(iv.mispredicts) /
+                                            static_cast<double>(iv.branches)
+                                      : 0.0;
+            out << schemes[s] << "," << i << "," << iv.branches << "," << iv.mispredicts << ","
+                << percent_correct(iv.branches, iv.mispredicts) << "," << mpkb << "\n";
+        }
+    }
+}
+
+void write_top_branches_csv(std::ostream& out, const std::vector<std::string>& schemes,
+                            const std::vector<const BranchStatsCollector*>& collectors,
+                            std::size_t top_n) {
+    out << "scheme,rank,pc,executions,mispredicts,accuracy\n";
+    out << std::fixed << std::setprecision(2);
+    for (std::size_t s = 0; s < collectors.size(); ++s) {
+        std::size_t rank = 1;
+        for (const auto& b : collectors[s]->top(top_n)) {
+            out << schemes[s] << "," << rank++ << ",0x" << std::hex << b.pc << std::dec << ","
+                << b.executions << "," << b.mispredicts << ","
+                << percent_correct(b.executions, b.mispredicts) << "\n";
+        }
+    }
+}
+
+} // namespace bp
@@ -0,0 +1,298 @@
+#include "experiment.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <iomanip>
+#include <mutex>
+#include <thread>
+
+namespace bp {
+
+const char* const kResultsCsvHeader =
+    "benchmark,scheme,total,correct,accuracy,hw_bits,"
+    "hrt_hits,hrt_misses,hrt_evictions,hrt_cold,"
+    "pt_used,pt_aliased,pt_pcs_per_entry";
+
+void write_csv_rows(std::ostream& out, const std::vector<ResultRow>& rows) {
+    std::ios::fmtflags flags = out.flags();
+    std::streamsize    prec  = out.precision();
+    out << std::fixed << std::setprecision(2);
+
+    for (const ResultRow& r : rows) {
+        out << r.benchmark << ","
+            << r.scheme << ","
+            << r.stats.total << ","
+            << r.stats.correct << ","
+            << (r.stats.accuracy() * 100.0) << ","
+            << r.hw_bits << ","
+            << r.hrt.hits << ","
+            << r.hrt.misses << ","
+            << r.hrt.evictions << ","
+            << r.hrt.cold << ","
+            << r.pt_alias.used << ","
+            << r.pt_alias.aliased << ","
+            << r.pt_alias.pcs_per_entry << "\n";
+    }
+
+    out.flags(flags);
+    out.precision(prec);
+}
+
+// ======================= SimSet =======================
+
+namespace {
+
+// The built-in defaults cannot fail to build.
+std::vector<std::unique_ptr<PredictorUnit>> default_units(std::size_t static_branches) {
+    std::vector<std::unique_ptr<PredictorUnit>> units;
+    std::string                                 error;
+    make_predictors(default_predictors(), static_branches, units, error);
+    return units;
+}
+
+} // namespace
+
+SimSet::SimSet(const std::vector<ATConfig>& configs, const EngineOptions& opts)
+    : SimSet(configs, opts, default_units(opts.static_branches)) {}
+
+SimSet::SimSet(const std::vector<ATConfig>& configs, const EngineOptions& opts,
+               std::vector<std::unique_ptr<PredictorUnit>> preds,
+               const std::vector<HybridConfig>& hybrid_configs)
+    : arenas(opts.arena_workers ? std::make_unique<ArenaSet>(opts.arena_workers) : nullptr),
+      sweep(make_at_sweep(configs, opts, arenas.get())),
+      predictors(std::move(preds)) {
+    if (hybrid_configs.empty()) return;
+
+    unsigned home = 0;
+    if (arenas) home = arenas->next();
+    ArenaScope scope(arenas ? &arenas->arena(home) : nullptr);
+
+    PredictorUnit* bimodal = nullptr;
+    for (auto& p : predictors) {
+        if (p->name == "Bimodal2Bit") bimodal = p.get();
+    }
+    hybrid_group = std::make_unique<HybridGroup>();
+    if (arenas && arenas->size() > 1) hybrid_group->home_worker = static_cast<int>(home);
+    for (const HybridConfig& h : hybrid_configs) {
+        std::size_t at = 0;
+        while (at < configs.size() && configs[at].name != h.at_scheme) ++at;
+        if (at == configs.size() || !bimodal) continue; // rejected by check_hybrids()
+
+        hybrid_group->add_driver(sweep.drivers[at]);
+        hybrid_group->add_driver(bimodal);
+        hybrids.push_back(std::make_unique<HybridSim>(
+            h, *sweep.configs[at], hybrid_group->log_for(sweep.configs[at].get()),
+            *bimodal, hybrid_group->log_for(bimodal)));
+        hybrid_group->add_hybrid(hybrids.back().get());
+    }
+}
+
+std::vector<SimUnit*> SimSet::units() {
+    std::vector<SimUnit*> units = sweep.units;
+    for (auto& p : predictors) units.push_back(p.get());
+    if (!hybrid_group) return units;
+
+    const std::vector<SimUnit*>& taken = hybrid_group->drivers();
+    units.erase(std::remove_if(units.begin(), units.end(), [&](SimUnit* u) {
+                    return std::find(taken.begin(), taken.end(), u) != taken.end();
+                }),
+                units.end());
+    units.push_back(hybrid_group.get());
+    return units;
+}
+
+std::vector<Stats*> SimSet::reported_stats() {
+    std::vector<Stats*> stats;
+    for (auto& sim : sweep.configs) stats.push_back(&sim->stats);
+    for (auto& p : predictors) stats.push_back(&p->stats);
+    for (auto& h : hybrids) stats.push_back(&h->stats);
+    return stats;
+}
+
+std::vector<ATUnit*> SimSet::at_units() {
+    std::vector<ATUnit*> units;
+    for (auto& sim : sweep.configs) units.push_back(sim.get());
+    return units;
+}
+
+void SimSet::reset_stats() {
+    for (Stats* s : reported_stats()) *s = Stats{};
+    for (ATUnit* u : at_units()) u->set_hrt_counters(HRTCounters{});
+}
+
+void SimSet::append_rows(const std::string& benchmark, std::vector<ResultRow>& rows) const {
+    for (const auto& sim : sweep.configs) {
+        rows.push_back({benchmark, sim->cfg.name, sim->stats, sim->hardware_cost_bits(),
+                        sim->hrt_counters(), sim->pt_alias()});
+    }
+    // No HRT/PT columns; hw_bits as the predictor models it (0 if not).
+    for (const auto& p : predictors) {
+        rows.push_back({benchmark, p->name, p->stats, p->hardware_cost_bits(), {}, {}});
+    }
+    for (const auto& h : hybrids) {
+        rows.push_back({benchmark, h->name, h->stats, h->hardware_cost_bits(), {}, {}});
+    }
+}
+
+std::vector<std::string> SimSet::scheme_names() const {
+    std::vector<std::string> names;
+    for (const auto& sim : sweep.configs) names.push_back(sim->cfg.name);
+    for (const auto& p : predictors) names.push_back(p->name);
+    for (const auto& h : hybrids) names.push_back(h->name);
+    return names;
+}
+
+void SimSet::enable_collectors(std::uint64_t interval, std::size_t expected_branches) {
+    std::vector<SimUnit*> reported;
+    for (auto& sim : sweep.configs) reported.push_back(sim.get());
+    for (auto& p : predictors) reported.push_back(p.get());
+    for (auto& h : hybrids) reported.push_back(h.get());
+
+    collectors.clear();
+    for (SimUnit* u : reported) {
+        collectors.push_back(std::make_unique<BranchStatsCollector>(interval, expected_branches));
+        u->collector = collectors.back().get();
+    }
+}
+
+bool check_hybrids(const std::vector<HybridConfig>& hybrids,
+                   const std::vector<ATConfig>& configs,
+                   const std::vector<std::string>& predictor_specs, std::string& error) {
+    if (hybrids.empty()) return true;
+    if (std::find(predictor_specs.begin(), predictor_specs.end(), "Bimodal2Bit") ==
+        predictor_specs.end()) {
+        error = "hybrids need the Bimodal2Bit predictor (drop --no-baselines or add it)";
+        return false;
+    }
+    for (const HybridConfig& h : hybrids) {
+        bool found = false;
+        for (const ATConfig& c : configs) found = found || c.name == h.at_scheme;
+        if (!found) {
+            error = "hybrid '" + h.name + "': no configuration named '" + h.at_scheme + "'";
+            return false;
+        }
+    }
+    return true;
+}
+
+// ======================= Multi-trace runs =======================
+
+TraceSpec parse_trace_spec(const std::string& arg) {
+    TraceSpec spec;
+    std::size_t eq = arg.find('=');
+    if (eq != std::string::npos) {
+        spec.label = arg.substr(0, eq);
+        spec.path  = arg.substr(eq + 1);
+        return spec;
+    }
+
+    spec.path = arg;
+    std::size_t slash = arg.find_last_of('/');
+    spec.label = (slash == std::string::npos) ? arg : arg.substr(slash + 1);
+    std::size_t dot = spec.label.find_last_of('.');
+    if (dot != std::string::npos && dot != 0) spec.label.resize(dot);
+    return spec;
+}
+
+namespace {
+
+struct WorkItem {
+    const LoadedTrace* trace;
+    SimUnit*           unit;
+    std::uint64_t      cost;
+};
+
+void run_item(const WorkItem& item, BlockBuffer& storage) {
+    std::unique_ptr<TraceSource> source = item.trace->source();
+    TraceBlock block;
+    while (source->next_block(storage, block)) item.unit->run_block(block);
+}
+
+/**
+ * One deque per worker. The owner takes from the front (largest items
+ * first); thieves take from the back (smallest), so stealing moves little
+ * work at a time while the big items stay with their owner.
+ */
+class WorkQueues {
+public:
+    explicit WorkQueues(unsigned workers) : queues_(workers) {}
+
+    void push(unsigned w, const WorkItem& item) { queues_[w].items.push_back(item); }
+
+    bool pop(unsigned w, WorkItem& item) {
+        if (take(queues_[w], item, true)) return true;
+        for (unsigned i = 1; i < queues_.size(); ++i) {
+            if (take(queues_[(w + i) % queues_.size()], item, false)) return true;
+        }
+        return false;
+    }
+
+private:
+    struct Queue {
+        std::mutex           mutex;
+        std::deque<WorkItem> items;
+    };
+
+    std::vector<Queue> queues_;
+
+    static bool take(Queue& q, WorkItem& item, bool front) {
+        std::lock_guard<std::mutex> lock(q.mutex);
+        if (q.items.empty()) return false;
+        if (front) {
+            item = q.items.front();
+            q.items.pop_front();
+        } else {
+            item = q.items.back();
+            q.items.pop_back();
+        }
+        return true;
+    }
+};
+
+} // namespace
+
+void run_trace_jobs(std::vector<TraceJob>& jobs, unsigned threads) {
+    std::vector<WorkItem> items;
+    for (TraceJob& job : jobs) {
+        for (SimUnit* u : job.sims->units()) {
+            items.push_back({job.trace.get(), u, job.trace->size()});
+        }
+    }
+
+    const unsigned workers =
+        static_cast<unsigned>(std::min<std::size_t>(std::max(threads, 1u), items.size()));
+    if (workers <= 1) {
+        BlockBuffer storage;
+        for (const WorkItem& item : items) run_item(item, storage);
+        return;
+    }
+
+    // Longest-processing-time-first: deal the largest items first, each to
+    // the worker with the least work so far.
+    std::stable_sort(items.begin(), items.end(),
+                     [](const WorkItem& a, const WorkItem& b) { return a.cost > b.cost; });
+    WorkQueues                 queues(workers);
+    std::vector<std::uint64_t> load(workers, 0);
+    for (const WorkItem& item : items) {
+        unsigned w = static_cast<unsigned>(
+            std::min_element(load.begin(), load.end()) - load.begin());
+        queues.push(w, item);
+        load[w] += item.cost;
+    }
+
+    // No items are added once the workers start, so a worker that finds
+    // every queue empty is done.
+    std::vector<std::thread> pool;
+    pool.reserve(workers);
+    for (unsigned w = 0; w < workers; ++w) {
+        pool.emplace_back([&queues, w] {
+            BlockBuffer storage;
+            WorkItem    item;
+            while (queues.pop(w, item)) run_item(item, storage);
+        });
+    }
+    for (auto& t : pool) t.join();
+}
+
+} // namespace bp
@@ -0,0 +1,126 @@
+#include "hybrid.hpp"
+
+#include <algorithm>
+
+namespace bp {
+
+// ======================= HybridSim =======================
+
+HybridSim::HybridSim(const HybridConfig& c, const ATUnit& at, const HitLog& at_log,
+                     const PredictorUnit& bimodal, const HitLog& bimodal_log)
+    : PredictorUnit(c.name),
+      cfg(c),
+      at_(at),
+      at_log_(at_log),
+      bimodal_(bimodal),
+      bimodal_log_(bimodal_log),
+      mask_((std::uint64_t{1} << c.meta_bits) - 1u),
+      table_(std::size_t{1} << c.meta_bits) {}
+
+/**
+ * A component's prediction is its hit bit compared with the outcome. The
+ * chooser moves toward the component that was right whenever the two
+ * disagree; biased entries (with the filter) neither consult nor train it.
+ */
+template <bool Filter, class Collector>
+void HybridSim::run(const TraceBlock& block, Collector& collector) {
+    const std::uint8_t* at_hit  = at_log_.hits.data();
+    const std::uint8_t* bim_hit = bimodal_log_.hits.data();
+    std::uint64_t correct = 0;
+    for (std::size_t i = 0; i < block.n; ++i) {
+        const bool taken  = (block.outs[i] == Outcome::Taken);
+        const bool at_p   = at_hit[i] ? taken : !taken;
+        const bool bim_p  = bim_hit[i] ? taken : !taken;
+        Entry&     e      = table_[static_cast<std::size_t>((block.pcs[i] >> 2) & mask_)];
+        const bool biased = Filter && e.run >= kBiasRun;
+
+        const bool pred = biased ? (e.dir != 0) : (e.meta >= 2 ? at_p : bim_p);
+        const bool hit  = (pred == taken);
+        correct += hit ? 1u : 0u;
+        collector.record(block.pcs[i], hit);
+
+        if (!biased && at_p != bim_p) {
+            if (at_p == taken) e.meta = static_cast<std::uint8_t>(std::min(e.meta + 1, 3));
+            else               e.meta = static_cast<std::uint8_t>(std::max(e.meta - 1, 0));
+        }
+        if constexpr (Filter) {
+            if ((e.dir != 0) == taken) {
+                e.run = static_cast<std::uint8_t>(std::min(e.run + 1, kBiasRun));
+            } else {
+                e.dir = taken ? 1u : 0u;
+                e.run = 1;
+            }
+        }
+    }
+    stats.total   += block.n;
+    stats.correct += correct;
+}
+
+void HybridSim::run_block(const TraceBlock& block) {
+    // The hybrid's own collector; hybrids are no components of others.
+    with_collector(collector, nullptr, block.n, [&](auto& c) {
+        if (cfg.bias_filter) run<true>(block, c);
+        else                 run<false>(block, c);
+    });
+}
+
+std::size_t HybridSim::hardware_cost_bits() const {
+    const std::size_t entry_bits = cfg.bias_filter ? 2u + 1u + 3u : 2u;
+    return at_.hardware_cost_bits() + bimodal_.hardware_cost_bits() + table_.size() * entry_bits;
+}
+
+void HybridSim::save(SnapshotWriter& out) const {
+    out.write_string(cfg.name);
+    out.write(stats);
+    out.write_array(table_);
+}
+
+void HybridSim::load(SnapshotReader& in) {
+    in.expect_string(cfg.name, "unit");
+    in.read(stats);
+    const std::size_t size = table_.size();
+    in.read_array(table_);
+    if (in.ok() && table_.size() != size) in.fail("hybrid chooser size mismatch");
+}
+
+// ======================= HybridGroup =======================
+
+void HybridGroup::add_driver(SimUnit* driver) {
+    if (std::find(drivers_.begin(), drivers_.end(), driver) == drivers_.end()) {
+        drivers_.push_back(driver);
+    }
+}
+
+const HitLog& HybridGroup::log_for(SimUnit* component) {
+    for (std::size_t i = 0; i < logged_.size(); ++i) {
+        if (logged_[i] == component) return *logs_[i];
+    }
+    logged_.push_back(component);
+    logs_.push_back(std::make_unique<HitLog>());
+    component->hit_log = logs_.back().get();
+    return *logs_.back();
+}
+
+void HybridGroup::run_block(const TraceBlock& block) {
+    for (SimUnit* d : drivers_) d->run_block(block);
+    for (HybridSim* h : hybrids_) h->run_block(block);
+}
+
+void HybridGroup::save(SnapshotWriter& out) const {
+    out.write<std::uint64_t>(drivers_.size() + hybrids_.size());
+    for (const SimUnit* d : drivers_) d->save(out);
+    for (const HybridSim* h : hybrids_) h->save(out);
+}
+
+void HybridGroup::load(SnapshotReader& in) {
+    std::uint64_t count = 0;
+    in.read(count);
+    if (in.ok() && count != drivers_.size() + hybrids_.size()) {
+        in.fail("hybrid group size mismatch");
+        return;
+    }
+    for (SimUnit* d : drivers_) d->load(in);
+    for (HybridSim* h : hybrids_) h->load(in);
+}
+
+} // namespace bp
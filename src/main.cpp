@@ -36,155 +36,789 @@
  *       0x401000 1
  *       0x401004 0
  *
+ *   The 0x prefix is optional and blank lines are ignored. A line that does
+ *   not match this format aborts the run with its line number.
+ *
+ * Binary traces:
+ *   Large traces can be converted once with bp_trace_convert into the
+ *   memory-mapped format described in include/trace.hpp. bp_sim detects the
+ *   format from the file's magic number and iterates the mapping directly,
+ *   skipping text parsing entirely.
+ *
+ * Streams:
+ *   A trace may also be "-" (standard input) or a FIFO, and may be gzip, xz
+ *   or zstd compressed (byte_stream.hpp). Streamed text is decoded on a
+ *   read-ahead thread, overlapping decompression with the simulation.
+ *
  * Command line:
  *   ./bp_sim trace.txt benchmark_name
+ *   ./bp_sim trace.bptrace benchmark_name
+ *   ./bp_sim --threads 8 trace.bptrace benchmark_name
+ *
+ * --threads N runs the configurations on N worker threads (0 = one per
+ * hardware thread). The trace is decoded once and shared; results are
+ * identical to the single-threaded run.
+ *
+ * --dynamic uses the runtime-configured TwoLevelATPredictor for every
+ * configuration instead of the compile-time specialized engines.
+ *
+ * --packed-pt stores every pattern table bit-packed (1 bit per Last-Time
+ * entry, 2 bits per A2/A3/A4 entry). Results are unchanged.
+ *
+ * --fsm SPEC defines an automaton from its transition tables for use in
+ * fsm= of a sweep, e.g. a 3-bit saturating counter:
+ *     --fsm "name=S3 taken=1,2,3,4,5,6,7,7 not=0,0,1,2,3,4,5,6 predict=4..7"
+ *     --sweep "hrt=AHRT:512 k=12 fsm=A2,S3"
+ *
+ * Predictor tables are allocated in one arena per worker thread
+ * (include/arena.hpp): huge-page backed, placed on the worker's NUMA node
+ * on multi-socket hosts, and freed at once. --no-arenas uses the heap.
+ * Results are unchanged.
+ *
+ * Configurations that differ only in automaton or history length share one
+ * HRT, which computes each branch's history once for all of them;
+ * --no-share-hrt simulates every configuration independently. Results are
+ * unchanged.
+ *
+ * --sweep SPEC and --sweep-file FILE replace the built-in configurations
+ * with a grid such as
+ *     hrt=AHRT:256..4096:x2 ways=1,2,4,8 k=4..16 fsm=LT,A2
+ * (syntax in include/sweep_spec.hpp). Both may be repeated; the word
+ * "default" in a spec adds the built-in list.
+ *
+ * Besides the AT configurations every run reports the predictors of the
+ * registry (include/predictor_registry.hpp), by default the AlwaysTaken and
+ * Bimodal2Bit baselines. --predictor NAME[:PARAMS] adds one (repeatable),
+ * --no-baselines drops the defaults, --plugin LIB.so loads more predictors
+ * from a shared object (see plugins/), and --list-predictors lists them.
+ *
+ * --hybrid SPEC adds tournament predictors over an AT configuration of the
+ * sweep and Bimodal2Bit, with a PC-indexed chooser and an optional
+ * static-when-biased filter (include/hybrid.hpp), e.g.
+ *     --hybrid "at=AT_AHRT_512_12_A2 meta=10,12 filter=off,on"
+ * The hybrids read their components' predictions, so the components are
+ * still simulated once.
+ *
+ * Several traces can be simulated in one invocation:
+ *     ./bp_sim --threads 0 --csv analysis/results.csv \
+ *         --trace gcc=traces/gcc_synth.txt --trace li=traces/li_synth.txt
+ * Every (trace, configuration) pair is scheduled on a work-stealing pool,
+ * and a single CSV with all rows is written to --csv FILE (or stdout).
+ *
+ * --results PATH writes the rows as a binary columnar results file instead
+ * of the stdout CSV (include/results_file.hpp, read by analysis/bpres.py).
+ * If PATH is a directory, every run adds its own file to it, so parallel
+ * runs can share one results directory.
+ *
+ * --cache DIR keeps every result row keyed by the trace's content hash and
+ * the canonical configuration (include/results_cache.hpp). A later run
+ * simulates only the (trace, scheme) pairs not yet in DIR and merges the
+ * rest from it, so adding one configuration to a sweep costs one
+ * configuration's simulation.
+ *
+ * Long traces can be split into segments with --range START[:COUNT].
+ * --save-snapshot FILE dumps the full predictor state (all HRTs, PTs and
+ * baseline tables, plus stats) at the end of a run, and --load-snapshot FILE
+ * restores it before the next one, so segments can start warm and
+ * warm-up regions need only be simulated once:
+ *     ./bp_sim --range 0:1000000 --save-snapshot warm.bpsnap t.bptrace b
+ *     ./bp_sim --range 1000000 --load-snapshot warm.bpsnap --fresh-stats t.bptrace b
+ * A snapshot must be restored with the same configurations and options.
+ *
+ * --sample U:P[:W] simulates a sample of the trace: of every P intervals
+ * of U branches only the last is measured, preceded by W branches of
+ * warm-up that train the predictors without being counted; the rest is
+ * skipped (a seek on binary traces). Accuracies are then reported with a
+ * 95% confidence interval over the measured intervals.
+ *
+ * --collect PREFIX additionally records, for every scheme, a time series of
+ * accuracy and mispredictions per 1000 branches over intervals of
+ * --collect-interval N branches (PREFIX.intervals.csv), and the --top N
+ * static branches with the most mispredictions (PREFIX.branches.csv).
+ * Without --collect the simulation loops carry no collection code at all.
  *
  * The benchmark_name is only used as a label in the CSV output so that
  * you can aggregate results across multiple traces.
  */
 
+#include <algorithm>
+#include <cerrno>
 #include <cstdint>
+#include <cstdlib>
+#include <limits>
 #include <fstream>
 #include <iomanip>
 #include <iostream>
+#include <memory>
+#include <sstream>
 #include <string>
+#include <thread>
 #include <vector>
 
+#include "at_registry.hpp"
+#include "experiment.hpp"
 #include "two_level_at.hpp"
-#include "predictors.hpp"
+#include "predictor_registry.hpp"
+#include "results_cache.hpp"
+#include "results_file.hpp"
 #include "stats.hpp"
+#include "sweep.hpp"
+#include "sweep_spec.hpp"
+#include "trace.hpp"
 
 using namespace bp;
 
+namespace {
+
+// A decimal count (digits only, so no sign); false if s is not one or
+// does not fit max.
+bool parse_count(const std::string& s, std::uint64_t& v,
+                 std::uint64_t max = std::numeric_limits<std::uint64_t>::max()) {
+    if (s.empty() || s.find_first_not_of("0123456789") != std::string::npos) return false;
+    errno = 0;
+    v = std::strtoull(s.c_str(), nullptr, 10);
+    return errno != ERANGE && v <= max;
+}
+
+// job_of entry of a trace taken entirely from the cache.
+constexpr std::size_t kNoJob = static_cast<std::size_t>(-1);
+
+// Write the header and rows to path; reports failures on stderr.
+bool write_csv_file(const std::string& path, const std::vector<ResultRow>& rows) {
+    std::ofstream out(path);
+    out << kResultsCsvHeader << "\n";
+    write_csv_rows(out, rows);
+    out.flush();
+    if (!out) {
+        std::cerr << "Error: could not write '" << path << "'\n";
+        return false;
+    }
+    return true;
+}
+
+// Write rows to a results file or directory; reports failures on stderr.
+bool write_results(const std::string& path, const std::vector<ResultRow>& rows) {
+    std::string written;
+    std::string err;
+    if (!write_results_file(path, rows, written, err)) {
+        std::cerr << "Error: " << err << "\n";
+        return false;
+    }
+    std::cout << "Wrote " << rows.size() << " rows to " << written << "\n";
+    return true;
+}
+
+// " ± x (95% CI, n samples)" for sampled stats, else nothing.
+std::string ci_suffix(const Stats& s) {
+    if (s.samples == 0) return "";
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(2)
+        << " +/- " << (s.ci95() * 100.0) << " (95% CI, " << s.samples << " samples)";
+    return out.str();
+}
+
+// Load the cache of trace at path; reports failures on stderr.
+std::unique_ptr<ResultsCache> open_results_cache(const std::string& dir, const std::string& path) {
+    std::string hash;
+    std::string err;
+    if (!trace_content_hash(path, hash, err)) {
+        std::cerr << "Error: " << err << "\n";
+        return nullptr;
+    }
+    auto cache = std::make_unique<ResultsCache>(dir, hash);
+    if (!cache->load(err)) {
+        std::cerr << "Error: " << err << "\n";
+        return nullptr;
+    }
+    return cache;
+}
+
+// Write the rows added to the caches; reports failures on stderr.
+bool save_results_caches(const std::vector<std::unique_ptr<ResultsCache>>& caches,
+                         std::size_t reused, std::size_t rows) {
+    for (const auto& cache : caches) {
+        std::string err;
+        if (!cache->save(err)) {
+            std::cerr << "Error: " << err << "\n";
+            return false;
+        }
+    }
+    std::cout << "Results cache: reused " << reused << " of " << rows << " rows\n";
+    return true;
+}
+
+// Human-readable summary of rows: n_configs AT schemes, then n_predictors
+// registry predictors, then the hybrids.
+void print_summary(const std::vector<ResultRow>& rows, std::size_t n_configs,
+                   std::size_t n_predictors) {
+    std::cout << "=== Two-Level Adaptive Training (AT) Schemes ===\n\n";
+    std::cout << std::fixed << std::setprecision(2);
+
+    for (std::size_t i = 0; i < rows.size(); ++i) {
+        const ResultRow& r = rows[i];
+        if (i == n_configs) std::cout << "=== Baseline Predictors ===\n\n";
+        if (i == n_configs + n_predictors) std::cout << "=== Hybrid Predictors ===\n\n";
+        std::cout << r.scheme << "\n";
+        std::cout << "  Total branches:   " << r.stats.total   << "\n";
+        std::cout << "  Correct predicts: " << r.stats.correct << "\n";
+        std::cout << "  Accuracy:         " << (r.stats.accuracy() * 100.0) << " %"
+                  << ci_suffix(r.stats) << "\n";
+        // Registry predictors report HW cost only if they model it.
+        const bool predictor = i >= n_configs && i < n_configs + n_predictors;
+        if (!predictor || r.hw_bits) {
+            std::cout << "  HW cost (approx): " << r.hw_bits << " bits\n";
+        }
+        std::cout << "\n";
+    }
+    if (rows.size() == n_configs) std::cout << "=== Baseline Predictors ===\n\n";
+}
+
+// PREFIX.intervals.csv and PREFIX.branches.csv (see collector.hpp).
+bool write_collector_files(const std::string& prefix, SimSet& sims, std::size_t top_n) {
+    std::vector<const BranchStatsCollector*> collectors;
+    for (auto& c : sims.collectors) {
+        c->finish();
+        collectors.push_back(c.get());
+    }
+    const std::vector<std::string> schemes = sims.scheme_names();
+
+    const std::string intervals_path = prefix + ".intervals.csv";
+    std::ofstream intervals(intervals_path);
+    write_interval_csv(intervals, schemes, collectors);
+    intervals.flush();
+    if (!intervals) {
+        std::cerr << "Error: could not write '" << intervals_path << "'\n";
+        return false;
+    }
+
+    const std::string branches_path = prefix + ".branches.csv";
+    std::ofstream branches(branches_path);
+    write_top_branches_csv(branches, schemes, collectors, top_n);
+    branches.flush();
+    if (!branches) {
+        std::cerr << "Error: could not write '" << branches_path << "'\n";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
 int main(int argc, char** argv) {
     // ------------------------------------------------------------
     //  Argument parsing & trace file opening (Section 4: Methodology)
     // ------------------------------------------------------------
-    if (argc < 2) {
-        std::cerr << "Usage: " << argv[0] << " trace.txt [benchmark_name]\n";
-        std::cerr << "Each trace line: <pc_hex> <taken_bit_0_or_1>\n";
-        return 1;
+    std::vector<std::string> positional;
+    unsigned threads = 1;
+    bool dynamic_only = false;
+    bool packed_pt    = false;
+    bool share_hrt    = true;
+    bool use_arenas   = true;
+    struct SweepArg {
+        bool        from_file;
+        std::string text;
+    };
+    std::vector<SweepArg> sweep_specs;
+    std::vector<std::string> fsm_specs;
+    std::vector<TraceSpec> trace_specs;
+    std::string csv_path;
+    std::string results_path;
+    std::string cache_dir;
+    std::uint64_t range_start = 0;
+    std::uint64_t range_count = 0;
+    bool has_range_count = false;
+    std::string save_snapshot_path;
+    std::string load_snapshot_path;
+    bool fresh_stats = false;
+    bool sampled = false;
+    SamplingPlan sampling;
+    std::string collect_prefix;
+    std::uint64_t collect_interval = 10000;
+    std::size_t top_n = 10;
+    std::vector<std::string> plugin_paths;
+    std::vector<std::string> extra_predictors;
+    std::vector<std::string> hybrid_specs;
+    bool baselines = true;
+    bool list_predictors = false;
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg = argv[i];
+        if ((arg == "--threads" || arg == "-j") && i + 1 < argc) {
+            std::uint64_t n;
+            if (!parse_count(argv[++i], n, std::numeric_limits<unsigned>::max())) {
+                std::cerr << "Error: " << arg << " expects a thread count, got '" << argv[i] << "'\n";
+                return 1;
+            }
+            threads = static_cast<unsigned>(n);
+            if (threads == 0) threads = std::max(1u, std::thread::hardware_concurrency());
+        } else if (arg == "--dynamic") {
+            dynamic_only = true;
+        } else if (arg == "--packed-pt") {
+            packed_pt = true;
+        } else if (arg == "--no-share-hrt") {
+            share_hrt = false;
+        } else if (arg == "--no-arenas") {
+            use_arenas = false;
+        } else if (arg == "--sweep" && i + 1 < argc) {
+            sweep_specs.push_back({false, argv[++i]});
+        } else if (arg == "--sweep-file" && i + 1 < argc) {
+            sweep_specs.push_back({true, argv[++i]});
+        } else if (arg == "--fsm" && i + 1 < argc) {
+            fsm_specs.push_back(argv[++i]);
+        } else if (arg == "--trace" && i + 1 < argc) {
+            trace_specs.push_back(parse_trace_spec(argv[++i]));
+        } else if (arg == "--csv" && i + 1 < argc) {
+            csv_path = argv[++i];
+        } else if (arg == "--results" && i + 1 < argc) {
+            results_path = argv[++i];
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cache_dir = argv[++i];
+        } else if (arg == "--range" && i + 1 < argc) {
+            // START:COUNT, START: (to the end) or START
+            const std::string r = argv[++i];
+            const std::size_t colon = r.find(':');
+            has_range_count = colon != std::string::npos && colon + 1 < r.size();
+            if (!parse_count(r.substr(0, colon), range_start) ||
+                (has_range_count && !parse_count(r.substr(colon + 1), range_count))) {
+                std::cerr << "Error: --range expects START[:COUNT], got '" << r << "'\n";
+                return 1;
+            }
+        } else if (arg == "--save-snapshot" && i + 1 < argc) {
+            save_snapshot_path = argv[++i];
+        } else if (arg == "--load-snapshot" && i + 1 < argc) {
+            load_snapshot_path = argv[++i];
+        } else if (arg == "--fresh-stats") {
+            fresh_stats = true;
+        } else if (arg == "--sample" && i + 1 < argc) {
+            // INTERVAL:PERIOD[:WARMUP]
+            const std::string v = argv[++i];
+            const std::size_t c1 = v.find(':');
+            const std::size_t c2 = (c1 == std::string::npos) ? c1 : v.find(':', c1 + 1);
+            sampling.warmup = 0;
+            if (c1 == std::string::npos ||
+                !parse_count(v.substr(0, c1), sampling.interval) ||
+                !parse_count(v.substr(c1 + 1, c2 - c1 - 1), sampling.period) ||
+                (c2 != std::string::npos && !parse_count(v.substr(c2 + 1), sampling.warmup))) {
+                std::cerr << "Error: --sample expects INTERVAL:PERIOD[:WARMUP], got '" << v << "'\n";
+                return 1;
+            }
+            if (sampling.interval == 0 || sampling.period == 0) {
+                std::cerr << "Error: --sample INTERVAL and PERIOD must be positive\n";
+                return 1;
+            }
+            sampled = true;
+        } else if (arg == "--collect" && i + 1 < argc) {
+            collect_prefix = argv[++i];
+        } else if (arg == "--collect-interval" && i + 1 < argc) {
+            if (!parse_count(argv[++i], collect_interval) || collect_interval == 0) {
+                std::cerr << "Error: --collect-interval must be a positive count, got '"
+                          << argv[i] << "'\n";
+                return 1;
+            }
+        } else if (arg == "--top" && i + 1 < argc) {
+            std::uint64_t n;
+            if (!parse_count(argv[++i], n, std::numeric_limits<std::size_t>::max())) {
+                std::cerr << "Error: --top expects a count, got '" << argv[i] << "'\n";
+                return 1;
+            }
+            top_n = static_cast<std::size_t>(n);
+        } else if (arg == "--plugin" && i + 1 < argc) {
+            plugin_paths.push_back(argv[++i]);
+        } else if (arg == "--predictor" && i + 1 < argc) {
+            extra_predictors.push_back(argv[++i]);
+        } else if (arg == "--hybrid" && i + 1 < argc) {
+            hybrid_specs.push_back(argv[++i]);
+        } else if (arg == "--no-baselines") {
+            baselines = false;
+        } else if (arg == "--list-predictors") {
+            list_predictors = true;
+        } else {
+            positional.push_back(arg);
+        }
     }
 
-    const std::string trace_file = argv[1];
-    const std::string benchmark  = (argc >= 3) ? argv[2] : "unknown";
+    // Plugins first, so their predictors can be listed and selected.
+    for (const std::string& path : plugin_paths) {
+        std::string err;
+        if (!load_predictor_plugin(path, err)) {
+            std::cerr << "Error: " << err << "\n";
+            return 1;
+        }
+    }
+    if (list_predictors) {
+        for (const auto& e : PredictorRegistry::instance().entries()) {
+            std::cout << std::left << std::setw(16) << e.name << " " << e.description << "\n";
+        }
+        return 0;
+    }
 
-    std::ifstream in(trace_file);
-    if (!in) {
-        std::cerr << "Error: could not open trace file '" << trace_file << "'\n";
+    if (positional.empty() == trace_specs.empty()) {
+        std::cerr << "Usage: " << argv[0]
+                  << " [--threads N] [--dynamic] [--packed-pt] [--no-share-hrt] [--sweep SPEC | --sweep-file FILE]..."
+                  << " [--csv FILE] trace.txt|trace.bptrace|- [benchmark_name]\n";
+        std::cerr << "       " << argv[0]
+                  << " [options] --trace [LABEL=]TRACE --trace [LABEL=]TRACE ...\n";
+        std::cerr << "Each trace line: <pc_hex> <taken_bit_0_or_1>\n";
+        std::cerr << "Binary traces: see bp_trace_convert; '-' reads stdin; gzip/xz/zstd input is detected\n";
+        std::cerr << "--threads N: simulate configurations on N worker threads (0 = all cores)\n";
+        std::cerr << "--dynamic:   disable the compile-time specialized AT engines\n";
+        std::cerr << "--packed-pt: store pattern tables at 1-4 bits per entry\n";
+        std::cerr << "--no-share-hrt: give every configuration its own HRT\n";
+        std::cerr << "--no-arenas: allocate predictor tables on the heap instead of per-worker arenas\n";
+        std::cerr << "--sweep SPEC: simulate a config grid, e.g."
+                  << " \"hrt=AHRT:256..4096:x2 ways=1,2,4,8 k=4..16 fsm=LT,A2\"\n";
+        std::cerr << "--sweep-file FILE: one SPEC per line ('#' comments)\n";
+        std::cerr << "--fsm SPEC: define an automaton for fsm=, e.g."
+                  << " \"name=S3 taken=1,2,3,4,5,6,7,7 not=0,0,1,2,3,4,5,6 predict=4..7\"\n";
+        std::cerr << "--trace [LABEL=]TRACE: add a trace to a multi-trace run (label defaults to the file name)\n";
+        std::cerr << "--csv FILE: also write the results CSV to FILE\n";
+        std::cerr << "--results PATH: write a binary results file (a new one per run if PATH is a directory)"
+                  << " instead of the stdout CSV\n";
+        std::cerr << "--cache DIR: reuse results already in DIR for the same trace and configuration\n";
+        std::cerr << "--range START[:COUNT]: simulate only records START .. START+COUNT-1\n";
+        std::cerr << "--load-snapshot FILE: start from predictor state saved by --save-snapshot\n";
+        std::cerr << "--save-snapshot FILE: save predictor state at the end of the run\n";
+        std::cerr << "--fresh-stats: zero the statistics restored by --load-snapshot\n";
+        std::cerr << "--sample U:P[:W]: measure one U-branch interval in every P, after W branches of warm-up\n";
+        std::cerr << "--collect PREFIX: write per-interval and per-branch statistics to PREFIX.*.csv\n";
+        std::cerr << "--collect-interval N: branches per --collect interval (default 10000)\n";
+        std::cerr << "--top N: branches listed in PREFIX.branches.csv per scheme (default 10)\n";
+        std::cerr << "--predictor NAME[:PARAMS]: also simulate a registry predictor (repeatable)\n";
+        std::cerr << "--no-baselines: drop the default AlwaysTaken / Bimodal2Bit predictors\n";
+        std::cerr << "--hybrid SPEC: tournament of an AT config and Bimodal2Bit, e.g."
+                  << " \"at=AT_AHRT_512_12_A2 meta=12 filter=off,on\"\n";
+        std::cerr << "--plugin LIB.so: load predictors from a shared object\n";
+        std::cerr << "--list-predictors: list the available predictors and exit\n";
+        return 1;
+    }
+    if (!trace_specs.empty() &&
+        (range_start != 0 || has_range_count || !save_snapshot_path.empty() ||
+         !load_snapshot_path.empty() || sampled)) {
+        std::cerr << "Error: --range, --sample and snapshots apply to single-trace runs only\n";
+        return 1;
+    }
+    if (!collect_prefix.empty() && (!trace_specs.empty() || sampled)) {
+        std::cerr << "Error: --collect applies to full single-trace runs only\n";
+        return 1;
+    }
+    if (!cache_dir.empty() &&
+        (range_start != 0 || has_range_count || !save_snapshot_path.empty() ||
+         !load_snapshot_path.empty() || sampled || !collect_prefix.empty())) {
+        std::cerr << "Error: --cache applies to full runs only (no --range, --sample,"
+                  << " snapshots or --collect)\n";
         return 1;
     }
 
     // ------------------------------------------------------------
     //  Define Two-Level AT configurations (like Table 2 and Figs. 5–7)
     // ------------------------------------------------------------
+    //
+    // Without --sweep/--sweep-file this is the built-in list in
+    // default_sweep() (sweep_spec.cpp); otherwise every spec is expanded in
+    // command-line order, dropping duplicate names.
+    for (const std::string& spec : fsm_specs) {
+        AutomatonType a;
+        std::string   err;
+        if (!parse_fsm_spec(spec, a, err)) {
+            std::cerr << "Error: fsm: " << err << "\n";
+            return 1;
+        }
+    }
     std::vector<ATConfig> configs;
+    if (sweep_specs.empty()) {
+        configs = default_sweep();
+    }
+    for (const auto& spec : sweep_specs) {
+        std::string err;
+        bool parsed = spec.from_file ? load_sweep_file(spec.text, configs, err)
+                                     : parse_sweep_spec(spec.text, configs, err);
+        if (!parsed) {
+            std::cerr << "Error: sweep: " << err << "\n";
+            return 1;
+        }
+    }
+    if (configs.empty()) {
+        std::cerr << "Error: sweep produced no configurations\n";
+        return 1;
+    }
+
+    if (packed_pt) {
+        for (auto& c : configs) c.pt_layout = PTLayout::Packed;
+    }
+
+    // Registry predictors reported after the configurations, dropping
+    // repeated specs (e.g. --predictor Bimodal2Bit with the baselines on);
+    // built once per trace, so bad names or params are caught before any
+    // trace is read.
+    std::vector<std::string> predictor_specs;
+    if (baselines) predictor_specs = default_predictors();
+    for (const std::string& spec : extra_predictors) {
+        if (std::find(predictor_specs.begin(), predictor_specs.end(), spec) == predictor_specs.end()) {
+            predictor_specs.push_back(spec);
+        }
+    }
+    {
+        std::vector<std::unique_ptr<PredictorUnit>> probe;
+        std::string err;
+        if (!make_predictors(predictor_specs, 0, probe, err)) {
+            std::cerr << "Error: " << err << "\n";
+            return 1;
+        }
+    }
+
+    // Hybrids over the configurations and Bimodal2Bit (hybrid.hpp).
+    std::vector<HybridConfig> hybrids;
+    for (const std::string& spec : hybrid_specs) {
+        std::string err;
+        if (!parse_hybrid_spec(spec, configs, hybrids, err)) {
+            std::cerr << "Error: hybrid: " << err << "\n";
+            return 1;
+        }
+    }
+    {
+        std::string err;
+        if (!check_hybrids(hybrids, configs, predictor_specs, err)) {
+            std::cerr << "Error: " << err << "\n";
+            return 1;
+        }
+    }
 
-    // === HRT implementation exploration (similar to Fig. 6) ===
+    // Each config is wrapped in an ATUnit (sweep.hpp) that holds:
+    //   - The config itself
+    //   - A Two-Level AT predictor
+    //   - Stats for that predictor
     //
-    // Vary HRT type and size while keeping:
-    //   - k   = 12 bits of history
-    //   - PT  = 2^12 entries
-    //   - FSM = A2
-    configs.push_back({"AT_AHRT_256_12_A2", HRTKind::AHRT, 256, 4, 12, AutomatonType::A2});
-    configs.push_back({"AT_AHRT_512_12_A2", HRTKind::AHRT, 512, 4, 12, AutomatonType::A2});
-    configs.push_back({"AT_HHRT_256_12_A2", HRTKind::HHRT, 256, 1, 12, AutomatonType::A2});
-    configs.push_back({"AT_HHRT_512_12_A2", HRTKind::HHRT, 512, 1, 12, AutomatonType::A2});
-    configs.push_back({"AT_IHRT_12_A2",     HRTKind::IHRT,   0, 0, 12, AutomatonType::A2});
-
-    // === Automaton exploration (similar to Fig. 5) ===
+    // Configurations with the same HRT (kind, entries, ways) share one HRT
+    // instance that computes the history once for all of them
+    // (shared_hrt.hpp); --no-share-hrt gives each its own. The others get a
+    // specialized engine if the registry's compile-time grid has one
+    // (at_registry.hpp); --dynamic forces the runtime predictor.
     //
-    // Keep HRT = AHRT(512, 12SR) constant and vary automaton:
-    configs.push_back({"AT_AHRT_512_12_LT", HRTKind::AHRT, 512, 4, 12, AutomatonType::LastTime});
-    configs.push_back({"AT_AHRT_512_12_A3", HRTKind::AHRT, 512, 4, 12, AutomatonType::A3});
-    configs.push_back({"AT_AHRT_512_12_A4", HRTKind::AHRT, 512, 4, 12, AutomatonType::A4});
+    // Binary traces record their static-branch count, which pre-sizes the
+    // per-branch tables (IHRT, bimodal); see SimSet (experiment.hpp).
+    EngineOptions engine;
+    engine.allow_specialized = !dynamic_only;
+    engine.share_hrt         = share_hrt;
 
-    // === History length exploration (similar to Fig. 7) ===
+    // With more threads than shared-HRT groups, large groups are split
+    // (make_at_sweep()). Snapshots record the units, so they are taken and
+    // restored unsplit, whatever --threads.
+    const bool snapshots = !save_snapshot_path.empty() || !load_snapshot_path.empty();
+    engine.workers       = snapshots ? 1u : threads;
+
+    // One arena per worker; run_parallel() never runs more workers than
+    // units (at most one per configuration and predictor, plus the hybrid
+    // group), so neither is there any use for more arenas.
+    const std::size_t max_units = configs.size() + predictor_specs.size() + 1;
+    engine.arena_workers = use_arenas ? static_cast<unsigned>(std::min<std::size_t>(threads, max_units)) : 0;
+
+    // ------------------------------------------------------------
+    //  Multi-trace runs: every trace x unit pair is a work item
+    // ------------------------------------------------------------
     //
-    // Fix HRT = AHRT(512) and automaton = A2, vary k:
-    configs.push_back({"AT_AHRT_512_10_A2", HRTKind::AHRT, 512, 4, 10, AutomatonType::A2});
-    configs.push_back({"AT_AHRT_512_8_A2",  HRTKind::AHRT, 512, 4,  8, AutomatonType::A2});
-    configs.push_back({"AT_AHRT_512_6_A2",  HRTKind::AHRT, 512, 4,  6, AutomatonType::A2});
+    // Traces are loaded once (text traces parsed into memory, binary traces
+    // mapped) and each gets its own SimSet. run_trace_jobs() then spreads
+    // the (trace, unit) items over a work-stealing pool, and all results go
+    // into one CSV: to --csv FILE if given, else to stdout unless they go
+    // to a --results file.
+    //
+    // With --cache, a trace's SimSet holds only the schemes missing from
+    // its cache, and a trace with none missing is not even loaded.
+    if (!trace_specs.empty()) {
+        std::vector<TraceJob> jobs;
+        std::vector<std::unique_ptr<ResultsCache>> caches;
+        std::vector<std::unique_ptr<CachedRun>>    cached_runs; // per trace spec
+        std::vector<std::size_t>                   job_of;      // per trace spec
+        for (const TraceSpec& spec : trace_specs) {
+            const std::vector<ATConfig>*     sim_configs    = &configs;
+            const std::vector<std::string>*  sim_predictors = &predictor_specs;
+            const std::vector<HybridConfig>* sim_hybrids    = &hybrids;
+            if (!cache_dir.empty()) {
+                auto cache = open_results_cache(cache_dir, spec.path);
+                if (!cache) return 1;
+                cached_runs.push_back(std::make_unique<CachedRun>(*cache, configs, predictor_specs, hybrids));
+                caches.push_back(std::move(cache));
+                const CachedRun& run = *cached_runs.back();
+                if (run.complete()) {
+                    job_of.push_back(kNoJob);
+                    continue;
+                }
+                sim_configs    = &run.configs();
+                sim_predictors = &run.predictors();
+                sim_hybrids    = &run.hybrids();
+            }
+            job_of.push_back(jobs.size());
+            auto trace = std::make_unique<LoadedTrace>(spec.path);
+            if (!trace->ok()) {
+                std::cerr << "Error: " << trace->error() << "\n";
+                return 1;
+            }
+            EngineOptions opts   = engine;
+            opts.static_branches = trace->static_branches();
+            // The threads are shared among the traces.
+            opts.workers = static_cast<unsigned>((threads + trace_specs.size() - 1) / trace_specs.size());
+            // Work stealing moves units between threads: one shared arena.
+            if (use_arenas) opts.arena_workers = 1;
+            std::vector<std::unique_ptr<PredictorUnit>> predictors;
+            std::string err;
+            if (!make_predictors(*sim_predictors, opts.static_branches, predictors, err)) {
+                std::cerr << "Error: " << err << "\n";
+                return 1;
+            }
+            auto sims = std::make_unique<SimSet>(*sim_configs, opts, std::move(predictors), *sim_hybrids);
+            jobs.push_back({spec.label, std::move(trace), std::move(sims)});
+        }
 
-    // Wrap each config in an object that holds:
-    //   - The config itself
-    //   - A TwoLevelATPredictor
-    //   - Stats for that predictor
-    struct ATSim {
-        ATConfig            cfg;
-        TwoLevelATPredictor pred;
-        Stats               stats;
+        run_trace_jobs(jobs, threads);
 
-        ATSim(const ATConfig& c) : cfg(c), pred(c), stats{} {}
-    };
+        std::vector<ResultRow> rows;
+        if (cache_dir.empty()) {
+            for (const TraceJob& job : jobs) job.sims->append_rows(job.label, rows);
+        } else {
+            std::size_t reused = 0;
+            for (std::size_t t = 0; t < trace_specs.size(); ++t) {
+                std::vector<ResultRow> simulated;
+                if (job_of[t] != kNoJob) jobs[job_of[t]].sims->append_rows(trace_specs[t].label, simulated);
+                cached_runs[t]->merge(trace_specs[t].label, simulated, rows);
+                reused += cached_runs[t]->cached();
+            }
+            if (!save_results_caches(caches, reused, rows.size())) return 1;
+        }
 
-    std::vector<ATSim> at_sims;
-    at_sims.reserve(configs.size());
-    for (const auto& c : configs) {
-        at_sims.emplace_back(c);
+        if (!results_path.empty() && !write_results(results_path, rows)) return 1;
+        if (!csv_path.empty()) {
+            if (!write_csv_file(csv_path, rows)) return 1;
+            std::cout << "Wrote " << rows.size() << " rows for " << jobs.size()
+                      << " traces to " << csv_path << "\n";
+        } else if (results_path.empty()) {
+            std::cout << "=== CSV (copy/paste into analysis/results.csv) ===\n";
+            std::cout << kResultsCsvHeader << "\n";
+            write_csv_rows(std::cout, rows);
+        }
+        return 0;
     }
 
     // ------------------------------------------------------------
-    //  Baseline predictors: Always-Taken & Bimodal 2-bit
+    //  Single trace
     // ------------------------------------------------------------
-    AlwaysTakenPredictor always;
-    Bimodal2BitPredictor bimodal;
-    Stats stats_always;
-    Stats stats_bimodal;
+    const std::string trace_file = positional[0];
+    const std::string benchmark  = (positional.size() >= 2) ? positional[1] : "unknown";
+
+    // Binary traces (see include/trace.hpp) are mmapped; anything else is
+    // parsed as text.
+    std::unique_ptr<TraceSource> source = open_trace_source(trace_file);
+    if (!source->ok()) {
+        std::cerr << "Error: " << source->error() << "\n";
+        return 1;
+    }
+
+    engine.static_branches = source->static_branches();
+
+    // --cache: simulate only the schemes whose rows for this trace are not
+    // cached yet; the rest are merged in after the run.
+    std::vector<std::unique_ptr<ResultsCache>> caches;
+    std::unique_ptr<CachedRun>                 cached_run;
+    if (!cache_dir.empty()) {
+        if (trace_file == "-") {
+            std::cerr << "Error: --cache needs a trace file, not stdin\n";
+            return 1;
+        }
+        caches.push_back(open_results_cache(cache_dir, trace_file));
+        if (!caches.back()) return 1;
+        cached_run = std::make_unique<CachedRun>(*caches.back(), configs, predictor_specs, hybrids);
+    }
+    const std::vector<ATConfig>&     sim_configs    = cached_run ? cached_run->configs() : configs;
+    const std::vector<std::string>&  sim_predictors = cached_run ? cached_run->predictors() : predictor_specs;
+    const std::vector<HybridConfig>& sim_hybrids    = cached_run ? cached_run->hybrids() : hybrids;
+
+    // --range: binary traces seek straight to START, text traces skip it.
+    source->skip(range_start);
+    if (has_range_count) source = limit_trace_source(std::move(source), range_count);
+
+    // The AT configurations plus the registry predictors (by default the
+    // Always-Taken & Bimodal 2-bit baselines).
+    std::vector<std::unique_ptr<PredictorUnit>> predictors;
+    {
+        std::string err;
+        if (!make_predictors(sim_predictors, engine.static_branches, predictors, err)) {
+            std::cerr << "Error: " << err << "\n";
+            return 1;
+        }
+    }
+    SimSet sims(sim_configs, engine, std::move(predictors), sim_hybrids);
+    std::vector<SimUnit*> units = sims.units();
+    if (!collect_prefix.empty()) sims.enable_collectors(collect_interval, engine.static_branches);
+
+    // Snapshots (snapshot.hpp) carry the complete predictor state and
+    // stats, so a run can resume where an earlier --save-snapshot stopped,
+    // or start a trace segment already warmed up (--fresh-stats then counts
+    // only the segment itself).
+    if (!load_snapshot_path.empty()) {
+        std::string err;
+        if (!load_snapshot(load_snapshot_path, units, err)) {
+            std::cerr << "Error: " << err << "\n";
+            return 1;
+        }
+        if (fresh_stats) sims.reset_stats();
+    }
 
     // ------------------------------------------------------------
     //  Main trace-driven simulation loop (Section 4)
     // ------------------------------------------------------------
     //
-    // For each dynamic branch:
-    //   1. Parse PC and taken/not-taken from trace.
+    // For each block of dynamic branches:
+    //   1. Parse PC and taken/not-taken from trace (or read them straight
+    //      from the mapped binary trace).
     //   2. For each AT scheme:
     //        - Predict
     //        - Compare to actual
     //        - Update PT and HRT
-    //   3. For each baseline:
+    //   3. For each registry predictor (baselines, plugins):
     //        - Same pattern (predict, compare, update)
     //
-    std::uint64_t pc;
-    int taken_int;
-
-    while (true) {
-        // Read PC in hexadecimal.
-        if (!(in >> std::hex >> pc)) break;
-        // Read outcome in decimal (0 or 1).
-        if (!(in >> std::dec >> taken_int)) break;
-
-        Outcome o = taken_int ? Outcome::Taken : Outcome::NotTaken;
+    // With --threads, the predictors are split across worker threads that
+    // share the decoded blocks; each predictor still sees every branch in
+    // trace order, so the results are identical to the serial run.
+    //
+    // With --sample, only the sampled intervals (and their warm-up) are
+    // simulated; the reported stats then cover the measured intervals only
+    // and carry a confidence interval.
+    bool ok = true;
+    if (units.empty()) {
+        // Everything came from the cache.
+    } else if (sampled) {
+        ok = run_sampled(*source, units, sims.reported_stats(), sims.at_units(), sampling,
+                         threads);
+    } else {
+        ok = (threads > 1) ? run_parallel(*source, units, threads)
+                           : run_serial(*source, units);
+    }
+    if (!ok) {
+        std::cerr << "Error: " << source->error() << "\n";
+        return 1;
+    }
 
-        // --- Two-Level AT variants ---
-        for (auto& sim : at_sims) {
-            bool p = sim.pred.predict(pc);
-            bool correct = (p && o == Outcome::Taken) ||
-                           (!p && o == Outcome::NotTaken);
-            if (correct) sim.stats.correct++;
-            sim.stats.total++;
-            sim.pred.update(pc, o);
-        }
+    if (sampled && sims.reported_stats().front()->samples == 0) {
+        std::cerr << "Warning: no interval was sampled (trace shorter than one period of "
+                  << sampling.interval * sampling.period << " branches)\n";
+    }
 
-        // --- Always-Taken baseline ---
-        {
-            bool p = always.predict(pc);
-            bool correct = (p && o == Outcome::Taken) ||
-                           (!p && o == Outcome::NotTaken);
-            if (correct) stats_always.correct++;
-            stats_always.total++;
-            always.update(pc, o);
+    if (!save_snapshot_path.empty()) {
+        std::string err;
+        if (!save_snapshot(save_snapshot_path, units, err)) {
+            std::cerr << "Error: " << err << "\n";
+            return 1;
         }
+    }
 
-        // --- Bimodal 2-bit per-branch baseline ---
-        {
-            bool p = bimodal.predict(pc);
-            bool correct = (p && o == Outcome::Taken) ||
-                           (!p && o == Outcome::NotTaken);
-            if (correct) stats_bimodal.correct++;
-            stats_bimodal.total++;
-            bimodal.update(pc, o);
-        }
+    // The result rows, with the cached ones merged in (--cache).
+    std::vector<ResultRow> rows;
+    if (cached_run) {
+        std::vector<ResultRow> simulated;
+        sims.append_rows(benchmark, simulated);
+        cached_run->merge(benchmark, simulated, rows);
+        if (!save_results_caches(caches, cached_run->cached(), rows.size())) return 1;
+    } else {
+        sims.append_rows(benchmark, rows);
     }
 
     // ------------------------------------------------------------
@@ -193,61 +827,27 @@ int main(int argc, char** argv) {
     std::cout << "Trace file: " << trace_file << "\n";
     std::cout << "Benchmark:  " << benchmark  << "\n\n";
 
-    std::cout << "=== Two-Level Adaptive Training (AT) Schemes ===\n\n";
-    std::cout << std::fixed << std::setprecision(2);
-
-    for (const auto& sim : at_sims) {
-        double acc = sim.stats.accuracy() * 100.0;
-        std::size_t hw = sim.pred.hardware_cost_bits();
-        std::cout << sim.cfg.name << "\n";
-        std::cout << "  Total branches:   " << sim.stats.total   << "\n";
-        std::cout << "  Correct predicts: " << sim.stats.correct << "\n";
-        std::cout << "  Accuracy:         " << acc << " %\n";
-        std::cout << "  HW cost (approx): " << hw  << " bits\n\n";
-    }
-
-    std::cout << "=== Baseline Predictors ===\n\n";
-    std::cout << "AlwaysTaken\n";
-    std::cout << "  Total branches:   " << stats_always.total   << "\n";
-    std::cout << "  Correct predicts: " << stats_always.correct << "\n";
-    std::cout << "  Accuracy:         " << (stats_always.accuracy() * 100.0) << " %\n\n";
-
-    std::cout << "Bimodal2Bit\n";
-    std::cout << "  Total branches:   " << stats_bimodal.total   << "\n";
-    std::cout << "  Correct predicts: " << stats_bimodal.correct << "\n";
-    std::cout << "  Accuracy:         " << (stats_bimodal.accuracy() * 100.0) << " %\n\n";
+    print_summary(rows, configs.size(), predictor_specs.size());
 
     // ------------------------------------------------------------
     //  CSV output for analysis/aggregate_results.py & plot_results.py
     // ------------------------------------------------------------
     //
     // This block is easy to parse and matches the layout expected by
-    // analysis/aggregate_results.py.
+    // analysis/aggregate_results.py. With --results the rows go to the
+    // results file instead.
     //
-    std::cout << "=== CSV (copy/paste into analysis/results.csv) ===\n";
-    std::cout << "benchmark,scheme,total,correct,accuracy,hw_bits\n";
-
-    for (const auto& sim : at_sims) {
-        double acc = sim.stats.accuracy() * 100.0;
-        std::size_t hw = sim.pred.hardware_cost_bits();
-        std::cout << benchmark << ","
-                  << sim.cfg.name << ","
-                  << sim.stats.total << ","
-                  << sim.stats.correct << ","
-                  << acc << ","
-                  << hw << "\n";
-    }
-
-    // Baseline rows: hw_bits = 0 (we treat them as "no AT hardware").
-    std::cout << benchmark << ",AlwaysTaken,"
-              << stats_always.total << ","
-              << stats_always.correct << ","
-              << (stats_always.accuracy() * 100.0) << ",0\n";
-
-    std::cout << benchmark << ",Bimodal2Bit,"
-              << stats_bimodal.total << ","
-              << stats_bimodal.correct << ","
-              << (stats_bimodal.accuracy() * 100.0) << ",0\n";
+    if (results_path.empty()) {
+        std::cout << "=== CSV (copy/paste into analysis/results.csv) ===\n";
+        std::cout << kResultsCsvHeader << "\n";
+        write_csv_rows(std::cout, rows);
+    } else if (!write_results(results_path, rows)) {
+        return 1;
+    }
+
+    if (!csv_path.empty() && !write_csv_file(csv_path, rows)) return 1;
+
+    if (!collect_prefix.empty() && !write_collector_files(collect_prefix, sims, top_n)) return 1;
 
     return 0;
 }
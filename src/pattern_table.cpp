@@ -1,32 +1,171 @@
 #include "pattern_table.hpp"
 
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
 namespace bp {
 
 /**
- * Construct a PT with 2^history_bits entries.
+ * Construct a PT with 2^index_bits entries (2^history_bits by default).
  *
- * Each entry is initialized based on the automaton type:
+ * Each entry is initialized to the automaton's S_0:
  *   - LastTime → state = 1  (predict taken at start)
  *   - A2/A3/A4 → state = 3  (strongly taken)
+ *   - user     → the init state it was defined with
  *
  * This follows Section 4.2 of the paper.
  */
-PatternTable::PatternTable(int history_bits, AutomatonType automaton)
+PatternTable::PatternTable(int history_bits, AutomatonType automaton,
+                           PTLayout layout, int index_bits)
     : history_bits_(history_bits),
-      mask_((1u << history_bits) - 1u),
+      index_bits_(index_bits > 0 ? std::min(index_bits, history_bits)
+                                 : std::min(history_bits, kDefaultMaxPTIndexBits)),
+      folded_(history_bits_ > index_bits_),
+      mask_(static_cast<std::uint32_t>(history_mask(index_bits_))),
       automaton_(automaton),
-      entries_(1u << history_bits, automaton_init_state(automaton))
-{}
+      fsm_(&automaton_table(automaton)),
+      layout_(layout),
+      state_bits_(automaton_packed_bits(automaton)),
+      num_entries_(std::size_t{1} << index_bits_),
+      alias_(num_entries_)
+{
+    if (layout_ == PTLayout::Bytes) {
+        entries_.resize(num_entries_);
+    } else {
+        const std::size_t per_word = 64u / state_bits_;
+        words_.resize((num_entries_ + per_word - 1) / per_word);
+    }
+    reset();
+}
+
+std::uint64_t PatternTable::init_word() const {
+    std::uint64_t w = 0;
+    for (unsigned shift = 0; shift < 64; shift += state_bits_) {
+        w |= static_cast<std::uint64_t>(automaton_init_state(automaton_)) << shift;
+    }
+    return w;
+}
+
+void PatternTable::reset() {
+    if (layout_ == PTLayout::Bytes) {
+        std::fill(entries_.begin(), entries_.end(), automaton_init_state(automaton_));
+    } else {
+        std::fill(words_.begin(), words_.end(), init_word());
+    }
+}
+
+void PatternTable::copy_from(const PatternTable& other) {
+    if (layout_ == PTLayout::Bytes) {
+        std::memcpy(entries_.data(), other.entries_.data(), entries_.size());
+    } else {
+        std::memcpy(words_.data(), other.words_.data(),
+                    words_.size() * sizeof(std::uint64_t));
+    }
+}
+
+/**
+ * In the packed layout, XOR whole words and fold each field's bits into
+ * its lowest bit, so that one popcount counts the differing entries of 64
+ * (1-bit), 32 (2-bit) or 16 (4-bit) entries at once. Unused trailing fields of the
+ * last word are equal in both tables and never counted.
+ */
+std::size_t PatternTable::diff(const PatternTable& other) const {
+    std::size_t n = 0;
+    if (layout_ == PTLayout::Bytes) {
+        for (std::size_t i = 0; i < entries_.size(); ++i) {
+            n += (entries_[i] != other.entries_[i]) ? 1u : 0u;
+        }
+        return n;
+    }
+
+    if (state_bits_ == 1) {
+        for (std::size_t i = 0; i < words_.size(); ++i) {
+            n += static_cast<std::size_t>(__builtin_popcountll(words_[i] ^ other.words_[i]));
+        }
+    } else if (state_bits_ == 2) {
+        for (std::size_t i = 0; i < words_.size(); ++i) {
+            std::uint64_t x = words_[i] ^ other.words_[i];
+            x = (x | (x >> 1)) & 0x5555555555555555ull;
+            n += static_cast<std::size_t>(__builtin_popcountll(x));
+        }
+    } else {
+        for (std::size_t i = 0; i < words_.size(); ++i) {
+            std::uint64_t x = words_[i] ^ other.words_[i];
+            x |= x >> 1;
+            x = (x | (x >> 2)) & 0x1111111111111111ull;
+            n += static_cast<std::size_t>(__builtin_popcountll(x));
+        }
+    }
+    return n;
+}
+
+void PatternTable::save(SnapshotWriter& out) const {
+    out.write<std::uint32_t>(static_cast<std::uint32_t>(layout_));
+    if (layout_ == PTLayout::Bytes) out.write_array(entries_);
+    else                            out.write_array(words_);
+    alias_.save(out);
+}
+
+void PatternTable::load(SnapshotReader& in) {
+    std::uint32_t layout = 0;
+    in.read(layout);
+    if (in.ok() && layout != static_cast<std::uint32_t>(layout_)) {
+        in.fail("pattern table layout mismatch");
+        return;
+    }
+    if (layout_ == PTLayout::Bytes) {
+        in.read_span(entries_.data(), entries_.size());
+        if (in.ok() && !automaton_states_valid(automaton_, entries_.data(), entries_.size())) {
+            in.fail("pattern table state out of range for its automaton");
+            return;
+        }
+    } else {
+        in.read_span(words_.data(), words_.size());
+    }
+    alias_.load(in);
+}
+
+// ======================= PTAliasSampler =======================
+
+namespace {
+
+// Distinct PCs behind a signature with `bits` of 64 bits set.
+double estimate_pcs(int bits) {
+    constexpr double kSaturatedPcs = 64.0 * 4.1588830833596715; // 64 ln 64
+    if (bits >= 64) return kSaturatedPcs;
+    return -64.0 * std::log1p(-static_cast<double>(bits) / 64.0);
+}
+
+} // namespace
+
+PTAliasSummary PTAliasSampler::summary() const {
+    PTAliasSummary sum;
+    double         pcs = 0.0;
+    for (std::uint64_t s : sig_) {
+        if (s == 0) continue;
+        const int bits = __builtin_popcountll(s);
+        ++sum.used;
+        sum.aliased += (bits > 1) ? 1u : 0u;
+        pcs         += estimate_pcs(bits);
+    }
+    if (sum.used) sum.pcs_per_entry = pcs / static_cast<double>(sum.used);
+
+    // From the watched entries to the whole PT (a power of two larger).
+    const std::uint64_t scale = entries_ / sig_.size();
+    sum.used    *= scale;
+    sum.aliased *= scale;
+    return sum;
+}
 
-bool PatternTable::predict(std::uint16_t history) const {
-    std::uint32_t idx = history & mask_;
-    return automaton_predict(automaton_, entries_[idx]);
+void PTAliasSampler::save(SnapshotWriter& out) const {
+    out.write(batches_);
+    out.write_array(sig_);
 }
 
-void PatternTable::update(std::uint16_t history, Outcome o) {
-    std::uint32_t idx = history & mask_;
-    std::uint8_t& st  = entries_[idx];
-    st = automaton_next(automaton_, st, o);
+void PTAliasSampler::load(SnapshotReader& in) {
+    in.read(batches_);
+    in.read_span(sig_.data(), sig_.size());
 }
 
 } // namespace bp
@@ -0,0 +1,129 @@
+#include "predictor_registry.hpp"
+
+#include <algorithm>
+
+#include <dlfcn.h>
+
+#include "predictors.hpp"
+
+namespace bp {
+
+namespace {
+
+// Factory for a built-in that takes no params; Args... come from PredictorArgs.
+template <class Predictor, class... Args>
+PredictorFactory no_params(Args PredictorArgs::*... members) {
+    return [members...](const PredictorArgs& args,
+                        std::string& error) -> std::unique_ptr<PredictorUnit> {
+        if (!args.params.empty()) {
+            error = "predictor '" + args.label + "' takes no parameters";
+            return nullptr;
+        }
+        return std::make_unique<PredictorSim<Predictor>>(args.label, args.*members...);
+    };
+}
+
+} // namespace
+
+PredictorRegistry::PredictorRegistry() {
+    add("AlwaysTaken", "static: always predict taken", no_params<AlwaysTakenPredictor>());
+    add("Bimodal2Bit", "per-branch 2-bit saturating counter (A2)",
+        no_params<Bimodal2BitPredictor>(&PredictorArgs::static_branches));
+}
+
+PredictorRegistry& PredictorRegistry::instance() {
+    static PredictorRegistry registry;
+    return registry;
+}
+
+bool PredictorRegistry::add(std::string name, std::string description,
+                            PredictorFactory factory) {
+    if (name.empty() || find(name) || !factory) return false;
+    entries_.push_back({std::move(name), std::move(description), std::move(factory), std::string()});
+    return true;
+}
+
+const PredictorRegistry::Entry* PredictorRegistry::find(const std::string& name) const {
+    for (const Entry& e : entries_) {
+        if (e.name == name) return &e;
+    }
+    return nullptr;
+}
+
+std::unique_ptr<PredictorUnit> PredictorRegistry::make(const std::string& spec,
+                                                       std::size_t static_branches,
+                                                       std::string& error) const {
+    const std::size_t colon = spec.find(':');
+    const std::string name  = spec.substr(0, colon);
+    const Entry*      entry = find(name);
+    if (!entry) {
+        error = "unknown predictor '" + name + "' (see --list-predictors)";
+        return nullptr;
+    }
+
+    PredictorArgs args;
+    args.label           = spec;
+    args.params          = (colon == std::string::npos) ? "" : spec.substr(colon + 1);
+    args.static_branches = static_branches;
+    std::unique_ptr<PredictorUnit> unit = entry->factory(args, error);
+    if (!unit && error.empty()) error = "predictor '" + spec + "' could not be built";
+    return unit;
+}
+
+std::vector<std::string> default_predictors() {
+    return {"AlwaysTaken", "Bimodal2Bit"};
+}
+
+bool make_predictors(const std::vector<std::string>& specs, std::size_t static_branches,
+                     std::vector<std::unique_ptr<PredictorUnit>>& units, std::string& error) {
+    const PredictorRegistry& registry = PredictorRegistry::instance();
+    for (std::size_t i = 0; i < specs.size(); ++i) {
+        const std::string& spec = specs[i];
+        if (std::find(specs.begin(), specs.begin() + i, spec) != specs.begin() + i) {
+            error = "predictor '" + spec + "' is given twice";
+            return false;
+        }
+        std::unique_ptr<PredictorUnit> unit = registry.make(spec, static_branches, error);
+        if (!unit) return false;
+        units.push_back(std::move(unit));
+    }
+    return true;
+}
+
+bool load_predictor_plugin(const std::string& path, std::string& error) {
+    // RTLD_GLOBAL: a plugin's predictors may be used by later plugins.
+    void* handle = ::dlopen(path.c_str(), RTLD_NOW | RTLD_GLOBAL);
+    if (!handle) {
+        const char* why = ::dlerror();
+        error = "could not load plugin '" + path + "': " + (why ? why : "unknown error");
+        return false;
+    }
+
+    using AbiFn      = int (*)();
+    using RegisterFn = void (*)(PredictorRegistry&);
+    auto abi         = reinterpret_cast<AbiFn>(::dlsym(handle, "bp_predictor_plugin_abi"));
+    auto register_fn = reinterpret_cast<RegisterFn>(::dlsym(handle, "bp_register_predictors"));
+    if (!abi || !register_fn) {
+        error = "plugin '" + path + "' is not a predictor plugin (see BP_PREDICTOR_PLUGIN)";
+        return false;
+    }
+    if (abi() != kPredictorPluginAbi) {
+        error = "plugin '" + path + "' was built for predictor ABI " + std::to_string(abi()) +
+                ", expected " + std::to_string(kPredictorPluginAbi);
+        return false;
+    }
+
+    PredictorRegistry& registry = PredictorRegistry::instance();
+    const std::size_t  before   = registry.entries().size();
+    register_fn(registry);
+    if (registry.entries().size() == before) {
+        error = "plugin '" + path + "' registered no new predictor (duplicate names?)";
+        return false;
+    }
+    for (std::size_t i = before; i < registry.entries_.size(); ++i) {
+        registry.entries_[i].plugin = path;
+    }
+    return true;
+}
+
+} // namespace bp
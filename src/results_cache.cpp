@@ -0,0 +1,270 @@
+#include "results_cache.hpp"
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "index_hash.hpp"
+#include "predictor_registry.hpp"
+#include "results_file.hpp"
+
+namespace bp {
+
+// ======================= Keys =======================
+
+namespace {
+
+std::uint64_t rotl64(std::uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// splitmix64's finalizer.
+std::uint64_t avalanche(std::uint64_t x) {
+    x ^= x >> 30; x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27; x *= 0x94D049BB133111EBull;
+    return x ^ (x >> 31);
+}
+
+const char* hrt_kind_key(HRTKind kind) {
+    switch (kind) {
+        case HRTKind::AHRT: return "AHRT";
+        case HRTKind::HHRT: return "HHRT";
+        case HRTKind::IHRT: return "IHRT";
+        case HRTKind::GHR:  return "GHR";
+    }
+    return "?";
+}
+
+// The automaton as its table: states, initial state, predictions, δ.
+std::string automaton_key(AutomatonType type) {
+    const AutomatonTable& fsm = automaton_table(type);
+    std::ostringstream    out;
+    out << unsigned{fsm.states} << ":" << unsigned{fsm.init} << ":" << fsm.taken_states << ":";
+    for (unsigned s = 0; s < fsm.states; ++s) {
+        out << (s ? "," : "") << unsigned{fsm.delta[s][0]} << "/" << unsigned{fsm.delta[s][1]};
+    }
+    return out.str();
+}
+
+} // namespace
+
+/**
+ * Words of the file mixed into one 64-bit state (a multiply-rotate hash
+ * like the AHRT's kFibonacciHash index), then avalanched with its length.
+ */
+bool trace_content_hash(const std::string& path, std::string& hash, std::string& error) {
+    std::FILE* in = std::fopen(path.c_str(), "rb");
+    if (!in) {
+        error = "could not open trace file '" + path + "'";
+        return false;
+    }
+    std::vector<unsigned char> buf(std::size_t{1} << 20);
+    std::uint64_t h      = 0;
+    std::uint64_t length = 0;
+    std::size_t   n;
+    while ((n = std::fread(buf.data(), 1, buf.size(), in)) > 0) {
+        length += n;
+        std::memset(buf.data() + n, 0, (8 - n % 8) % 8);
+        for (std::size_t i = 0; i < n; i += 8) {
+            std::uint64_t w;
+            std::memcpy(&w, buf.data() + i, sizeof(w));
+            h = rotl64((h ^ w) * kFibonacciHash, 31);
+        }
+    }
+    const bool failed = std::ferror(in) != 0;
+    std::fclose(in);
+    if (failed) {
+        error = "read error on '" + path + "'";
+        return false;
+    }
+    char hex[17];
+    std::snprintf(hex, sizeof(hex), "%016llx",
+                  static_cast<unsigned long long>(avalanche(h ^ avalanche(length))));
+    hash = hex;
+    return true;
+}
+
+std::string cache_key(const ATConfig& cfg) {
+    std::ostringstream out;
+    out << "at hrt=" << hrt_kind_key(cfg.hrt_kind)
+        << " entries=" << cfg.hrt_entries
+        << " ways=" << cfg.hrt_ways
+        << " repl=" << static_cast<int>(cfg.hrt_replacement)
+        << " index=" << static_cast<int>(cfg.hrt_index)
+        << " k=" << cfg.history_bits
+        << " pt=" << static_cast<int>(cfg.pt_select)
+        << " sets=" << cfg.pt_set_bits
+        << " ptbits=" << cfg.pt_index_bits
+        << " fsm=" << automaton_key(cfg.automaton);
+    return out.str();
+}
+
+std::string cache_key(const std::string& predictor_spec) {
+    const PredictorRegistry::Entry* entry =
+        PredictorRegistry::instance().find(predictor_spec.substr(0, predictor_spec.find(':')));
+    if (!entry || entry->plugin.empty()) return "predictor " + predictor_spec;
+
+    // Plugins are hashed once per run.
+    static std::unordered_map<std::string, std::string> plugin_hashes;
+    auto it = plugin_hashes.find(entry->plugin);
+    if (it == plugin_hashes.end()) {
+        std::string hash, error;
+        if (!trace_content_hash(entry->plugin, hash, error)) hash.clear();
+        it = plugin_hashes.emplace(entry->plugin, hash).first;
+    }
+    if (it->second.empty()) return "";
+    return "predictor " + predictor_spec + " plugin=" + it->second;
+}
+
+std::string cache_key(const HybridConfig& hybrid, const ATConfig& at) {
+    return "hybrid meta=" + std::to_string(hybrid.meta_bits) +
+           " filter=" + (hybrid.bias_filter ? "1" : "0") + " [" + cache_key(at) + "]";
+}
+
+// ======================= ResultsCache =======================
+
+namespace {
+
+// Stored keys carry the version, so rows of other versions never match.
+std::string versioned(const std::string& key) {
+    return std::string("v") + kResultsCacheVersion + " " + key;
+}
+
+bool make_directory(const std::string& path, std::string& error) {
+    if (::mkdir(path.c_str(), 0777) == 0 || errno == EEXIST) return true;
+    error = "could not create cache directory '" + path + "': " + std::strerror(errno);
+    return false;
+}
+
+bool ends_with(const std::string& s, const char* suffix) {
+    const std::size_t n = std::strlen(suffix);
+    return s.size() >= n && s.compare(s.size() - n, n, suffix) == 0;
+}
+
+} // namespace
+
+ResultsCache::ResultsCache(const std::string& dir, const std::string& trace_hash)
+    : root_(dir), dir_(dir + "/" + trace_hash) {}
+
+bool ResultsCache::load(std::string& error) {
+    DIR* d = ::opendir(dir_.c_str());
+    if (!d) return true; // nothing cached for this trace yet
+
+    std::vector<std::string> files;
+    while (const dirent* e = ::readdir(d)) {
+        const std::string name = e->d_name;
+        if (ends_with(name, kResultsFileExt)) files.push_back(dir_ + "/" + name);
+    }
+    ::closedir(d);
+
+    const std::string prefix = versioned("");
+    for (const std::string& file : files) {
+        std::vector<ResultRow>   rows;
+        std::vector<std::string> keys;
+        if (!read_results_file(file, rows, error, &keys)) return false;
+        for (std::size_t i = 0; i < rows.size(); ++i) {
+            if (keys[i].compare(0, prefix.size(), prefix) == 0) rows_[keys[i]] = rows[i];
+        }
+    }
+    return true;
+}
+
+const ResultRow* ResultsCache::find(const std::string& key) const {
+    if (key.empty()) return nullptr;
+    auto it = rows_.find(versioned(key));
+    return it == rows_.end() ? nullptr : &it->second;
+}
+
+void ResultsCache::add(const std::string& key, const ResultRow& row) {
+    if (key.empty() || find(key)) return;
+    rows_[versioned(key)] = row;
+    added_.push_back(row);
+    added_keys_.push_back(versioned(key));
+}
+
+bool ResultsCache::save(std::string& error) {
+    if (added_.empty()) return true;
+    if (!make_directory(root_, error) || !make_directory(dir_, error)) return false;
+    std::string written;
+    if (!write_results_file(dir_, added_, written, error, &added_keys_)) return false;
+    added_.clear();
+    added_keys_.clear();
+    return true;
+}
+
+// ======================= CachedRun =======================
+
+CachedRun::CachedRun(ResultsCache& cache, const std::vector<ATConfig>& configs,
+                     const std::vector<std::string>& predictor_specs,
+                     const std::vector<HybridConfig>& hybrids)
+    : cache_(cache) {
+    // An uncached hybrid needs its AT configuration and Bimodal2Bit.
+    std::vector<bool> needed(configs.size(), false);
+    bool              needs_bimodal = false;
+    std::vector<std::string> hybrid_keys;
+    for (const HybridConfig& h : hybrids) {
+        std::size_t at = 0;
+        while (at < configs.size() && configs[at].name != h.at_scheme) ++at;
+        hybrid_keys.push_back(at < configs.size() ? cache_key(h, configs[at]) : std::string());
+        if (at < configs.size() && !cache.find(hybrid_keys.back())) {
+            needed[at]    = true;
+            needs_bimodal = true;
+        }
+    }
+
+    // Row indices in the SimSet: its configs, then predictors, then hybrids.
+    std::vector<Slot> config_slots, predictor_slots, hybrid_slots;
+    for (std::size_t i = 0; i < configs.size(); ++i) {
+        Slot s{cache_key(configs[i]), configs[i].name, nullptr, 0};
+        s.cached = needed[i] ? nullptr : cache.find(s.key);
+        if (!s.cached) {
+            s.simulated = sim_configs_.size();
+            sim_configs_.push_back(configs[i]);
+        }
+        config_slots.push_back(s);
+    }
+    for (const std::string& spec : predictor_specs) {
+        Slot s{cache_key(spec), "", nullptr, 0};
+        s.cached = (needs_bimodal && spec == "Bimodal2Bit") ? nullptr : cache.find(s.key);
+        if (!s.cached) {
+            s.simulated = sim_configs_.size() + sim_predictors_.size();
+            sim_predictors_.push_back(spec);
+        }
+        predictor_slots.push_back(s);
+    }
+    for (std::size_t i = 0; i < hybrids.size(); ++i) {
+        Slot s{hybrid_keys[i], hybrids[i].name, cache.find(hybrid_keys[i]), 0};
+        if (!s.cached) {
+            s.simulated = sim_configs_.size() + sim_predictors_.size() + sim_hybrids_.size();
+            sim_hybrids_.push_back(hybrids[i]);
+        }
+        hybrid_slots.push_back(s);
+    }
+
+    for (auto* part : {&config_slots, &predictor_slots, &hybrid_slots}) {
+        for (const Slot& s : *part) {
+            if (s.cached) ++cached_;
+            slots_.push_back(s);
+        }
+    }
+}
+
+void CachedRun::merge(const std::string& benchmark, const std::vector<ResultRow>& simulated,
+                      std::vector<ResultRow>& rows) {
+    for (const Slot& s : slots_) {
+        if (s.cached) {
+            ResultRow row = *s.cached;
+            row.benchmark = benchmark;
+            if (!s.scheme.empty()) row.scheme = s.scheme;
+            rows.push_back(std::move(row));
+        } else {
+            rows.push_back(simulated[s.simulated]);
+            cache_.add(s.key, simulated[s.simulated]);
+        }
+    }
+}
+
+} // namespace bp
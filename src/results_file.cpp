@@ -0,0 +1,289 @@
+#include "results_file.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bp {
+
+namespace {
+
+constexpr std::size_t kResultsAlign = 8;
+
+std::size_t padded(std::size_t n) {
+    return (n + kResultsAlign - 1) & ~(kResultsAlign - 1);
+}
+
+// One column of a file being written.
+struct ColumnData {
+    const char*       name;
+    ResultsColumnType type;
+    std::string       bytes;
+};
+
+template <class T>
+void append_raw(std::string& out, const T& value) {
+    out.append(reinterpret_cast<const char*>(&value), sizeof(T));
+}
+
+template <class Get>
+ColumnData u64_column(const char* name, const std::vector<ResultRow>& rows, Get get) {
+    ColumnData c{name, ResultsColumnType::U64, {}};
+    for (const ResultRow& r : rows) append_raw<std::uint64_t>(c.bytes, get(r));
+    return c;
+}
+
+template <class Get>
+ColumnData f64_column(const char* name, const std::vector<ResultRow>& rows, Get get) {
+    ColumnData c{name, ResultsColumnType::F64, {}};
+    for (const ResultRow& r : rows) append_raw<double>(c.bytes, get(r));
+    return c;
+}
+
+template <class Get>
+ColumnData str_column(const char* name, const std::vector<ResultRow>& rows, Get get) {
+    ColumnData  c{name, ResultsColumnType::Str, {}};
+    std::string chars;
+    for (const ResultRow& r : rows) {
+        chars += get(r);
+        append_raw<std::uint64_t>(c.bytes, chars.size());
+    }
+    c.bytes += chars;
+    return c;
+}
+
+// The whole file, columns in kResultsCsvHeader order, then the keys if any.
+std::string encode(const std::vector<ResultRow>& rows, const std::vector<std::string>* keys) {
+    std::vector<ColumnData> cols;
+    cols.push_back(str_column("benchmark", rows, [](const ResultRow& r) { return r.benchmark; }));
+    cols.push_back(str_column("scheme", rows, [](const ResultRow& r) { return r.scheme; }));
+    cols.push_back(u64_column("total", rows, [](const ResultRow& r) { return r.stats.total; }));
+    cols.push_back(u64_column("correct", rows, [](const ResultRow& r) { return r.stats.correct; }));
+    cols.push_back(f64_column("accuracy", rows, [](const ResultRow& r) { return r.stats.accuracy() * 100.0; }));
+    cols.push_back(u64_column("hw_bits", rows, [](const ResultRow& r) { return r.hw_bits; }));
+    cols.push_back(u64_column("hrt_hits", rows, [](const ResultRow& r) { return r.hrt.hits; }));
+    cols.push_back(u64_column("hrt_misses", rows, [](const ResultRow& r) { return r.hrt.misses; }));
+    cols.push_back(u64_column("hrt_evictions", rows, [](const ResultRow& r) { return r.hrt.evictions; }));
+    cols.push_back(u64_column("hrt_cold", rows, [](const ResultRow& r) { return r.hrt.cold; }));
+    cols.push_back(u64_column("pt_used", rows, [](const ResultRow& r) { return r.pt_alias.used; }));
+    cols.push_back(u64_column("pt_aliased", rows, [](const ResultRow& r) { return r.pt_alias.aliased; }));
+    cols.push_back(f64_column("pt_pcs_per_entry", rows, [](const ResultRow& r) { return r.pt_alias.pcs_per_entry; }));
+    if (keys) {
+        cols.push_back(str_column("cache_key", rows, [&](const ResultRow& r) {
+            return (*keys)[static_cast<std::size_t>(&r - rows.data())];
+        }));
+    }
+
+    ResultsFileHeader h{};
+    std::memcpy(h.magic, kResultsFileMagic, sizeof(h.magic));
+    h.version      = kResultsFileVersion;
+    h.header_bytes = sizeof(ResultsFileHeader);
+    h.row_count    = rows.size();
+    h.column_count = static_cast<std::uint32_t>(cols.size());
+
+    std::string out;
+    append_raw(out, h);
+    std::uint64_t offset = padded(sizeof(ResultsFileHeader) + cols.size() * sizeof(ResultsColumn));
+    for (const ColumnData& c : cols) {
+        ResultsColumn d{};
+        std::strncpy(d.name, c.name, sizeof(d.name) - 1);
+        d.type   = static_cast<std::uint32_t>(c.type);
+        d.offset = offset;
+        d.bytes  = c.bytes.size();
+        append_raw(out, d);
+        offset += padded(c.bytes.size());
+    }
+    for (const ColumnData& c : cols) {
+        out.resize(padded(out.size()), '\0');
+        out += c.bytes;
+    }
+    out.resize(padded(out.size()), '\0');
+    return out;
+}
+
+bool is_directory(const std::string& path) {
+    struct stat st;
+    return ::stat(path.c_str(), &st) == 0 && S_ISDIR(st.st_mode);
+}
+
+// <benchmark>.<host>.<pid>.<time>.bpres: unique across concurrent runs.
+std::string unique_name(const std::vector<ResultRow>& rows) {
+    std::string label = rows.empty() ? "results" : rows.front().benchmark;
+    for (char& ch : label) {
+        if (ch == '/' || ch == '.' || ch == ' ') ch = '_';
+    }
+    char host[64] = {};
+    if (::gethostname(host, sizeof(host) - 1) != 0) std::strcpy(host, "host");
+    const auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::system_clock::now().time_since_epoch()).count();
+    return label + "." + host + "." + std::to_string(::getpid()) + "." +
+           std::to_string(ns) + kResultsFileExt;
+}
+
+} // namespace
+
+bool write_results_file(const std::string& path, const std::vector<ResultRow>& rows,
+                        std::string& written, std::string& error,
+                        const std::vector<std::string>* keys) {
+    const std::string target = is_directory(path) ? path + "/" + unique_name(rows) : path;
+    const std::string temp   = target + ".tmp." + std::to_string(::getpid());
+    const std::string data   = encode(rows, keys);
+
+    std::FILE* out = std::fopen(temp.c_str(), "wb");
+    if (!out) {
+        error = "could not create results file '" + temp + "'";
+        return false;
+    }
+    bool ok = std::fwrite(data.data(), 1, data.size(), out) == data.size() &&
+              std::fflush(out) == 0 && ::fsync(::fileno(out)) == 0;
+    ok = (std::fclose(out) == 0) && ok;
+    if (!ok) {
+        std::remove(temp.c_str());
+        error = "write error on '" + temp + "'";
+        return false;
+    }
+    if (std::rename(temp.c_str(), target.c_str()) != 0) {
+        std::remove(temp.c_str());
+        error = "could not rename '" + temp + "' to '" + target + "'";
+        return false;
+    }
+    written = target;
+    return true;
+}
+
+// ======================= Reading =======================
+
+namespace {
+
+// The columns of a loaded file, validated against its size.
+class ResultsFileView {
+public:
+    ResultsFileView(const std::string& data, const std::string& path, std::string& error)
+        : data_(data) {
+        if (data.size() < sizeof(ResultsFileHeader)) {
+            error = "'" + path + "' is not a results file (too short)";
+            return;
+        }
+        std::memcpy(&h_, data.data(), sizeof(h_));
+        if (std::memcmp(h_.magic, kResultsFileMagic, sizeof(h_.magic)) != 0) {
+            error = "'" + path + "' is not a results file (bad magic)";
+            return;
+        }
+        if (h_.version != kResultsFileVersion || h_.header_bytes < sizeof(ResultsFileHeader)) {
+            error = "'" + path + "': unsupported results file version " + std::to_string(h_.version);
+            return;
+        }
+        const std::uint64_t dir_bytes = std::uint64_t{h_.column_count} * sizeof(ResultsColumn);
+        if (h_.header_bytes + dir_bytes > data.size()) {
+            error = "'" + path + "': truncated results file";
+            return;
+        }
+        cols_.resize(h_.column_count);
+        std::memcpy(cols_.data(), data.data() + h_.header_bytes, dir_bytes);
+        for (const ResultsColumn& c : cols_) {
+            if (c.offset > data.size() || c.bytes > data.size() - c.offset) {
+                error = "'" + path + "': truncated results file";
+                return;
+            }
+        }
+        ok_ = true;
+    }
+
+    bool          ok() const { return ok_; }
+    std::uint64_t rows() const { return h_.row_count; }
+
+    // Column name of type, with its fixed-size part complete; else nullptr.
+    const ResultsColumn* find(const char* name, ResultsColumnType type) const {
+        for (const ResultsColumn& c : cols_) {
+            if (std::strncmp(c.name, name, sizeof(c.name)) == 0 &&
+                c.type == static_cast<std::uint32_t>(type) &&
+                c.bytes / sizeof(std::uint64_t) >= h_.row_count) {
+                return &c;
+            }
+        }
+        return nullptr;
+    }
+
+    template <class T>
+    T value(const ResultsColumn* c, std::size_t i) const {
+        T v{};
+        if (c) std::memcpy(&v, data_.data() + c->offset + i * sizeof(T), sizeof(T));
+        return v;
+    }
+
+    // String i of a Str column, or "" if its offsets are out of range.
+    std::string string(const ResultsColumn* c, std::size_t i) const {
+        const std::uint64_t base  = h_.row_count * sizeof(std::uint64_t);
+        const std::uint64_t begin = i ? value<std::uint64_t>(c, i - 1) : 0;
+        const std::uint64_t end   = value<std::uint64_t>(c, i);
+        if (begin > end || end > c->bytes - base) return "";
+        return data_.substr(c->offset + base + begin, end - begin);
+    }
+
+private:
+    const std::string&         data_;
+    ResultsFileHeader          h_{};
+    std::vector<ResultsColumn> cols_;
+    bool                       ok_ = false;
+};
+
+} // namespace
+
+bool read_results_file(const std::string& path, std::vector<ResultRow>& rows,
+                       std::string& error, std::vector<std::string>* keys) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        error = "could not open results file '" + path + "'";
+        return false;
+    }
+    const std::string data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    ResultsFileView file(data, path, error);
+    if (!file.ok()) return false;
+
+    using T = ResultsColumnType;
+    const ResultsColumn* benchmark = file.find("benchmark", T::Str);
+    const ResultsColumn* scheme    = file.find("scheme", T::Str);
+    if (!benchmark || !scheme) {
+        error = "'" + path + "': results file has no benchmark/scheme columns";
+        return false;
+    }
+    // Numeric columns a file lacks read as 0.
+    const ResultsColumn* total     = file.find("total", T::U64);
+    const ResultsColumn* correct   = file.find("correct", T::U64);
+    const ResultsColumn* hw_bits   = file.find("hw_bits", T::U64);
+    const ResultsColumn* hits      = file.find("hrt_hits", T::U64);
+    const ResultsColumn* misses    = file.find("hrt_misses", T::U64);
+    const ResultsColumn* evictions = file.find("hrt_evictions", T::U64);
+    const ResultsColumn* cold      = file.find("hrt_cold", T::U64);
+    const ResultsColumn* used      = file.find("pt_used", T::U64);
+    const ResultsColumn* aliased   = file.find("pt_aliased", T::U64);
+    const ResultsColumn* per_entry = file.find("pt_pcs_per_entry", T::F64);
+    const ResultsColumn* cache_key = file.find("cache_key", T::Str);
+
+    for (std::size_t i = 0; i < file.rows(); ++i) {
+        ResultRow r;
+        r.benchmark              = file.string(benchmark, i);
+        r.scheme                 = file.string(scheme, i);
+        r.stats.total            = file.value<std::uint64_t>(total, i);
+        r.stats.correct          = file.value<std::uint64_t>(correct, i);
+        r.hw_bits                = file.value<std::uint64_t>(hw_bits, i);
+        r.hrt.hits               = file.value<std::uint64_t>(hits, i);
+        r.hrt.misses             = file.value<std::uint64_t>(misses, i);
+        r.hrt.evictions          = file.value<std::uint64_t>(evictions, i);
+        r.hrt.cold               = file.value<std::uint64_t>(cold, i);
+        r.pt_alias.used          = file.value<std::uint64_t>(used, i);
+        r.pt_alias.aliased       = file.value<std::uint64_t>(aliased, i);
+        r.pt_alias.pcs_per_entry = file.value<double>(per_entry, i);
+        rows.push_back(std::move(r));
+        if (keys) keys->push_back(cache_key ? file.string(cache_key, i) : std::string());
+    }
+    return true;
+}
+
+} // namespace bp
@@ -0,0 +1,324 @@
+#include "shared_hrt.hpp"
+
+#include <algorithm>
+#include <cstdint>
+#include <type_traits>
+
+namespace bp {
+
+SharedATMember::SharedATMember(const ATConfig& c, SharedHRTGroup& group)
+    : ATUnit(c),
+      group_(group),
+      mask_(history_mask(c.history_bits)),
+      select_(c.pt_select, c.history_bits, c.pt_set_bits),
+      pt_(select_.pattern_bits(), c.automaton, c.pt_layout, c.pt_index_bits) {}
+
+std::size_t SharedATMember::hardware_cost_bits() const {
+    std::size_t hrt_bits = group_.hrt().capacity_entries() * cfg.history_bits;
+    std::size_t pt_bits  = pt_.num_entries() * automaton_state_bits(pt_.automaton());
+    return hrt_bits + pt_bits;
+}
+
+HRTCounters SharedATMember::hrt_counters() const {
+    return group_.hrt().counters();
+}
+
+void SharedATMember::set_hrt_counters(const HRTCounters& c) {
+    group_.hrt().set_counters(c);
+}
+
+void SharedATMember::save(SnapshotWriter& out) const {
+    out.write_string(cfg.name);
+    out.write(stats);
+    pt_.save(out);
+}
+
+void SharedATMember::load(SnapshotReader& in) {
+    in.expect_string(cfg.name, "unit");
+    in.read(stats);
+    pt_.load(in);
+}
+
+/**
+ * Second level only: the histories were produced by the group's HRT, so
+ * each branch costs one PT predict/update.
+ */
+template <bool Observe, bool Plain, class Collector>
+void SharedATMember::replay(const History* hist, const TraceBlock& block,
+                            Collector& collector) {
+    const Outcome* outs = block.outs;
+    std::uint64_t correct = 0;
+    for (std::size_t i = 0; i < block.n; ++i) {
+        const History h     = hist[i] & mask_;
+        const History p     = Plain ? h : select_.pattern(h, block.pcs[i]);
+        const bool    taken = (outs[i] == Outcome::Taken);
+        const bool    hit   = (pt_.predict(p) == taken);
+        correct += hit ? 1u : 0u;
+        collector.record(block.pcs[i], hit);
+        if constexpr (Observe) pt_.observe(p, block.pcs[i]);
+        pt_.update(p, outs[i]);
+    }
+    stats.total   += block.n;
+    stats.correct += correct;
+}
+
+void SharedATMember::replay(const History* hist, const TraceBlock& block) {
+    const bool observe = pt_.observe_batch();
+    with_collector(collector, hit_log, block.n, [&](auto& c) {
+        if (select_.plain()) {
+            if (observe) replay<true, true>(hist, block, c);
+            else         replay<false, true>(hist, block, c);
+        } else {
+            if (observe) replay<true, false>(hist, block, c);
+            else         replay<false, false>(hist, block, c);
+        }
+    });
+}
+
+// ======================= AutomatonLanes =======================
+
+namespace {
+
+// Product states must fit the byte entries of AutomatonLanes.
+constexpr unsigned kMaxProductStates = 256;
+
+// Each lane counts its correct predictions in a field of this many bits,
+// which is emptied at least every kLaneCountRecords branches.
+constexpr unsigned      kLaneCountBits    = 16;
+constexpr std::size_t   kLaneCountRecords = (std::size_t{1} << kLaneCountBits) - 1;
+constexpr std::uint64_t kLaneCountMask    = kLaneCountRecords;
+
+static_assert(kMaxAutomatonLanes * kLaneCountBits <= 64, "lane counts must fit one word");
+
+unsigned automaton_states(const SharedATMember& m) {
+    return automaton_table(m.pattern_table().automaton()).states;
+}
+
+} // namespace
+
+AutomatonLanes::AutomatonLanes(SharedATMember* first) { add(first); }
+
+bool AutomatonLanes::accepts(const SharedATMember& member) const {
+    const SharedATMember& lead = *lanes_.front();
+    return lanes_.size() < kMaxAutomatonLanes &&
+           states_ * automaton_states(member) <= kMaxProductStates &&
+           member.cfg.history_bits == lead.cfg.history_bits &&
+           member.cfg.pt_select == lead.cfg.pt_select &&
+           member.selector().pattern_bits() == lead.selector().pattern_bits() &&
+           member.pattern_table().index_bits() == lead.pattern_table().index_bits();
+}
+
+/**
+ * Lane l's state is digit l of the product state in the mixed radix of the
+ * lanes' state counts; next_ and hits_ step and score every digit.
+ */
+void AutomatonLanes::add(SharedATMember* member) {
+    if (fused_) flush();
+    fused_ = false;
+    lanes_.push_back(member);
+
+    states_ = 1;
+    for (std::size_t l = 0; l < lanes_.size(); ++l) {
+        stride_[l] = states_;
+        states_ *= automaton_states(*lanes_[l]);
+    }
+    for (unsigned s = 0; s < states_; ++s) {
+        for (unsigned r = 0; r < 2; ++r) {
+            unsigned      next = 0;
+            std::uint64_t hits = 0;
+            for (std::size_t l = 0; l < lanes_.size(); ++l) {
+                const AutomatonTable& fsm = automaton_table(lanes_[l]->pattern_table().automaton());
+                const auto            st  = static_cast<std::uint8_t>(s / stride_[l] % fsm.states);
+                next += fsm.next(st, static_cast<Outcome>(r)) * stride_[l];
+                if (fsm.predict(st) == (r != 0)) hits |= std::uint64_t{1} << (l * kLaneCountBits);
+            }
+            next_[s][r] = static_cast<std::uint8_t>(next);
+            hits_[s][r] = hits;
+        }
+    }
+    if (lanes_.size() > 1) entries_.resize(member->pattern_table().num_entries());
+}
+
+void AutomatonLanes::fuse() {
+    for (std::size_t i = 0; i < entries_.size(); ++i) {
+        unsigned s = 0;
+        for (std::size_t l = 0; l < lanes_.size(); ++l) {
+            s += lanes_[l]->pattern_table().state(static_cast<std::uint32_t>(i)) * stride_[l];
+        }
+        entries_[i] = static_cast<std::uint8_t>(s);
+    }
+    fused_ = true;
+}
+
+void AutomatonLanes::flush() const {
+    if (!fused_) return;
+    for (std::size_t l = 0; l < lanes_.size(); ++l) {
+        PatternTable&  pt     = lanes_[l]->pattern_table();
+        const unsigned states = automaton_table(pt.automaton()).states;
+        for (std::size_t i = 0; i < entries_.size(); ++i) {
+            pt.set_state(static_cast<std::uint32_t>(i),
+                         static_cast<std::uint8_t>(entries_[i] / stride_[l] % states));
+        }
+    }
+}
+
+/**
+ * Second level for all lanes: one PT entry per branch, as in
+ * SharedATMember::replay(). observed: lanes whose alias sampler observes
+ * this block.
+ */
+template <bool Observe, bool Plain>
+void AutomatonLanes::replay_fused(const History* hist, const TraceBlock& block,
+                                  unsigned observed) {
+    const SharedATMember& lead    = *lanes_.front();
+    const History         mask    = lead.mask();
+    const PTSelector&     select  = lead.selector();
+    const PatternTable&   pt      = lead.pattern_table();
+    std::uint8_t*         entries = entries_.data();
+
+    std::uint64_t correct[kMaxAutomatonLanes] = {};
+    for (std::size_t begin = 0; begin < block.n; begin += kLaneCountRecords) {
+        const std::size_t end    = std::min(block.n, begin + kLaneCountRecords);
+        std::uint64_t     counts = 0;
+        for (std::size_t i = begin; i < end; ++i) {
+            const History       h     = hist[i] & mask;
+            const History       p     = Plain ? h : select.pattern(h, block.pcs[i]);
+            const std::uint32_t idx   = pt.index(p);
+            const unsigned      taken = (block.outs[i] == Outcome::Taken) ? 1u : 0u;
+            const std::uint8_t  s     = entries[idx];
+            counts += hits_[s][taken];
+            if constexpr (Observe) {
+                for (std::size_t l = 0; l < lanes_.size(); ++l) {
+                    if ((observed >> l) & 1u) lanes_[l]->pattern_table().observe(p, block.pcs[i]);
+                }
+            }
+            entries[idx] = next_[s][taken];
+        }
+        for (std::size_t l = 0; l < lanes_.size(); ++l) {
+            correct[l] += (counts >> (l * kLaneCountBits)) & kLaneCountMask;
+        }
+    }
+    for (std::size_t l = 0; l < lanes_.size(); ++l) {
+        lanes_[l]->stats.total   += block.n;
+        lanes_[l]->stats.correct += correct[l];
+    }
+}
+
+void AutomatonLanes::replay(const History* hist, const TraceBlock& block) {
+    bool separate = lanes_.size() == 1;
+    for (const SharedATMember* m : lanes_) separate = separate || m->collector || m->hit_log;
+    if (separate) {
+        flush();
+        fused_ = false;
+        for (SharedATMember* m : lanes_) m->replay(hist, block);
+        return;
+    }
+
+    if (!fused_) fuse();
+    unsigned observed = 0;
+    for (std::size_t l = 0; l < lanes_.size(); ++l) {
+        if (lanes_[l]->pattern_table().observe_batch()) observed |= 1u << l;
+    }
+    if (lanes_.front()->selector().plain()) {
+        if (observed) replay_fused<true, true>(hist, block, observed);
+        else          replay_fused<false, true>(hist, block, observed);
+    } else {
+        if (observed) replay_fused<true, false>(hist, block, observed);
+        else          replay_fused<false, false>(hist, block, observed);
+    }
+}
+
+// ======================= SharedHRTGroup =======================
+
+SharedHRTGroup::SharedHRTGroup(const ATConfig& geometry, int history_bits,
+                               std::size_t expected_branches)
+    : kind_(geometry.hrt_kind),
+      replacement_(geometry.hrt_replacement),
+      index_(geometry.hrt_index),
+      mask_(history_mask(history_bits)),
+      hrt_(make_history_table(geometry.hrt_kind, geometry.hrt_entries, geometry.hrt_ways,
+                              geometry.hrt_replacement, geometry.hrt_index, history_bits,
+                              expected_branches)),
+      hist_(kTraceBlockRecords)
+{}
+
+void SharedHRTGroup::add_member(SharedATMember* member) {
+    members_.push_back(member);
+    for (AutomatonLanes& lanes : lanes_) {
+        if (lanes.accepts(*member)) {
+            lanes.add(member);
+            return;
+        }
+    }
+    lanes_.emplace_back(member);
+}
+
+namespace {
+
+// First level only, on the concrete HRT type (see run_batch in two_level_at.cpp).
+template <bool ById, class HRT>
+void record_history(HRT& hrt, History mask, const BranchId* ids, const std::uint64_t* pcs,
+                    const Outcome* outs, std::size_t n, History* hist) {
+    for (std::size_t i = 0; i < n; ++i) {
+        HRTSlot slot = lookup_branch<ById>(hrt, ids, i, pcs[i]);
+        History h    = slot.history;
+        hist[i] = h;
+        hrt.commit(slot, ((h << 1) | (outs[i] == Outcome::Taken ? 1u : 0u)) & mask);
+    }
+}
+
+} // namespace
+
+void SharedHRTGroup::run_block(const TraceBlock& block) {
+    if (hist_.size() < block.n) hist_.resize(block.n);
+    History* hist = hist_.data();
+
+    visit_history_table(*hrt_, kind_, replacement_, index_, [&](auto& hrt) {
+        using HRT = std::decay_t<decltype(hrt)>;
+        if constexpr (HRT::kByBranchId) {
+            if (block.ids) {
+                hrt.use_ids(block.id_space);
+                record_history<true>(hrt, mask_, block.ids, block.pcs, block.outs, block.n,
+                                     hist);
+                return;
+            }
+        }
+        record_history<false>(hrt, mask_, nullptr, block.pcs, block.outs, block.n, hist);
+    });
+
+    for (AutomatonLanes& lanes : lanes_) lanes.replay(hist, block);
+}
+
+void SharedHRTGroup::save(SnapshotWriter& out) const {
+    out.write<std::uint64_t>(members_.size());
+    for (const AutomatonLanes& lanes : lanes_) lanes.flush();
+    hrt_->save(out);
+    for (const SharedATMember* m : members_) m->save(out);
+}
+
+void SharedHRTGroup::load(SnapshotReader& in) {
+    std::uint64_t count = 0;
+    in.read(count);
+    if (in.ok() && count != members_.size()) {
+        in.fail("shared HRT group size mismatch");
+        return;
+    }
+    hrt_->load(in);
+    for (SharedATMember* m : members_) m->load(in);
+    for (AutomatonLanes& lanes : lanes_) lanes.invalidate();
+}
+
+bool same_hrt_geometry(const ATConfig& a, const ATConfig& b) {
+    if (a.hrt_kind != b.hrt_kind) return false;
+    switch (a.hrt_kind) {
+        case HRTKind::IHRT:
+        case HRTKind::GHR:  return true;
+        case HRTKind::HHRT: return a.hrt_entries == b.hrt_entries && a.hrt_index == b.hrt_index;
+        case HRTKind::AHRT:
+            return a.hrt_entries == b.hrt_entries && a.hrt_ways == b.hrt_ways &&
+                   a.hrt_replacement == b.hrt_replacement && a.hrt_index == b.hrt_index;
+    }
+    return false;
+}
+
+} // namespace bp
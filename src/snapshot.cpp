@@ -0,0 +1,156 @@
+#include "snapshot.hpp"
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bp {
+
+namespace {
+
+constexpr std::size_t kSnapshotAlign = 8;
+
+std::size_t padded(std::size_t n) {
+    return (n + kSnapshotAlign - 1) & ~(kSnapshotAlign - 1);
+}
+
+} // namespace
+
+// ======================= SnapshotWriter =======================
+
+SnapshotWriter::SnapshotWriter(const std::string& path) : path_(path) {
+    out_ = std::fopen(path.c_str(), "wb");
+    if (!out_) {
+        error_ = "could not create snapshot file '" + path + "'";
+        return;
+    }
+    write_header(); // placeholder, rewritten by finish()
+}
+
+SnapshotWriter::~SnapshotWriter() {
+    if (out_) std::fclose(out_);
+}
+
+void SnapshotWriter::write_header() {
+    SnapshotHeader h{};
+    std::memcpy(h.magic, kSnapshotMagic, sizeof(h.magic));
+    h.version       = kSnapshotVersion;
+    h.header_bytes  = sizeof(SnapshotHeader);
+    h.payload_bytes = payload_;
+    if (std::fwrite(&h, sizeof(h), 1, out_) != 1) {
+        error_ = "write error on '" + path_ + "'";
+    }
+}
+
+void SnapshotWriter::write_bytes(const void* data, std::size_t n) {
+    if (!ok()) return;
+    static const char zeros[kSnapshotAlign] = {};
+    const std::size_t pad = padded(n) - n;
+    if ((n != 0 && std::fwrite(data, 1, n, out_) != n) ||
+        (pad != 0 && std::fwrite(zeros, 1, pad, out_) != pad)) {
+        error_ = "write error on '" + path_ + "'";
+        return;
+    }
+    payload_ += n + pad;
+}
+
+bool SnapshotWriter::finish() {
+    if (!ok()) return false;
+    if (std::fseek(out_, 0, SEEK_SET) != 0) {
+        error_ = "seek error on '" + path_ + "'";
+        return false;
+    }
+    write_header();
+    if (std::fclose(out_) != 0 && ok()) error_ = "write error on '" + path_ + "'";
+    out_ = nullptr;
+    return ok();
+}
+
+// ======================= SnapshotReader =======================
+
+/**
+ * Map the whole file read-only and validate the header against the file
+ * size, so that no item can be read past the mapping.
+ */
+SnapshotReader::SnapshotReader(const std::string& path) : path_(path) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error_ = "could not open snapshot file '" + path + "'";
+        return;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<std::size_t>(st.st_size) < sizeof(SnapshotHeader)) {
+        ::close(fd);
+        error_ = "'" + path + "' is too small to be a snapshot";
+        return;
+    }
+
+    length_ = static_cast<std::size_t>(st.st_size);
+    base_   = ::mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base_ == MAP_FAILED) {
+        base_  = nullptr;
+        error_ = "could not mmap '" + path + "'";
+        return;
+    }
+
+    SnapshotHeader h;
+    std::memcpy(&h, base_, sizeof(h));
+    if (std::memcmp(h.magic, kSnapshotMagic, sizeof(h.magic)) != 0) {
+        error_ = "'" + path + "' is not a bp_sim snapshot";
+        return;
+    }
+    if (h.version != kSnapshotVersion || h.header_bytes != sizeof(SnapshotHeader)) {
+        error_ = "'" + path + "': unsupported snapshot version " + std::to_string(h.version);
+        return;
+    }
+    if (h.payload_bytes > length_ - h.header_bytes) {
+        error_ = "'" + path + "' is truncated";
+        return;
+    }
+    pos_ = h.header_bytes;
+    end_ = h.header_bytes + static_cast<std::size_t>(h.payload_bytes);
+}
+
+SnapshotReader::~SnapshotReader() {
+    if (base_) ::munmap(base_, length_);
+}
+
+void SnapshotReader::fail(const std::string& what) {
+    if (ok()) error_ = "'" + path_ + "': " + what;
+}
+
+const void* SnapshotReader::read_bytes(std::size_t n) {
+    if (!ok()) return nullptr;
+    if (padded(n) > remaining()) {
+        fail("truncated snapshot");
+        return nullptr;
+    }
+    const void* p = static_cast<const char*>(base_) + pos_;
+    pos_ += padded(n);
+    return p;
+}
+
+std::string SnapshotReader::read_string() {
+    std::vector<char> chars;
+    read_array(chars);
+    return std::string(chars.begin(), chars.end());
+}
+
+void SnapshotReader::expect_string(const std::string& want, const char* what) {
+    std::string got = read_string();
+    if (ok() && got != want) {
+        fail(std::string("snapshot holds ") + what + " '" + got + "', expected '" + want + "'");
+    }
+}
+
+void SnapshotReader::copy(void* dst, const void* src, std::size_t n) {
+    if (n != 0) std::memcpy(dst, src, n);
+}
+
+} // namespace bp
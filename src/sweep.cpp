@@ -0,0 +1,230 @@
+#include "sweep.hpp"
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace bp {
+
+bool run_serial(TraceSource& source, const std::vector<SimUnit*>& units) {
+    BlockBuffer storage;
+    TraceBlock  block;
+    while (source.next_block(storage, block)) {
+        for (SimUnit* u : units) u->run_block(block);
+    }
+    return source.ok();
+}
+
+namespace {
+
+/**
+ * Ring of decoded blocks shared between the producer and the workers.
+ *
+ * Block number `seq` lives in slots[seq % slots.size()]. The producer may
+ * only refill a slot once every worker has finished with its previous
+ * contents (pending == 0); a worker may only read block `seq` once
+ * produced > seq.
+ */
+struct BlockRing {
+    struct Slot {
+        BlockBuffer storage;
+        TraceBlock  block;
+        unsigned    pending = 0; // workers still reading this block
+    };
+
+    explicit BlockRing(std::size_t n) : slots(n) {}
+
+    std::vector<Slot>       slots;
+    std::mutex              mutex;
+    std::condition_variable filled;  // producer → workers
+    std::condition_variable drained; // workers → producer
+    std::uint64_t           produced = 0;
+    bool                    done     = false;
+};
+
+void worker_loop(BlockRing& ring, const std::vector<SimUnit*>& owned, int numa_node) {
+    if (numa_node >= 0) pin_thread_to_numa_node(static_cast<unsigned>(numa_node));
+    for (std::uint64_t seq = 0;; ++seq) {
+        BlockRing::Slot& slot = ring.slots[seq % ring.slots.size()];
+        {
+            std::unique_lock<std::mutex> lock(ring.mutex);
+            ring.filled.wait(lock, [&] { return ring.produced > seq || ring.done; });
+            if (ring.produced <= seq) return;
+        }
+
+        for (SimUnit* u : owned) u->run_block(slot.block);
+
+        std::lock_guard<std::mutex> lock(ring.mutex);
+        if (--slot.pending == 0) ring.drained.notify_one();
+    }
+}
+
+} // namespace
+
+bool run_parallel(TraceSource& source, const std::vector<SimUnit*>& units,
+                  unsigned threads) {
+    const unsigned workers =
+        static_cast<unsigned>(std::min<std::size_t>(threads, units.size()));
+    if (workers <= 1) return run_serial(source, units);
+
+    // Each worker owns a fixed subset of the units for the whole run, so
+    // every unit sees the blocks in trace order.
+    std::vector<std::vector<SimUnit*>> owned(workers);
+    std::size_t dealt = 0;
+    bool        homed = false;
+    for (SimUnit* u : units) {
+        const std::size_t w = (u->home_worker >= 0) ? static_cast<std::size_t>(u->home_worker)
+                                                    : dealt++;
+        owned[w % workers].push_back(u);
+        homed = homed || u->home_worker >= 0;
+    }
+    const bool pin = homed && numa_node_count() > 1;
+
+    // A few blocks per worker lets fast workers run ahead of slow ones.
+    BlockRing ring(2u * workers + 2u);
+
+    std::vector<std::thread> pool;
+    pool.reserve(workers);
+    for (unsigned w = 0; w < workers; ++w) {
+        pool.emplace_back(worker_loop, std::ref(ring), std::cref(owned[w]),
+                          pin ? static_cast<int>(worker_numa_node(w)) : -1);
+    }
+
+    for (std::uint64_t seq = 0;; ++seq) {
+        BlockRing::Slot& slot = ring.slots[seq % ring.slots.size()];
+        {
+            std::unique_lock<std::mutex> lock(ring.mutex);
+            ring.drained.wait(lock, [&] { return slot.pending == 0; });
+        }
+
+        if (!source.next_block(slot.storage, slot.block)) break;
+
+        {
+            std::lock_guard<std::mutex> lock(ring.mutex);
+            slot.pending = workers;
+            ++ring.produced;
+        }
+        ring.filled.notify_all();
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ring.mutex);
+        ring.done = true;
+    }
+    ring.filled.notify_all();
+    for (auto& t : pool) t.join();
+
+    return source.ok();
+}
+
+namespace {
+
+bool run_segment(TraceSource& source, std::uint64_t count,
+                 const std::vector<SimUnit*>& units, unsigned threads) {
+    std::unique_ptr<TraceSource> segment = limit_trace_source(source, count);
+    return (threads > 1) ? run_parallel(*segment, units, threads)
+                         : run_serial(*segment, units);
+}
+
+} // namespace
+
+bool run_sampled(TraceSource& source, const std::vector<SimUnit*>& units,
+                 const std::vector<Stats*>& reported, const std::vector<ATUnit*>& at_units,
+                 const SamplingPlan& plan, unsigned threads) {
+    std::vector<Stats> measured(reported.size());
+    std::vector<Stats> before(reported.size());
+    std::vector<Stats> intervals(reported.size());
+
+    // Like the Stats, the HRT counters count the measured intervals only:
+    // they start from zero and are put back after every other segment.
+    std::vector<HRTCounters> hrt_before(at_units.size());
+    auto save_hrt = [&] {
+        for (std::size_t i = 0; i < at_units.size(); ++i) {
+            hrt_before[i] = at_units[i]->hrt_counters();
+        }
+    };
+    auto restore_hrt = [&] {
+        for (std::size_t i = 0; i < at_units.size(); ++i) {
+            at_units[i]->set_hrt_counters(hrt_before[i]);
+        }
+    };
+    for (ATUnit* u : at_units) u->set_hrt_counters(HRTCounters{});
+
+    const std::uint64_t period_records = plan.period * plan.interval;
+    std::uint64_t       pos            = 0; // records consumed from source
+
+    for (std::uint64_t start = period_records - plan.interval;; start += period_records) {
+        // Fast-forward to the warm-up window; it never reaches back into
+        // the previous measured interval.
+        std::uint64_t warm_start = (start - pos > plan.warmup) ? start - plan.warmup : pos;
+        pos += source.skip(warm_start - pos);
+        if (pos != warm_start) break; // trace ended
+
+        for (std::size_t i = 0; i < reported.size(); ++i) before[i] = *reported[i];
+        save_hrt();
+        if (!run_segment(source, start - warm_start, units, threads)) break;
+        pos = start;
+
+        // Warm-up changes predictor state only: drop its counts.
+        for (std::size_t i = 0; i < reported.size(); ++i) *reported[i] = before[i];
+        restore_hrt();
+        if (!run_segment(source, plan.interval, units, threads)) break;
+
+        // An interval cut short by the end of the trace is not a sample:
+        // it would weigh as much as a full one in the mean and ci95().
+        bool full = true;
+        for (std::size_t i = 0; i < reported.size(); ++i) {
+            Stats& interval  = intervals[i];
+            interval.total   = reported[i]->total   - before[i].total;
+            interval.correct = reported[i]->correct - before[i].correct;
+            *reported[i]     = before[i];
+            full = full && interval.total == plan.interval;
+        }
+        if (!full) {
+            restore_hrt();
+            break;
+        }
+        for (std::size_t i = 0; i < reported.size(); ++i) measured[i].add_sample(intervals[i]);
+        pos += plan.interval;
+    }
+
+    for (std::size_t i = 0; i < reported.size(); ++i) *reported[i] = measured[i];
+    return source.ok();
+}
+
+bool save_snapshot(const std::string& path, const std::vector<SimUnit*>& units,
+                   std::string& error) {
+    SnapshotWriter out(path);
+    out.write<std::uint64_t>(units.size());
+    for (const SimUnit* u : units) u->save(out);
+    if (!out.finish()) {
+        error = out.error();
+        return false;
+    }
+    return true;
+}
+
+bool load_snapshot(const std::string& path, const std::vector<SimUnit*>& units,
+                   std::string& error) {
+    SnapshotReader in(path);
+    std::uint64_t count = 0;
+    in.read(count);
+    if (in.ok() && count != units.size()) {
+        in.fail("snapshot holds " + std::to_string(count) + " units, expected " +
+                std::to_string(units.size()));
+    }
+    for (SimUnit* u : units) {
+        if (!in.ok()) break;
+        u->load(in);
+    }
+    if (in.ok() && !in.at_end()) in.fail("trailing data after the last unit");
+    if (!in.ok()) {
+        error = in.error();
+        return false;
+    }
+    return true;
+}
+
+} // namespace bp
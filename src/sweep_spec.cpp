@@ -0,0 +1,579 @@
+#include "sweep_spec.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+
+namespace bp {
+
+std::vector<ATConfig> default_sweep() {
+    std::vector<ATConfig> configs;
+
+    // === HRT implementation exploration (similar to Fig. 6) ===
+    //
+    // Vary HRT type and size while keeping:
+    //   - k   = 12 bits of history
+    //   - PT  = 2^12 entries
+    //   - FSM = A2
+    configs.push_back({"AT_AHRT_256_12_A2", HRTKind::AHRT, 256, 4, 12, AutomatonType::A2});
+    configs.push_back({"AT_AHRT_512_12_A2", HRTKind::AHRT, 512, 4, 12, AutomatonType::A2});
+    configs.push_back({"AT_HHRT_256_12_A2", HRTKind::HHRT, 256, 1, 12, AutomatonType::A2});
+    configs.push_back({"AT_HHRT_512_12_A2", HRTKind::HHRT, 512, 1, 12, AutomatonType::A2});
+    configs.push_back({"AT_IHRT_12_A2",     HRTKind::IHRT,   0, 0, 12, AutomatonType::A2});
+
+    // === Automaton exploration (similar to Fig. 5) ===
+    //
+    // Keep HRT = AHRT(512, 12SR) constant and vary automaton:
+    configs.push_back({"AT_AHRT_512_12_LT", HRTKind::AHRT, 512, 4, 12, AutomatonType::LastTime});
+    configs.push_back({"AT_AHRT_512_12_A3", HRTKind::AHRT, 512, 4, 12, AutomatonType::A3});
+    configs.push_back({"AT_AHRT_512_12_A4", HRTKind::AHRT, 512, 4, 12, AutomatonType::A4});
+
+    // === History length exploration (similar to Fig. 7) ===
+    //
+    // Fix HRT = AHRT(512) and automaton = A2, vary k:
+    configs.push_back({"AT_AHRT_512_10_A2", HRTKind::AHRT, 512, 4, 10, AutomatonType::A2});
+    configs.push_back({"AT_AHRT_512_8_A2",  HRTKind::AHRT, 512, 4,  8, AutomatonType::A2});
+    configs.push_back({"AT_AHRT_512_6_A2",  HRTKind::AHRT, 512, 4,  6, AutomatonType::A2});
+
+    return configs;
+}
+
+namespace {
+
+const char* kind_name(HRTKind k) {
+    switch (k) {
+        case HRTKind::AHRT: return "AHRT";
+        case HRTKind::HHRT: return "HHRT";
+        case HRTKind::IHRT: return "IHRT";
+        case HRTKind::GHR:  return "GHR";
+    }
+    return "?";
+}
+
+const char* replacement_name(ReplacementPolicy p) {
+    switch (p) {
+        case ReplacementPolicy::RoundRobin: return "rr";
+        case ReplacementPolicy::LRU:        return "lru";
+        case ReplacementPolicy::TreePLRU:   return "plru";
+        case ReplacementPolicy::Random:     return "random";
+    }
+    return "?";
+}
+
+const char* index_name(IndexHash h) {
+    switch (h) {
+        case IndexHash::Low:     return "low";
+        case IndexHash::XorFold: return "xor";
+        case IndexHash::Mul:     return "mul";
+        case IndexHash::Skewed:  return "skew";
+    }
+    return "?";
+}
+
+bool is_pow2(long v) { return v > 0 && (v & (v - 1)) == 0; }
+
+std::vector<std::string> split(const std::string& s, char sep) {
+    std::vector<std::string> parts;
+    std::string cur;
+    std::istringstream in(s);
+    while (std::getline(in, cur, sep)) parts.push_back(cur);
+    if (!s.empty() && s.back() == sep) parts.push_back("");
+    return parts;
+}
+
+bool parse_int(const std::string& s, long& v) {
+    if (s.empty()) return false;
+    char* end = nullptr;
+    v = std::strtol(s.c_str(), &end, 10);
+    return *end == '\0';
+}
+
+/**
+ * Expand one numeric item: N, A..B, A..B:+S or A..B:xF. Ranges without a
+ * step use +1, or x2 when double_by_default is set.
+ */
+bool expand_range(const std::string& item, bool double_by_default,
+                  std::vector<long>& out, std::string& error) {
+    auto fail = [&] {
+        error = "bad number or range '" + item + "'";
+        return false;
+    };
+
+    std::size_t dots = item.find("..");
+    if (dots == std::string::npos) {
+        long v;
+        if (!parse_int(item, v)) return fail();
+        out.push_back(v);
+        return true;
+    }
+
+    std::string hi_str = item.substr(dots + 2);
+    std::string step_str;
+    std::size_t colon = hi_str.find(':');
+    if (colon != std::string::npos) {
+        step_str = hi_str.substr(colon + 1);
+        hi_str   = hi_str.substr(0, colon);
+    }
+
+    long lo, hi, step = 1;
+    bool multiply = double_by_default;
+    if (double_by_default) step = 2;
+    if (!parse_int(item.substr(0, dots), lo) || !parse_int(hi_str, hi)) return fail();
+    if (!step_str.empty()) {
+        if (step_str[0] == '+')      multiply = false;
+        else if (step_str[0] == 'x') multiply = true;
+        else return fail();
+        if (!parse_int(step_str.substr(1), step)) return fail();
+    }
+    if (lo > hi || lo <= 0 || (multiply ? step < 2 : step < 1)) return fail();
+
+    for (long v = lo; v <= hi; v = multiply ? v * step : v + step) out.push_back(v);
+    return true;
+}
+
+bool expand_list(const std::string& value, bool double_by_default,
+                 std::vector<long>& out, std::string& error) {
+    for (const std::string& item : split(value, ',')) {
+        if (!expand_range(item, double_by_default, out, error)) return false;
+    }
+    return true;
+}
+
+struct HRTChoice {
+    HRTKind kind;
+    long    entries;
+};
+
+bool parse_hrt(const std::string& value, std::vector<HRTChoice>& out, std::string& error) {
+    for (const std::string& item : split(value, ',')) {
+        std::size_t colon = item.find(':');
+        std::string kind  = item.substr(0, colon);
+        HRTKind k;
+        if      (kind == "AHRT") k = HRTKind::AHRT;
+        else if (kind == "HHRT") k = HRTKind::HHRT;
+        else if (kind == "IHRT") k = HRTKind::IHRT;
+        else if (kind == "GHR")  k = HRTKind::GHR;
+        else {
+            error = "unknown HRT kind '" + kind + "' (expected AHRT, HHRT, IHRT or GHR)";
+            return false;
+        }
+
+        std::vector<long> sizes;
+        if (k == HRTKind::IHRT || k == HRTKind::GHR) {
+            sizes.push_back(0);
+        } else if (colon == std::string::npos) {
+            sizes.push_back(512);
+        } else if (!expand_range(item.substr(colon + 1), true, sizes, error)) {
+            return false;
+        }
+        for (long e : sizes) out.push_back({k, e});
+    }
+    return true;
+}
+
+struct PTChoice {
+    PTSelect select;
+    long     sets; // PerSet: number of PTs
+};
+
+bool parse_pt(const std::string& value, std::vector<PTChoice>& out, std::string& error) {
+    for (const std::string& item : split(value, ',')) {
+        std::size_t colon = item.find(':');
+        std::string name  = item.substr(0, colon);
+        if (name == "global" && colon == std::string::npos) {
+            out.push_back({PTSelect::Global, 1});
+        } else if (name == "gshare" && colon == std::string::npos) {
+            out.push_back({PTSelect::Gshare, 1});
+        } else if (name == "set") {
+            std::vector<long> sets;
+            if (colon == std::string::npos) sets.push_back(16);
+            else if (!expand_range(item.substr(colon + 1), true, sets, error)) return false;
+            for (long n : sets) {
+                if (n < 2 || n > (1L << 30) || !is_pow2(n)) {
+                    error = "pt=set:N needs a power of two N in 2..2^30";
+                    return false;
+                }
+                out.push_back({PTSelect::PerSet, n});
+            }
+        } else {
+            error = "unknown PT selection '" + item + "' (expected global, set[:N] or gshare)";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parse_fsm(const std::string& value, std::vector<AutomatonType>& out, std::string& error) {
+    for (const std::string& item : split(value, ',')) {
+        AutomatonType a;
+        if (!find_automaton(item, a)) {
+            error = "unknown automaton '" + item + "' (expected LT, A2, A3, A4 or an --fsm name)";
+            return false;
+        }
+        out.push_back(a);
+    }
+    return true;
+}
+
+bool parse_repl(const std::string& value, std::vector<ReplacementPolicy>& out,
+                std::string& error) {
+    for (const std::string& item : split(value, ',')) {
+        if      (item == "rr")     out.push_back(ReplacementPolicy::RoundRobin);
+        else if (item == "lru")    out.push_back(ReplacementPolicy::LRU);
+        else if (item == "plru")   out.push_back(ReplacementPolicy::TreePLRU);
+        else if (item == "random") out.push_back(ReplacementPolicy::Random);
+        else {
+            error = "unknown replacement policy '" + item + "' (expected rr, lru, plru or random)";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parse_index(const std::string& value, std::vector<IndexHash>& out, std::string& error) {
+    for (const std::string& item : split(value, ',')) {
+        if      (item == "low")  out.push_back(IndexHash::Low);
+        else if (item == "xor")  out.push_back(IndexHash::XorFold);
+        else if (item == "mul")  out.push_back(IndexHash::Mul);
+        else if (item == "skew") out.push_back(IndexHash::Skewed);
+        else {
+            error = "unknown HRT index '" + item + "' (expected low, xor, mul or skew)";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parse_layout(const std::string& value, std::vector<PTLayout>& out, std::string& error) {
+    for (const std::string& item : split(value, ',')) {
+        if      (item == "bytes")  out.push_back(PTLayout::Bytes);
+        else if (item == "packed") out.push_back(PTLayout::Packed);
+        else {
+            error = "unknown PT layout '" + item + "' (expected bytes or packed)";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool validate(const ATConfig& c, std::string& error) {
+    if (c.history_bits < 1 || c.history_bits > kMaxHistoryBits) {
+        error = "k must be in 1..64";
+        return false;
+    }
+    if (c.pt_index_bits < 0 || c.pt_index_bits > 30) {
+        error = "ptbits must be in 0..30";
+        return false;
+    }
+    if (c.pt_select == PTSelect::PerSet && c.history_bits + c.pt_set_bits > kMaxHistoryBits) {
+        error = "pt=set needs k + log2(sets) <= 64";
+        return false;
+    }
+    if (c.hrt_kind == HRTKind::IHRT || c.hrt_kind == HRTKind::GHR) return true;
+    if (!is_pow2(c.hrt_entries)) {
+        error = std::string(kind_name(c.hrt_kind)) + " entries must be a power of two";
+        return false;
+    }
+    if (c.hrt_kind == HRTKind::AHRT &&
+        (!is_pow2(c.hrt_ways) || c.hrt_ways > c.hrt_entries || c.hrt_ways > 256)) {
+        error = "AHRT ways must be a power of two, at most 256 and at most the entry count";
+        return false;
+    }
+    if (c.hrt_replacement == ReplacementPolicy::LRU && c.hrt_ways > LRUPolicy::kMaxWays) {
+        error = "repl=lru supports at most 16 ways";
+        return false;
+    }
+    if (c.hrt_replacement == ReplacementPolicy::TreePLRU && c.hrt_ways > TreePLRUPolicy::kMaxWays) {
+        error = "repl=plru supports at most 64 ways";
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+std::string sweep_config_name(const ATConfig& c) {
+    std::string name = std::string("AT_") + kind_name(c.hrt_kind) + "_";
+    if (c.hrt_kind != HRTKind::IHRT && c.hrt_kind != HRTKind::GHR) {
+        name += std::to_string(c.hrt_entries);
+        if (c.hrt_kind == HRTKind::AHRT && c.hrt_ways != 4) {
+            name += "x" + std::to_string(c.hrt_ways);
+        }
+        name += "_";
+    }
+    name += std::to_string(c.history_bits) + "_" + automaton_name(c.automaton);
+    if (c.hrt_kind == HRTKind::AHRT && c.hrt_replacement != ReplacementPolicy::RoundRobin) {
+        name += std::string("_") + replacement_name(c.hrt_replacement);
+    }
+    if (c.hrt_kind != HRTKind::IHRT && c.hrt_index != IndexHash::Low) {
+        name += std::string("_") + index_name(c.hrt_index);
+    }
+    if (c.pt_select == PTSelect::PerSet) name += "_s" + std::to_string(1L << c.pt_set_bits);
+    if (c.pt_select == PTSelect::Gshare) name += "_gshare";
+    if (c.pt_index_bits != 0 && c.pt_index_bits < c.history_bits) {
+        name += "_pt" + std::to_string(c.pt_index_bits);
+    }
+    if (c.pt_layout == PTLayout::Packed) name += "_packed";
+    return name;
+}
+
+bool parse_sweep_spec(const std::string& spec, std::vector<ATConfig>& out,
+                      std::string& error) {
+    std::set<std::string> seen;
+    for (const auto& c : out) seen.insert(c.name);
+
+    auto add = [&](const ATConfig& c) {
+        if (seen.insert(c.name).second) out.push_back(c);
+    };
+
+    std::istringstream terms(spec);
+    std::string term;
+
+    std::vector<HRTChoice>     hrts;
+    std::vector<long>          ways, ks, ptbits;
+    std::vector<AutomatonType> fsms;
+    std::vector<PTLayout>      layouts;
+    std::vector<ReplacementPolicy> repls;
+    std::vector<IndexHash>         indices;
+    std::vector<PTChoice>          pts;
+    bool any_key = false;
+
+    while (terms >> term) {
+        if (term == "default") {
+            for (const auto& c : default_sweep()) add(c);
+            continue;
+        }
+
+        std::size_t eq = term.find('=');
+        if (eq == std::string::npos) {
+            error = "expected key=value, got '" + term + "'";
+            return false;
+        }
+        const std::string key   = term.substr(0, eq);
+        const std::string value = term.substr(eq + 1);
+        any_key = true;
+
+        bool ok;
+        if      (key == "hrt")    ok = parse_hrt(value, hrts, error);
+        else if (key == "ways")   ok = expand_list(value, false, ways, error);
+        else if (key == "k")      ok = expand_list(value, false, ks, error);
+        else if (key == "fsm")    ok = parse_fsm(value, fsms, error);
+        else if (key == "ptbits") ok = expand_list(value, false, ptbits, error);
+        else if (key == "layout") ok = parse_layout(value, layouts, error);
+        else if (key == "repl")   ok = parse_repl(value, repls, error);
+        else if (key == "index")  ok = parse_index(value, indices, error);
+        else if (key == "pt")     ok = parse_pt(value, pts, error);
+        else {
+            error = "unknown key '" + key + "'";
+            return false;
+        }
+        if (!ok) return false;
+    }
+    if (!any_key) return true;
+
+    if (hrts.empty())    hrts.push_back({HRTKind::AHRT, 512});
+    if (ways.empty())    ways.push_back(4);
+    if (ks.empty())      ks.push_back(12);
+    if (fsms.empty())    fsms.push_back(AutomatonType::A2);
+    if (ptbits.empty())  ptbits.push_back(0);
+    if (layouts.empty()) layouts.push_back(PTLayout::Bytes);
+    if (repls.empty())   repls.push_back(ReplacementPolicy::RoundRobin);
+    if (indices.empty()) indices.push_back(IndexHash::Low);
+    if (pts.empty())     pts.push_back({PTSelect::Global, 1});
+
+    // An HHRT left with no index but skew would vanish from the sweep.
+    const bool only_skew = std::all_of(indices.begin(), indices.end(),
+                                       [](IndexHash x) { return x == IndexHash::Skewed; });
+    const bool has_hhrt  = std::any_of(hrts.begin(), hrts.end(),
+                                       [](const HRTChoice& h) { return h.kind == HRTKind::HHRT; });
+    if (only_skew && has_hhrt) {
+        error = "index=skew applies to AHRT only (HHRT has no ways); add another index for HHRT";
+        return false;
+    }
+
+    // Every point of the grid; repl only varies AHRT configs (others keep
+    // round-robin and collapse by name), index only AHRT and HHRT configs,
+    // and HHRT skips the skewed index. pt applies to every kind.
+    for (const HRTChoice& h : hrts)
+    for (ReplacementPolicy r : repls)
+    for (IndexHash x : indices)
+    for (const PTChoice& p : pts)
+    for (long w : ways)
+    for (long k : ks)
+    for (AutomatonType a : fsms)
+    for (long pb : ptbits)
+    for (PTLayout l : layouts) {
+        ATConfig c{"", h.kind, static_cast<int>(h.entries), 0, static_cast<int>(k), a};
+        c.hrt_ways        = (h.kind == HRTKind::AHRT) ? static_cast<int>(w)
+                          : (h.kind == HRTKind::HHRT) ? 1 : 0;
+        c.pt_index_bits   = static_cast<int>(pb);
+        c.pt_layout       = l;
+        c.hrt_replacement = (h.kind == HRTKind::AHRT) ? r : ReplacementPolicy::RoundRobin;
+        c.hrt_index       = (h.kind == HRTKind::IHRT || h.kind == HRTKind::GHR) ? IndexHash::Low : x;
+        c.pt_select       = p.select;
+        c.pt_set_bits     = index_bits_for(static_cast<int>(p.sets));
+        if (h.kind == HRTKind::HHRT && x == IndexHash::Skewed) continue;
+        if (!validate(c, error)) return false;
+        c.name = sweep_config_name(c);
+        add(c);
+    }
+    return true;
+}
+
+bool parse_hybrid_spec(const std::string& spec, const std::vector<ATConfig>& configs,
+                       std::vector<HybridConfig>& out, std::string& error) {
+    std::set<std::string> seen;
+    for (const auto& h : out) seen.insert(h.name);
+
+    std::istringstream terms(spec);
+    std::string term;
+
+    std::vector<std::string> ats;
+    std::vector<long>        metas;
+    std::vector<bool>        filters;
+    while (terms >> term) {
+        std::size_t eq = term.find('=');
+        if (eq == std::string::npos) {
+            error = "expected key=value, got '" + term + "'";
+            return false;
+        }
+        const std::string key   = term.substr(0, eq);
+        const std::string value = term.substr(eq + 1);
+
+        if (key == "at") {
+            for (const std::string& item : split(value, ',')) {
+                if (item == "all") {
+                    for (const auto& c : configs) ats.push_back(c.name);
+                    continue;
+                }
+                bool found = false;
+                for (const auto& c : configs) found = found || c.name == item;
+                if (!found) {
+                    error = "hybrid component '" + item + "' is not a configuration of the sweep";
+                    return false;
+                }
+                ats.push_back(item);
+            }
+        } else if (key == "meta") {
+            if (!expand_list(value, false, metas, error)) return false;
+        } else if (key == "filter") {
+            for (const std::string& item : split(value, ',')) {
+                if      (item == "off") filters.push_back(false);
+                else if (item == "on")  filters.push_back(true);
+                else {
+                    error = "unknown filter '" + item + "' (expected off or on)";
+                    return false;
+                }
+            }
+        } else {
+            error = "unknown hybrid key '" + key + "' (expected at, meta or filter)";
+            return false;
+        }
+    }
+    if (ats.empty()) {
+        error = "hybrid spec needs at=NAME[,NAME...]";
+        return false;
+    }
+    if (metas.empty())   metas.push_back(12);
+    if (filters.empty()) filters.push_back(false);
+
+    for (const std::string& at : ats)
+    for (long m : metas)
+    for (bool f : filters) {
+        if (m < 1 || m > 24) {
+            error = "meta must be in 1..24";
+            return false;
+        }
+        HybridConfig h;
+        h.at_scheme   = at;
+        h.meta_bits   = static_cast<int>(m);
+        h.bias_filter = f;
+        h.name        = "Hybrid_" + at + "_M" + std::to_string(m) + (f ? "_F" : "");
+        if (seen.insert(h.name).second) out.push_back(h);
+    }
+    return true;
+}
+
+bool parse_fsm_spec(const std::string& spec, AutomatonType& out, std::string& error) {
+    std::istringstream terms(spec);
+    std::string term;
+
+    std::string       name;
+    std::vector<long> taken, not_taken, predict, init;
+    while (terms >> term) {
+        std::size_t eq = term.find('=');
+        if (eq == std::string::npos) {
+            error = "expected key=value, got '" + term + "'";
+            return false;
+        }
+        const std::string key   = term.substr(0, eq);
+        const std::string value = term.substr(eq + 1);
+
+        if      (key == "name")    name = value;
+        else if (key == "taken")   { if (!expand_list(value, false, taken, error)) return false; }
+        else if (key == "not")     { if (!expand_list(value, false, not_taken, error)) return false; }
+        else if (key == "predict") { if (!expand_list(value, false, predict, error)) return false; }
+        else if (key == "init")    { if (!expand_list(value, false, init, error)) return false; }
+        else {
+            error = "unknown automaton key '" + key + "' (expected name, taken, not, predict or init)";
+            return false;
+        }
+    }
+    if (name.empty() || taken.empty() || predict.empty()) {
+        error = "automaton spec needs name=, taken=, not= and predict=";
+        return false;
+    }
+    if (taken.size() != not_taken.size() || taken.size() > kMaxAutomatonStates ||
+        init.size() > 1) {
+        error = "automaton '" + name + "' needs one taken= and not= state per state (at most " +
+                std::to_string(kMaxAutomatonStates) + ") and at most one init=";
+        return false;
+    }
+
+    // Out-of-range numbers are clamped to kMaxAutomatonStates, which
+    // define_automaton() then rejects with the rest.
+    auto state = [](long v) {
+        const bool ok = v >= 0 && v < long{kMaxAutomatonStates};
+        return static_cast<std::uint8_t>(ok ? v : long{kMaxAutomatonStates});
+    };
+    AutomatonTable table{};
+    table.states = static_cast<std::uint8_t>(taken.size());
+    table.init   = init.empty() ? static_cast<std::uint8_t>(table.states - 1) : state(init[0]);
+    for (std::size_t s = 0; s < taken.size(); ++s) {
+        table.delta[s][0] = state(not_taken[s]);
+        table.delta[s][1] = state(taken[s]);
+    }
+    for (long s : predict) {
+        if (state(s) >= table.states) {
+            error = "automaton '" + name + "' predicts with state " + std::to_string(s) +
+                    " of 0.." + std::to_string(table.states - 1);
+            return false;
+        }
+        table.taken_states = static_cast<std::uint16_t>(table.taken_states | (1u << s));
+    }
+    return define_automaton(name, table, out, error);
+}
+
+bool load_sweep_file(const std::string& path, std::vector<ATConfig>& out,
+                     std::string& error) {
+    std::ifstream in(path);
+    if (!in) {
+        error = "could not open sweep file '" + path + "'";
+        return false;
+    }
+
+    std::string line;
+    for (int lineno = 1; std::getline(in, line); ++lineno) {
+        std::size_t hash = line.find('#');
+        if (hash != std::string::npos) line.resize(hash);
+        if (!parse_sweep_spec(line, out, error)) {
+            error = path + ": line " + std::to_string(lineno) + ": " + error;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace bp
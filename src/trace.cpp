@@ -0,0 +1,916 @@
+#include "trace.hpp"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstring>
+#include <limits>
+#include <mutex>
+#include <thread>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace bp {
+
+// ======================= Format helpers =======================
+
+std::uint64_t new_branch_id_space() {
+    static std::atomic<std::uint64_t> next{1}; // 0: no space
+    return next.fetch_add(1, std::memory_order_relaxed);
+}
+
+namespace {
+
+// Bytes of the zero-padded ID array of a version 2 file.
+std::uint64_t id_array_bytes(std::uint64_t records) {
+    return (records * sizeof(BranchId) + 7u) / 8u * 8u;
+}
+
+bool ids_below(const BranchId* ids, std::uint64_t n, std::uint64_t limit) {
+    BranchId max = 0;
+    for (std::uint64_t i = 0; i < n; ++i) max = std::max(max, ids[i]);
+    return n == 0 || max < limit;
+}
+
+} // namespace
+
+bool is_binary_trace(const std::string& path) {
+    // Never open a FIFO or device here: reading it would consume the input.
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0 || !S_ISREG(st.st_mode)) return false;
+    std::FILE* f = std::fopen(path.c_str(), "rb");
+    if (!f) return false;
+    char magic[sizeof(kBinaryTraceMagic)];
+    bool match = std::fread(magic, 1, sizeof(magic), f) == sizeof(magic) &&
+                 std::memcmp(magic, kBinaryTraceMagic, sizeof(magic)) == 0;
+    std::fclose(f);
+    return match;
+}
+
+// ======================= MappedTrace =======================
+
+/**
+ * Map the whole file read-only and validate the header against the file
+ * size, so that iterating pcs()/outcome() can never run past the mapping.
+ */
+MappedTrace::MappedTrace(const std::string& path, Access access) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        error_ = "could not open trace file '" + path + "'";
+        return;
+    }
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<std::size_t>(st.st_size) < sizeof(BinaryTraceHeader)) {
+        ::close(fd);
+        error_ = "'" + path + "' is too small to be a binary trace";
+        return;
+    }
+
+    length_ = static_cast<std::size_t>(st.st_size);
+    base_   = ::mmap(nullptr, length_, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (base_ == MAP_FAILED) {
+        base_  = nullptr;
+        error_ = "mmap failed for '" + path + "'";
+        return;
+    }
+    ::madvise(base_, length_, access == Access::Sequential ? MADV_SEQUENTIAL : MADV_WILLNEED);
+
+    BinaryTraceHeader hdr;
+    std::memcpy(&hdr, base_, sizeof(hdr));
+    if (std::memcmp(hdr.magic, kBinaryTraceMagic, sizeof(hdr.magic)) != 0) {
+        error_ = "'" + path + "' is not a binary trace (bad magic)";
+        return;
+    }
+    if (hdr.version != kBinaryTraceVersion && hdr.version != kBinaryTraceVersionV1) {
+        error_ = "'" + path + "' has unsupported binary trace version " +
+                 std::to_string(hdr.version);
+        return;
+    }
+
+    // Overflow-safe: every count is checked against the file size first.
+    const bool          v2    = hdr.version == kBinaryTraceVersion;
+    const std::uint64_t words = (hdr.record_count + 63u) / 64u;
+    const std::uint64_t limit = length_ / sizeof(std::uint64_t);
+    bool sane = hdr.header_bytes >= sizeof(BinaryTraceHeader) &&
+                hdr.header_bytes % sizeof(std::uint64_t) == 0 &&
+                hdr.record_count <= limit * 2 && hdr.static_branches <= limit;
+    if (sane) {
+        const std::uint64_t body = v2 ? id_array_bytes(hdr.record_count) +
+                                            (words + hdr.static_branches) * sizeof(std::uint64_t)
+                                      : (hdr.record_count + words) * sizeof(std::uint64_t);
+        sane = hdr.header_bytes + body <= length_ &&
+               (!v2 || hdr.static_branches != 0 || hdr.record_count == 0);
+    }
+    if (!sane) {
+        error_ = "'" + path + "' is truncated or has a corrupt header";
+        return;
+    }
+
+    const char* bytes = static_cast<const char*>(base_) + hdr.header_bytes;
+    records_          = hdr.record_count;
+    static_branches_  = hdr.static_branches;
+    version_          = hdr.version;
+    if (v2) {
+        ids_        = reinterpret_cast<const BranchId*>(bytes);
+        outcomes_   = reinterpret_cast<const std::uint64_t*>(bytes + id_array_bytes(records_));
+        branch_pcs_ = outcomes_ + words;
+    } else {
+        pcs_      = reinterpret_cast<const std::uint64_t*>(bytes);
+        outcomes_ = pcs_ + records_;
+    }
+}
+
+bool MappedTrace::ids_valid(std::uint64_t first, std::uint64_t n) const {
+    return ids_below(ids_ + first, n, static_branches_);
+}
+
+MappedTrace::~MappedTrace() {
+    if (base_) ::munmap(base_, length_);
+}
+
+// ======================= TextTraceReader =======================
+
+TextTraceReader::TextTraceReader(const std::string& path)
+    : TextTraceReader(open_byte_stream(path)) {}
+
+TextTraceReader::TextTraceReader(std::unique_ptr<ByteStream> input)
+    : input_(std::move(input)),
+      buf_(kBufferBytes),
+      path_(input_->name())
+{
+    if (!input_->ok()) error_ = input_->error();
+}
+
+TextTraceReader::~TextTraceReader() = default;
+
+/**
+ * Move the unparsed tail of the buffer to the front and fill the rest with
+ * a single read. Returns false once no more bytes can be read.
+ */
+bool TextTraceReader::refill() {
+    if (eof_) return false;
+
+    std::size_t tail = end_ - pos_;
+    if (tail != 0 && pos_ != 0) std::memmove(buf_.data(), buf_.data() + pos_, tail);
+    pos_ = 0;
+    end_ = tail;
+
+    if (end_ < buf_.size()) {
+        std::size_t n = input_->read(buf_.data() + end_, buf_.size() - end_);
+        if (n == 0) {
+            eof_ = true;
+            if (!input_->ok()) {
+                error_ = input_->error();
+                return false;
+            }
+        }
+        end_ += n;
+    }
+    return end_ > tail;
+}
+
+namespace {
+
+inline bool is_blank(char c) { return c == ' ' || c == '\t' || c == '\r'; }
+
+inline int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+} // namespace
+
+/**
+ * Parse one line [p, e) (without the newline). Blank lines are reported as
+ * "no record" by returning false with error_ left empty.
+ */
+bool TextTraceReader::parse_line(const char* p, const char* e,
+                                 std::uint64_t& pc, Outcome& o) {
+    while (p < e && is_blank(*p)) ++p;
+    if (p == e) return false;
+
+    auto fail = [&](const char* what) {
+        error_ = path_ + ": line " + std::to_string(line_) + ": " + what +
+                 " (expected <pc_hex> <taken_bit_0_or_1>)";
+        return false;
+    };
+
+    if (e - p >= 2 && p[0] == '0' && (p[1] == 'x' || p[1] == 'X')) p += 2;
+
+    std::uint64_t value  = 0;
+    int           digits = 0;
+    for (int d; p < e && (d = hex_value(*p)) >= 0; ++p, ++digits) {
+        if (digits == 16) return fail("PC does not fit in 64 bits");
+        value = (value << 4) | static_cast<std::uint64_t>(d);
+    }
+    if (digits == 0) return fail("malformed PC");
+
+    const char* sep = p;
+    while (p < e && is_blank(*p)) ++p;
+    if (p == sep || p == e) return fail("missing taken bit");
+    if (*p != '0' && *p != '1') return fail("malformed taken bit");
+    o = (*p == '1') ? Outcome::Taken : Outcome::NotTaken;
+    ++p;
+
+    while (p < e && is_blank(*p)) ++p;
+    if (p != e) return fail("trailing characters");
+
+    pc = value;
+    return true;
+}
+
+std::size_t TextTraceReader::read_block(std::uint64_t* pcs, Outcome* outs,
+                                        std::size_t max) {
+    std::size_t n = 0;
+    while (n < max && ok()) {
+        const char* base = buf_.data();
+        const char* nl   = static_cast<const char*>(
+            std::memchr(base + pos_, '\n', end_ - pos_));
+
+        const char* line_end;
+        if (nl) {
+            line_end = nl;
+        } else if (refill()) {
+            continue; // retry with more data in the buffer
+        } else if (!ok()) {
+            break;
+        } else if (pos_ == end_) {
+            break;    // clean end of file
+        } else if (end_ == buf_.size()) {
+            ++line_;
+            error_ = path_ + ": line " + std::to_string(line_) + ": line too long";
+            break;
+        } else {
+            line_end = base + end_; // last line without a trailing newline
+        }
+
+        ++line_;
+        if (parse_line(base + pos_, line_end, pcs[n], outs[n])) ++n;
+        pos_ = static_cast<std::size_t>(line_end - base) + (nl ? 1u : 0u);
+    }
+    return n;
+}
+
+// ======================= BinaryTraceWriter =======================
+
+BinaryTraceWriter::BinaryTraceWriter(const std::string& path) {
+    out_ = std::fopen(path.c_str(), "wb");
+    if (!out_) {
+        error_ = "could not create '" + path + "'";
+        return;
+    }
+    // Large stdio buffer: IDs are streamed 4 bytes at a time.
+    std::setvbuf(out_, nullptr, _IOFBF, 1u << 20);
+    write_header(); // placeholder, rewritten by finish()
+}
+
+BinaryTraceWriter::~BinaryTraceWriter() {
+    if (out_) std::fclose(out_);
+}
+
+void BinaryTraceWriter::write_header() {
+    BinaryTraceHeader hdr;
+    std::memcpy(hdr.magic, kBinaryTraceMagic, sizeof(hdr.magic));
+    hdr.version         = kBinaryTraceVersion;
+    hdr.header_bytes    = sizeof(BinaryTraceHeader);
+    hdr.record_count    = records_;
+    hdr.static_branches = branches_.size();
+    if (std::fwrite(&hdr, sizeof(hdr), 1, out_) != 1) {
+        error_ = "write failed";
+    }
+}
+
+void BinaryTraceWriter::append(std::uint64_t pc, Outcome o) {
+    if (!ok()) return;
+
+    const BranchId id = branches_.id(pc);
+    if (id == kNoBranchId) {
+        error_ = "too many static branches for 32-bit branch IDs";
+        return;
+    }
+    if ((records_ & 63u) == 0) outcome_words_.push_back(0);
+    if (o == Outcome::Taken) {
+        outcome_words_.back() |= std::uint64_t{1} << (records_ & 63u);
+    }
+    ++records_;
+
+    if (std::fwrite(&id, sizeof(id), 1, out_) != 1) {
+        error_ = "write failed";
+    }
+}
+
+bool BinaryTraceWriter::finish() {
+    if (!out_) return ok();
+
+    const std::uint64_t zero = 0;
+    const std::size_t   pad  = static_cast<std::size_t>(id_array_bytes(records_) -
+                                                        records_ * sizeof(BranchId));
+    auto write = [&](const void* data, std::size_t bytes) {
+        if (ok() && bytes != 0 && std::fwrite(data, 1, bytes, out_) != bytes) {
+            error_ = "write failed";
+        }
+    };
+    write(&zero, pad);
+    write(outcome_words_.data(), outcome_words_.size() * sizeof(std::uint64_t));
+    write(branches_.pcs().data(), branches_.size() * sizeof(std::uint64_t));
+    if (ok()) {
+        std::rewind(out_);
+        write_header();
+    }
+    if (std::fclose(out_) != 0 && ok()) {
+        error_ = "close failed";
+    }
+    out_ = nullptr;
+    return ok();
+}
+
+// ======================= TraceSource =======================
+
+std::uint64_t TraceSource::skip(std::uint64_t n) {
+    BlockBuffer   storage;
+    TraceBlock    block;
+    std::uint64_t skipped = 0;
+    while (skipped < n) {
+        // Never decode past the skip target: shrink the last block.
+        std::uint64_t want = n - skipped;
+        if (want < storage.size()) storage.resize(static_cast<std::size_t>(want));
+        if (!next_block(storage, block)) break;
+        skipped += block.n;
+    }
+    return skipped;
+}
+
+namespace {
+
+/**
+ * Binary traces. Version 2: IDs are handed out in place and each block's
+ * PCs are looked up from the PC table, which also checks the IDs. Version
+ * 1: PCs are handed out in place and numbered into the caller's buffer.
+ * Only the packed outcome bits are expanded in both.
+ */
+class MappedTraceSource : public TraceSource {
+public:
+    // The trace is consumed front to back exactly once.
+    explicit MappedTraceSource(const std::string& path)
+        : trace_(path, MappedTrace::Access::Sequential),
+          branches_(static_cast<std::size_t>(trace_.static_branches())) {}
+
+    bool next_block(BlockBuffer& storage, TraceBlock& block) override {
+        if (!ok() || pos_ >= trace_.size()) return false;
+
+        std::uint64_t n = trace_.size() - pos_;
+        if (n > storage.size()) n = storage.size();
+
+        for (std::uint64_t i = 0; i < n; ++i) {
+            storage.outs[i] = trace_.outcome(pos_ + i);
+        }
+        if (const BranchId* ids = trace_.ids()) {
+            // One pass: an ID out of range reads entry 0 and fails the block.
+            const std::uint64_t* branch_pcs = trace_.branch_pcs();
+            const std::uint64_t  count      = trace_.static_branches();
+            bool                 bad        = false;
+            for (std::uint64_t i = 0; i < n; ++i) {
+                const BranchId id = ids[pos_ + i];
+                bad |= id >= count;
+                storage.pcs[i] = branch_pcs[id < count ? id : 0];
+            }
+            if (bad) {
+                error_ = "corrupt branch ID in binary trace";
+                return false;
+            }
+            block.pcs = storage.pcs.data();
+            block.ids = ids + pos_;
+        } else {
+            block.pcs = trace_.pcs() + pos_;
+            block.ids = branches_.number(block.pcs, storage.ids.data(), n) ? storage.ids.data()
+                                                                           : nullptr;
+        }
+        block.outs     = storage.outs.data();
+        block.n        = static_cast<std::size_t>(n);
+        block.id_space = id_space_;
+        pos_ += n;
+        return true;
+    }
+
+    // Skipped version 1 records are not numbered: IDs only have to agree
+    // among the records handed out.
+    std::uint64_t skip(std::uint64_t n) override {
+        if (!ok()) return 0;
+        std::uint64_t left = trace_.size() - pos_;
+        if (n > left) n = left;
+        pos_ += n;
+        return n;
+    }
+
+    std::uint64_t static_branches() const override { return trace_.static_branches(); }
+
+    bool ok() const override { return trace_.ok() && error_.empty(); }
+    const std::string& error() const override { return trace_.ok() ? error_ : trace_.error(); }
+
+private:
+    MappedTrace      trace_;
+    BranchDictionary branches_; // version 1
+    std::uint64_t    id_space_ = new_branch_id_space();
+    std::uint64_t    pos_      = 0;
+    std::string      error_;
+};
+
+// Text traces: records are parsed and numbered into the caller's buffer.
+class TextTraceSource : public TraceSource {
+public:
+    explicit TextTraceSource(std::unique_ptr<ByteStream> input) : reader_(std::move(input)) {}
+
+    bool next_block(BlockBuffer& storage, TraceBlock& block) override {
+        std::size_t n = reader_.read_block(storage.pcs.data(), storage.outs.data(),
+                                           storage.size());
+        block.pcs      = storage.pcs.data();
+        block.outs     = storage.outs.data();
+        block.n        = n;
+        block.ids      = branches_.number(block.pcs, storage.ids.data(), n) ? storage.ids.data()
+                                                                            : nullptr;
+        block.id_space = id_space_;
+        return n != 0;
+    }
+
+    bool ok() const override { return reader_.ok(); }
+    const std::string& error() const override { return reader_.error(); }
+
+private:
+    TextTraceReader  reader_;
+    BranchDictionary branches_;
+    std::uint64_t    id_space_ = new_branch_id_space();
+};
+
+/**
+ * Cursor over a LoadedTrace: PCs, IDs and decoded outcomes are handed out
+ * in place; mapped outcome bits are expanded, and the PCs of a mapped
+ * version 2 file looked up, into the caller's buffer.
+ */
+class LoadedTraceSource : public TraceSource {
+public:
+    LoadedTraceSource(const std::uint64_t* pcs, const Outcome* outs, const BranchId* ids,
+                      const MappedTrace* mapped, std::uint64_t records,
+                      std::uint64_t static_branches, std::uint64_t id_space)
+        : pcs_(pcs), outs_(outs), ids_(ids), mapped_(mapped), records_(records),
+          static_branches_(static_branches), id_space_(id_space) {}
+
+    bool next_block(BlockBuffer& storage, TraceBlock& block) override {
+        if (pos_ >= records_) return false;
+
+        std::uint64_t n = records_ - pos_;
+        if (n > storage.size()) n = storage.size();
+
+        if (outs_) {
+            block.outs = outs_ + pos_;
+        } else {
+            for (std::uint64_t i = 0; i < n; ++i) {
+                storage.outs[i] = mapped_->outcome(pos_ + i);
+            }
+            block.outs = storage.outs.data();
+        }
+        if (pcs_) {
+            block.pcs = pcs_ + pos_;
+        } else {
+            const std::uint64_t* branch_pcs = mapped_->branch_pcs();
+            for (std::uint64_t i = 0; i < n; ++i) storage.pcs[i] = branch_pcs[ids_[pos_ + i]];
+            block.pcs = storage.pcs.data();
+        }
+        block.ids      = ids_ ? ids_ + pos_ : nullptr;
+        block.id_space = id_space_;
+        block.n        = static_cast<std::size_t>(n);
+        pos_ += n;
+        return true;
+    }
+
+    std::uint64_t skip(std::uint64_t n) override {
+        std::uint64_t left = records_ - pos_;
+        if (n > left) n = left;
+        pos_ += n;
+        return n;
+    }
+
+    std::uint64_t static_branches() const override { return static_branches_; }
+
+    bool ok() const override { return true; }
+    const std::string& error() const override { return error_; }
+
+private:
+    const std::uint64_t* pcs_;    // nullptr: look up ids_ in mapped_
+    const Outcome*       outs_;   // nullptr: read bits from mapped_
+    const BranchId*      ids_;    // nullptr: no IDs
+    const MappedTrace*   mapped_;
+    std::uint64_t        records_;
+    std::uint64_t        static_branches_;
+    std::uint64_t        id_space_;
+    std::uint64_t        pos_ = 0;
+    std::string          error_;
+};
+
+/**
+ * Ends another source after a fixed number of records. Blocks are requested
+ * no larger than the remaining count, so the inner source is left exactly
+ * at the limit and can be read on afterwards.
+ */
+class LimitedTraceSource : public TraceSource {
+public:
+    LimitedTraceSource(TraceSource& inner, std::uint64_t count,
+                       std::unique_ptr<TraceSource> owned = nullptr)
+        : owned_(std::move(owned)), inner_(inner), left_(count) {}
+
+    bool next_block(BlockBuffer& storage, TraceBlock& block) override {
+        if (left_ == 0) return false;
+
+        bool got;
+        const std::size_t cap = storage.size();
+        if (left_ < cap) {
+            // Shrinking keeps the capacity, so block pointers into storage
+            // stay valid when the size is restored.
+            storage.resize(static_cast<std::size_t>(left_));
+            got = inner_.next_block(storage, block);
+            storage.resize(cap);
+        } else {
+            got = inner_.next_block(storage, block);
+        }
+        if (!got) return false;
+        left_ -= block.n;
+        return true;
+    }
+
+    std::uint64_t skip(std::uint64_t n) override {
+        std::uint64_t skipped = inner_.skip(n < left_ ? n : left_);
+        left_ -= skipped;
+        return skipped;
+    }
+
+    std::uint64_t static_branches() const override { return inner_.static_branches(); }
+
+    bool ok() const override { return inner_.ok(); }
+    const std::string& error() const override { return inner_.error(); }
+
+private:
+    std::unique_ptr<TraceSource> owned_; // set when the wrapper owns inner_
+    TraceSource&                 inner_;
+    std::uint64_t                left_;
+};
+
+/**
+ * Reads another source ahead on its own thread, into a bounded ring of
+ * kPrefetchBlocks decoded blocks, so that parsing and decompression
+ * overlap with the simulation.
+ *
+ * Blocks are copied into the caller's storage, which keeps the usual
+ * lifetime rule (valid until that storage is refilled) and lets a slot be
+ * reused as soon as it is handed out. The caller's storage size still
+ * bounds each block, as in LimitedTraceSource; a partly consumed slot is
+ * finished by the next calls. Branch IDs are numbered by the inner source,
+ * on the reading thread.
+ */
+class PrefetchTraceSource : public TraceSource {
+public:
+    explicit PrefetchTraceSource(std::unique_ptr<TraceSource> inner)
+        : inner_(std::move(inner)),
+          static_branches_(inner_->static_branches()),
+          slots_(kPrefetchBlocks),
+          worker_([this] { produce(); }) {}
+
+    ~PrefetchTraceSource() override {
+        {
+            std::lock_guard<std::mutex> lock(mu_);
+            stop_ = true;
+        }
+        space_.notify_all();
+        worker_.join();
+    }
+
+    bool next_block(BlockBuffer& storage, TraceBlock& block) override {
+        if (!acquire()) return false;
+        const TraceBlock& cur = slots_[head_ % slots_.size()].block;
+        const std::size_t n   = std::min(cur.n - offset_, storage.size());
+        std::copy_n(cur.pcs + offset_, n, storage.pcs.data());
+        std::copy_n(cur.outs + offset_, n, storage.outs.data());
+        if (cur.ids) std::copy_n(cur.ids + offset_, n, storage.ids.data());
+        block.pcs      = storage.pcs.data();
+        block.outs     = storage.outs.data();
+        block.ids      = cur.ids ? storage.ids.data() : nullptr;
+        block.id_space = cur.id_space;
+        block.n        = n;
+        consume(n);
+        return true;
+    }
+
+    std::uint64_t skip(std::uint64_t n) override {
+        std::uint64_t skipped = 0;
+        while (skipped < n && acquire()) {
+            const std::size_t left = slots_[head_ % slots_.size()].block.n - offset_;
+            const std::size_t take = static_cast<std::size_t>(std::min<std::uint64_t>(left, n - skipped));
+            consume(take);
+            skipped += take;
+        }
+        return skipped;
+    }
+
+    std::uint64_t static_branches() const override { return static_branches_; }
+
+    // The inner source's state is only read once it has finished.
+    bool ok() const override {
+        std::lock_guard<std::mutex> lock(mu_);
+        return !(done_ && ready_ == 0) || inner_->ok();
+    }
+
+    const std::string& error() const override {
+        std::lock_guard<std::mutex> lock(mu_);
+        return (done_ && ready_ == 0) ? inner_->error() : no_error_;
+    }
+
+private:
+    struct Slot {
+        BlockBuffer storage;
+        TraceBlock  block;
+    };
+
+    std::unique_ptr<TraceSource> inner_;
+    std::uint64_t                static_branches_;
+    std::vector<Slot>            slots_;
+
+    mutable std::mutex      mu_;
+    std::condition_variable space_;  // producer waits for a free slot
+    std::condition_variable filled_; // consumer waits for a block
+    std::size_t             head_   = 0; // next slot to consume
+    std::size_t             ready_  = 0; // filled slots not yet consumed
+    std::size_t             offset_ = 0; // records of slot head_ already handed out
+    bool                    done_   = false;
+    bool                    stop_   = false;
+    std::string             no_error_;
+
+    std::thread worker_; // last: started once everything above exists
+
+    void produce() {
+        for (std::size_t tail = 0;; ++tail) {
+            {
+                std::unique_lock<std::mutex> lock(mu_);
+                space_.wait(lock, [&] { return stop_ || ready_ < slots_.size(); });
+                if (stop_) return;
+            }
+            // The slot at tail is not visible to the consumer until ready_
+            // counts it, so it is filled without the lock.
+            Slot& s   = slots_[tail % slots_.size()];
+            bool  got = inner_->next_block(s.storage, s.block) && s.block.n != 0;
+            {
+                std::lock_guard<std::mutex> lock(mu_);
+                if (got) ++ready_;
+                else     done_ = true;
+            }
+            filled_.notify_one();
+            if (!got) return;
+        }
+    }
+
+    // Wait until slot head_ has records left; false at end of input.
+    bool acquire() {
+        std::unique_lock<std::mutex> lock(mu_);
+        filled_.wait(lock, [&] { return ready_ != 0 || done_; });
+        return ready_ != 0;
+    }
+
+    // Hand out n records of slot head_, releasing it once exhausted.
+    void consume(std::size_t n) {
+        offset_ += n;
+        std::unique_lock<std::mutex> lock(mu_);
+        if (offset_ < slots_[head_ % slots_.size()].block.n) return;
+        offset_ = 0;
+        ++head_;
+        --ready_;
+        lock.unlock();
+        space_.notify_one();
+    }
+};
+
+/**
+ * A LoadedTrace read from a stream, together with its cursor.
+ */
+class StreamedBinarySource : public TraceSource {
+public:
+    explicit StreamedBinarySource(std::unique_ptr<ByteStream> input)
+        : trace_(std::move(input)), cursor_(trace_.source()) {}
+
+    bool next_block(BlockBuffer& storage, TraceBlock& block) override {
+        return trace_.ok() && cursor_->next_block(storage, block);
+    }
+    std::uint64_t skip(std::uint64_t n) override { return trace_.ok() ? cursor_->skip(n) : 0; }
+    std::uint64_t static_branches() const override { return trace_.static_branches(); }
+
+    bool ok() const override { return trace_.ok(); }
+    const std::string& error() const override { return trace_.error(); }
+
+private:
+    LoadedTrace                  trace_;
+    std::unique_ptr<TraceSource> cursor_;
+};
+
+// True if input starts with the bptrace magic (without consuming it).
+bool has_binary_magic(ByteStream& input) {
+    char magic[sizeof(kBinaryTraceMagic)];
+    return input.peek(magic, sizeof(magic)) == sizeof(magic) &&
+           std::memcmp(magic, kBinaryTraceMagic, sizeof(magic)) == 0;
+}
+
+// Read exactly n bytes; false (with input's error, if any) when short.
+bool read_exact(ByteStream& input, void* dst, std::size_t n) {
+    char* p = static_cast<char*>(dst);
+    while (n != 0) {
+        std::size_t got = input.read(p, n);
+        if (got == 0) return false;
+        p += got;
+        n -= got;
+    }
+    return true;
+}
+
+/**
+ * Append n elements read from input to v, growing v one chunk at a time as
+ * the data arrives: a header claiming more than the stream holds then ends
+ * in a short read, not in one huge allocation.
+ */
+template <class T>
+bool read_array(ByteStream& input, std::vector<T>& v, std::uint64_t n) {
+    constexpr std::uint64_t kChunk = (std::uint64_t{1} << 20) / sizeof(T);
+    while (n != 0) {
+        const std::size_t chunk = static_cast<std::size_t>(std::min(n, kChunk));
+        const std::size_t at    = v.size();
+        v.resize(at + chunk);
+        if (!read_exact(input, v.data() + at, chunk * sizeof(T))) return false;
+        n -= chunk;
+    }
+    return true;
+}
+
+// Largest header_bytes accepted from a stream (mapped files are checked
+// against their size instead).
+constexpr std::uint32_t kMaxStreamHeaderBytes = 1u << 16;
+
+} // namespace
+
+std::unique_ptr<TraceSource> open_trace_source(const std::string& path) {
+    if (!is_stdin_path(path) && is_binary_trace(path)) {
+        return std::make_unique<MappedTraceSource>(path);
+    }
+    std::unique_ptr<ByteStream> input = open_byte_stream(path);
+    if (input->ok() && has_binary_magic(*input)) {
+        return std::make_unique<StreamedBinarySource>(std::move(input));
+    }
+    return std::make_unique<PrefetchTraceSource>(
+        std::make_unique<TextTraceSource>(std::move(input)));
+}
+
+std::unique_ptr<TraceSource> limit_trace_source(std::unique_ptr<TraceSource> source,
+                                                std::uint64_t count) {
+    TraceSource& inner = *source;
+    return std::make_unique<LimitedTraceSource>(inner, count, std::move(source));
+}
+
+std::unique_ptr<TraceSource> limit_trace_source(TraceSource& source, std::uint64_t count) {
+    return std::make_unique<LimitedTraceSource>(source, count);
+}
+
+// ======================= LoadedTrace =======================
+
+LoadedTrace::LoadedTrace(const std::string& path) {
+    if (!is_stdin_path(path) && is_binary_trace(path)) {
+        // Every work item on this trace walks the mapping again.
+        mapped_ = std::make_unique<MappedTrace>(path, MappedTrace::Access::Repeated);
+        if (!mapped_->ok()) {
+            error_ = mapped_->error();
+            return;
+        }
+        if (mapped_->ids() && !mapped_->ids_valid(0, mapped_->size())) {
+            error_ = "'" + path + "' has a corrupt branch ID";
+            return;
+        }
+        records_         = mapped_->size();
+        static_branches_ = mapped_->static_branches();
+        if (!mapped_->ids()) number_branches(mapped_->pcs(), static_branches_);
+        return;
+    }
+    std::unique_ptr<ByteStream> input = open_byte_stream(path);
+    if (input->ok() && has_binary_magic(*input)) read_binary(*input);
+    else                                         read_text(std::move(input));
+}
+
+LoadedTrace::LoadedTrace(std::unique_ptr<ByteStream> input) {
+    if (input->ok() && has_binary_magic(*input)) read_binary(*input);
+    else                                         read_text(std::move(input));
+}
+
+/**
+ * A binary trace that cannot be mapped (a pipe, a compressed file): the
+ * same checks as MappedTrace, as far as they go without the file size,
+ * then PCs, IDs and outcomes into the arrays, which grow only as the data
+ * arrives (read_array()).
+ */
+void LoadedTrace::read_binary(ByteStream& input) {
+    const std::string where = "'" + input.name() + "'";
+    auto fail = [&](const std::string& what) {
+        error_ = input.ok() ? where + " " + what : input.error();
+    };
+
+    BinaryTraceHeader hdr;
+    if (!read_exact(input, &hdr, sizeof(hdr))) return fail("is too small to be a binary trace");
+    if (hdr.version != kBinaryTraceVersion && hdr.version != kBinaryTraceVersionV1) {
+        return fail("has unsupported binary trace version " + std::to_string(hdr.version));
+    }
+    // Every record takes at least 4 bytes and every static branch 8, and
+    // each static branch appears in some record.
+    if (hdr.header_bytes < sizeof(BinaryTraceHeader) ||
+        hdr.header_bytes > kMaxStreamHeaderBytes ||
+        hdr.header_bytes % sizeof(std::uint64_t) != 0 ||
+        hdr.record_count > std::numeric_limits<std::uint64_t>::max() / 8u ||
+        hdr.static_branches > hdr.record_count ||
+        (hdr.version == kBinaryTraceVersion && hdr.static_branches == 0 &&
+         hdr.record_count != 0)) {
+        return fail("has a corrupt header");
+    }
+    std::vector<char> extra(hdr.header_bytes - sizeof(hdr));
+    if (!read_exact(input, extra.data(), extra.size())) return fail("is truncated");
+
+    const std::size_t          records = static_cast<std::size_t>(hdr.record_count);
+    const std::uint64_t        n_words = (hdr.record_count + 63u) / 64u;
+    std::vector<std::uint64_t> words;
+    records_ = hdr.record_count;
+    if (hdr.version == kBinaryTraceVersion) {
+        std::vector<std::uint64_t> branch_pcs;
+        if (!read_array(input, ids_, id_array_bytes(records) / sizeof(BranchId)) ||
+            !read_array(input, words, n_words) ||
+            !read_array(input, branch_pcs, hdr.static_branches)) {
+            ids_.clear();
+            records_ = 0;
+            return fail("is truncated");
+        }
+        ids_.resize(records);
+        if (!ids_below(ids_.data(), records, branch_pcs.size())) {
+            ids_.clear();
+            return fail("has a corrupt branch ID");
+        }
+        pcs_.resize(records);
+        for (std::size_t i = 0; i < records; ++i) pcs_[i] = branch_pcs[ids_[i]];
+    } else {
+        if (!read_array(input, pcs_, records) || !read_array(input, words, n_words)) {
+            pcs_.clear();
+            records_ = 0;
+            return fail("is truncated");
+        }
+        number_branches(pcs_.data(), hdr.static_branches);
+    }
+    outs_.resize(pcs_.size());
+    for (std::size_t i = 0; i < outs_.size(); ++i) {
+        outs_[i] = ((words[i >> 6] >> (i & 63u)) & 1u) ? Outcome::Taken : Outcome::NotTaken;
+    }
+    static_branches_ = hdr.static_branches;
+}
+
+void LoadedTrace::read_text(std::unique_ptr<ByteStream> input) {
+    TextTraceReader reader(std::move(input));
+    BlockBuffer     block;
+    while (std::size_t n = reader.read_block(block.pcs.data(), block.outs.data(),
+                                             block.size())) {
+        pcs_.insert(pcs_.end(), block.pcs.begin(), block.pcs.begin() + n);
+        outs_.insert(outs_.end(), block.outs.begin(), block.outs.begin() + n);
+    }
+    if (!reader.ok()) {
+        error_ = reader.error();
+        return;
+    }
+    records_         = pcs_.size();
+    static_branches_ = number_branches(pcs_.data(), 0);
+}
+
+/**
+ * IDs for the records_ PCs of a trace without stored ones, in one pass
+ * when it is loaded; returns the number of static branches. A trace with
+ * too many branches for 32-bit IDs is handed out without.
+ */
+std::size_t LoadedTrace::number_branches(const std::uint64_t* pcs, std::uint64_t expected) {
+    BranchDictionary branches(static_cast<std::size_t>(expected));
+    ids_.resize(static_cast<std::size_t>(records_));
+    if (!branches.number(pcs, ids_.data(), ids_.size())) ids_.clear();
+    return branches.size();
+}
+
+std::unique_ptr<TraceSource> LoadedTrace::source() const {
+    const BranchId* ids = !ids_.empty() ? ids_.data() : (mapped_ ? mapped_->ids() : nullptr);
+    if (mapped_) {
+        return std::make_unique<LoadedTraceSource>(mapped_->pcs(), nullptr, ids, mapped_.get(),
+                                                   records_, static_branches_, id_space_);
+    }
+    return std::make_unique<LoadedTraceSource>(pcs_.data(), outs_.data(), ids, nullptr,
+                                               records_, static_branches_, id_space_);
+}
+
+} // namespace bp
@@ -0,0 +1,65 @@
+/*
+ * Text → binary trace converter
+ * -----------------------------
+ * Converts a text trace (one "<pc_hex> <taken_bit_0_or_1>" record per line,
+ * the format documented in main.cpp) into the memory-mappable binary format
+ * described in include/trace.hpp: branch IDs plus a table of their PCs.
+ * The input may be anything bp_sim reads, so a version 1 binary trace is
+ * rewritten in version 2 the same way.
+ *
+ * Command line:
+ *   ./bp_trace_convert trace.txt trace.bptrace
+ *
+ * bp_sim detects binary traces by their magic number, so the converted file
+ * can be passed to it in place of the text trace.
+ */
+
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <string>
+
+#include "trace.hpp"
+
+using namespace bp;
+
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        std::cerr << "Usage: " << argv[0] << " trace.txt out.bptrace\n";
+        return 1;
+    }
+
+    const std::string in_file  = argv[1];
+    const std::string out_file = argv[2];
+
+    std::unique_ptr<TraceSource> in = open_trace_source(in_file);
+    if (!in->ok()) {
+        std::cerr << "Error: " << in->error() << "\n";
+        return 1;
+    }
+
+    BinaryTraceWriter out(out_file);
+    if (!out.ok()) {
+        std::cerr << "Error: " << out.error() << "\n";
+        return 1;
+    }
+
+    BlockBuffer storage;
+    TraceBlock  block;
+    while (in->next_block(storage, block)) {
+        for (std::size_t i = 0; i < block.n; ++i) out.append(block.pcs[i], block.outs[i]);
+    }
+    if (!in->ok()) {
+        std::cerr << "Error: " << in->error() << "\n";
+        return 1;
+    }
+
+    if (!out.finish()) {
+        std::cerr << "Error: " << out.error() << " while writing '" << out_file << "'\n";
+        return 1;
+    }
+
+    std::cout << "Converted " << out.size() << " records: "
+              << in_file << " -> " << out_file << "\n";
+    return 0;
+}
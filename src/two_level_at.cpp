@@ -1,79 +1,190 @@
 #include "two_level_at.hpp"
 
+#include <type_traits>
+
 namespace bp {
 
 /**
  * Construct a Two-Level AT predictor based on an ATConfig.
  *
  * We:
- *   1. Create the appropriate HRT (IHRT/AHRT/HHRT).
- *   2. Create a PatternTable with 2^k entries and the chosen automaton.
+ *   1. Create the appropriate HRT (IHRT/AHRT/HHRT, with its AHRT
+ *      replacement policy and index function).
+ *   2. Create a PatternTable with 2^k entries (2^(k+s) for PerSet), the
+ *      chosen automaton and storage layout.
  */
-TwoLevelATPredictor::TwoLevelATPredictor(const ATConfig& cfg)
+TwoLevelATPredictor::TwoLevelATPredictor(const ATConfig& cfg,
+                                         std::size_t expected_branches)
     : name_(cfg.name),
+      hrt_kind_(cfg.hrt_kind),
+      hrt_replacement_(cfg.hrt_replacement),
+      hrt_index_(cfg.hrt_index),
       history_bits_(cfg.history_bits),
-      mask_((1u << cfg.history_bits) - 1u),
-      pt_(cfg.history_bits, cfg.automaton)
-{
-    switch (cfg.hrt_kind) {
-        case HRTKind::IHRT:
-            hrt_ = std::make_unique<IHRTTable>(cfg.history_bits);
-            break;
-
-        case HRTKind::AHRT:
-            hrt_ = std::make_unique<AHRTTable>(
-                cfg.hrt_entries, cfg.hrt_ways, cfg.history_bits);
-            break;
-
-        case HRTKind::HHRT:
-            hrt_ = std::make_unique<HHRTTable>(
-                cfg.hrt_entries, cfg.history_bits);
-            break;
-    }
-}
+      mask_(history_mask(cfg.history_bits)),
+      select_(cfg.pt_select, cfg.history_bits, cfg.pt_set_bits),
+      pt_(select_.pattern_bits(), cfg.automaton, cfg.pt_layout, cfg.pt_index_bits),
+      hrt_(make_history_table(cfg.hrt_kind, cfg.hrt_entries, cfg.hrt_ways,
+                              cfg.hrt_replacement, cfg.hrt_index, cfg.history_bits,
+                              expected_branches))
+{}
 
 /**
  * Predict branch at PC:
- *   1. Look up k-bit history from HRT.
- *   2. Use that history to index the PT and predict via A(S_c).
+ *   1. Look up k-bit history from HRT (and remember the slot).
+ *   2. Use that history (or its PTSelector pattern) to index the PT and
+ *      predict via A(S_c).
  */
 bool TwoLevelATPredictor::predict(std::uint64_t pc) {
-    std::uint16_t h = hrt_->get(pc);
-    return pt_.predict(h);
+    pending_     = hrt_->lookup(pc);
+    pending_pc_  = pc;
+    has_pending_ = true;
+    return pt_.predict(select_.pattern(pending_.history, pc));
 }
 
 /**
  * Update predictor after the actual outcome is known:
  *
- *   1. old_h = HRT.get(pc)
+ *   1. slot = slot from predict(pc), or HRT.lookup(pc); old_h = slot.history
  *   2. PT.update(old_h, outcome)   // δ(S_c, R_{i,c})
  *   3. new_h = (old_h << 1 | bit) & mask_
- *   4. HRT.set(pc, new_h)
+ *   4. HRT.commit(slot, new_h)
  */
 void TwoLevelATPredictor::update(std::uint64_t pc, Outcome o) {
-    std::uint16_t old_h = hrt_->get(pc);
+    HRTSlot slot = (has_pending_ && pending_pc_ == pc) ? pending_ : hrt_->lookup(pc);
+    has_pending_ = false;
+
+    History old_h = slot.history;
 
     // Update pattern table using old history pattern.
-    pt_.update(old_h, o);
+    pt_.update(select_.pattern(old_h, pc), o);
 
     // Shift in the newest branch result into the k-bit history register.
-    std::uint16_t new_h = static_cast<std::uint16_t>(
-        ((old_h << 1) | (o == Outcome::Taken ? 1u : 0u)) & mask_);
-    hrt_->set(pc, new_h);
+    History new_h = ((old_h << 1) | (o == Outcome::Taken ? 1u : 0u)) & mask_;
+    hrt_->commit(slot, new_h);
 }
 
+namespace {
+
+/**
+ * Batched predict/update loop for a concrete HRT type. HRT is a final
+ * class, so lookup()/commit() bind statically and inline into the loop,
+ * and each branch performs a single HRT search. Observe: feed the PT
+ * aliasing sampler (only for the batches it samples). Plain: the PT is
+ * indexed by the history itself (PTSelect::Global), without select.
+ * ById: look branches up by ids[i] (HRT::kByBranchId tables only).
+ */
+template <bool Observe, bool Plain, bool ById, class HRT, class Collector>
+void run_loop(HRT& hrt, PatternTable& pt, const PTSelector& select, History mask,
+              const BranchId* ids, const std::uint64_t* pcs, const Outcome* outs,
+              std::size_t n, Stats& stats, Collector& collector) {
+    std::uint64_t correct = 0;
+    for (std::size_t i = 0; i < n; ++i) {
+        const std::uint64_t pc = pcs[i];
+        const Outcome       o  = outs[i];
+        const bool      taken  = (o == Outcome::Taken);
+
+        HRTSlot slot = lookup_branch<ById>(hrt, ids, i, pc);
+        History h    = slot.history;
+        History p    = Plain ? h : select.pattern(h, pc);
+        const bool hit = (pt.predict(p) == taken);
+        correct += hit ? 1u : 0u;
+        collector.record(pc, hit);
+
+        if constexpr (Observe) pt.observe(p, pc);
+        pt.update(p, o);
+        hrt.commit(slot, ((h << 1) | (taken ? 1u : 0u)) & mask);
+    }
+    stats.total   += n;
+    stats.correct += correct;
+}
+
+template <bool ById, class HRT, class Collector>
+void run_batch(HRT& hrt, PatternTable& pt, const PTSelector& select, History mask,
+               const BranchId* ids, const std::uint64_t* pcs, const Outcome* outs,
+               std::size_t n, Stats& stats, Collector& collector) {
+    const bool observe = pt.observe_batch();
+    if (select.plain()) {
+        if (observe) run_loop<true, true, ById>(hrt, pt, select, mask, ids, pcs, outs, n, stats, collector);
+        else         run_loop<false, true, ById>(hrt, pt, select, mask, ids, pcs, outs, n, stats, collector);
+    } else {
+        if (observe) run_loop<true, false, ById>(hrt, pt, select, mask, ids, pcs, outs, n, stats, collector);
+        else         run_loop<false, false, ById>(hrt, pt, select, mask, ids, pcs, outs, n, stats, collector);
+    }
+}
+
+} // namespace
+
+template <class Collector>
+void TwoLevelATPredictor::simulate(const BranchIds* ids, const std::uint64_t* pcs,
+                                   const Outcome* outs, std::size_t n, Stats& stats,
+                                   Collector& collector) {
+    visit_history_table(*hrt_, hrt_kind_, hrt_replacement_, hrt_index_, [&](auto& hrt) {
+        using HRT = std::decay_t<decltype(hrt)>;
+        if constexpr (HRT::kByBranchId) {
+            if (ids) {
+                hrt.use_ids(ids->space);
+                run_batch<true>(hrt, pt_, select_, mask_, ids->ids, pcs, outs, n, stats,
+                                collector);
+                return;
+            }
+        }
+        run_batch<false>(hrt, pt_, select_, mask_, nullptr, pcs, outs, n, stats, collector);
+    });
+}
+
+template <class Collector>
+void TwoLevelATPredictor::simulate_batch(const std::uint64_t* pcs,
+                                         const Outcome* outs,
+                                         std::size_t n, Stats& stats,
+                                         Collector& collector) {
+    simulate(nullptr, pcs, outs, n, stats, collector);
+}
+
+template <class Collector>
+void TwoLevelATPredictor::simulate_batch(const BranchIds& ids, const std::uint64_t* pcs,
+                                         const Outcome* outs, std::size_t n, Stats& stats,
+                                         Collector& collector) {
+    simulate(&ids, pcs, outs, n, stats, collector);
+}
+
+template void TwoLevelATPredictor::simulate_batch<NoCollector>(
+    const std::uint64_t*, const Outcome*, std::size_t, Stats&, NoCollector&);
+template void TwoLevelATPredictor::simulate_batch<BranchStatsCollector>(
+    const std::uint64_t*, const Outcome*, std::size_t, Stats&, BranchStatsCollector&);
+template void TwoLevelATPredictor::simulate_batch<HitLogCollector>(
+    const std::uint64_t*, const Outcome*, std::size_t, Stats&, HitLogCollector&);
+template void TwoLevelATPredictor::simulate_batch<NoCollector>(
+    const BranchIds&, const std::uint64_t*, const Outcome*, std::size_t, Stats&, NoCollector&);
+template void TwoLevelATPredictor::simulate_batch<BranchStatsCollector>(
+    const BranchIds&, const std::uint64_t*, const Outcome*, std::size_t, Stats&,
+    BranchStatsCollector&);
+template void TwoLevelATPredictor::simulate_batch<HitLogCollector>(
+    const BranchIds&, const std::uint64_t*, const Outcome*, std::size_t, Stats&,
+    HitLogCollector&);
+
 /**
  * Approximate hardware cost in bits:
  *
  *   HRT bits = (#entries in HRT) * history_bits
- *   PT bits  = (#entries in PT)  * 2 (2-bit counters)
+ *   PT bits  = (#entries in PT)  * automaton_state_bits()
  *
  * Useful for generating plots of "accuracy vs hardware cost".
  */
 std::size_t TwoLevelATPredictor::hardware_cost_bits() const {
     std::size_t hrt_bits = hrt_->capacity_entries() * history_bits_;
-    std::size_t pt_bits  = pt_.num_entries() * 2u;
+    std::size_t pt_bits  = pt_.num_entries() * automaton_state_bits(pt_.automaton());
     return hrt_bits + pt_bits;
 }
 
+void TwoLevelATPredictor::save(SnapshotWriter& out) const {
+    hrt_->save(out);
+    pt_.save(out);
+}
+
+void TwoLevelATPredictor::load(SnapshotReader& in) {
+    hrt_->load(in);
+    pt_.load(in);
+    has_pending_ = false;
+}
+
 } // namespace bp